@@ -26,11 +26,17 @@
   *
   */
 #pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
 #include <memory>
 #include <mutex>
 #include <string>
+#include <unordered_map>
 #include <vector>
 #include "granada/util/memory.h"
+#include "granada/util/string.h"
 
 namespace granada{
   namespace cache{
@@ -121,6 +127,341 @@ namespace granada{
     };
 
 
+    /**
+     * Change of a key of the cache, delivered to the subscribers
+     * of the keys matching a pattern.
+     * Example:
+     *      type  => WRITE
+     *      key   => plugin.event:value:GHs98Ev4GLkqw32g8
+     *      field => script
+     */
+    struct CacheEvent{
+
+      /**
+       * WRITE if the value has been inserted or rewritten,
+       * DESTROY if it has been removed.
+       */
+      enum Type {WRITE = 0, DESTROY = 1};
+
+      Type type;
+
+      /**
+       * Key or name of the set that has changed.
+       */
+      std::string key;
+
+      /**
+       * Key of the value inside the set that has changed.
+       * Empty if the change concerns the whole key or set,
+       * "*" if the driver can not tell which value of the
+       * set has changed.
+       */
+      std::string field;
+    };
+
+
+    /**
+     * Function type called with the changes of the cache.
+     */
+    typedef std::function<void(const granada::cache::CacheEvent&)> function_void_cache_event;
+
+
+    /**
+     * Collection of the subscriptions to the changes of a cache.
+     * Used by the cache drivers to keep their subscribers and
+     * call them when a key matching their pattern changes.
+     * This code is multi-thread safe.
+     */
+    class CacheSubscriptions{
+
+      public:
+
+        /**
+         * Constructor
+         */
+        CacheSubscriptions() : size_(0), uid_(0){};
+
+
+        /**
+         * Adds a subscription.
+         * @param  pattern  Pattern of the keys to watch. Example: plugin.event:value:*
+         * @param  callback Function called with each change of a key matching the pattern.
+         * @return          Subscription id, used to unsubscribe.
+         */
+        unsigned long long Add(const std::string& pattern, granada::cache::function_void_cache_event callback){
+          std::lock_guard<std::mutex> lg(mtx_);
+          Subscription subscription;
+          subscription.id = ++uid_;
+          subscription.pattern = pattern;
+          subscription.callback = std::move(callback);
+          subscriptions_.push_back(std::move(subscription));
+          size_ = subscriptions_.size();
+          return uid_;
+        };
+
+
+        /**
+         * Removes a subscription.
+         * @param id  Subscription id returned by Add.
+         */
+        void Remove(const unsigned long long& id){
+          std::lock_guard<std::mutex> lg(mtx_);
+          for (auto it = subscriptions_.begin(); it != subscriptions_.end(); ++it){
+            if (it->id == id){
+              subscriptions_.erase(it);
+              break;
+            }
+          }
+          size_ = subscriptions_.size();
+        };
+
+
+        /**
+         * Returns true if there are no subscriptions. Does not lock,
+         * so it can be checked on every cache operation.
+         * @return  True if there are no subscriptions, false if there are.
+         */
+        bool empty() const {
+          return size_.load(std::memory_order_relaxed) == 0;
+        };
+
+
+        /**
+         * Calls the callbacks of the subscriptions whose pattern
+         * matches the key of the event.
+         * @param event Cache event.
+         */
+        void Notify(const granada::cache::CacheEvent& event){
+          std::vector<granada::cache::function_void_cache_event> callbacks;
+          {
+            std::lock_guard<std::mutex> lg(mtx_);
+            for (auto it = subscriptions_.begin(); it != subscriptions_.end(); ++it){
+              if (granada::util::string::wildcard_match(event.key, it->pattern)){
+                callbacks.push_back(it->callback);
+              }
+            }
+          }
+          // call outside the lock so callbacks can subscribe or unsubscribe.
+          for (auto it = callbacks.begin(); it != callbacks.end(); ++it){
+            // a throwing subscriber must not kill the publishing thread.
+            try{
+              (*it)(event);
+            }catch(...){}
+          }
+        };
+
+
+      private:
+
+        /**
+         * Subscription: id, pattern of the watched keys and callback.
+         */
+        struct Subscription{
+          unsigned long long id;
+          std::string pattern;
+          granada::cache::function_void_cache_event callback;
+        };
+
+
+        /**
+         * Subscriptions.
+         */
+        std::vector<Subscription> subscriptions_;
+
+
+        /**
+         * Number of subscriptions.
+         */
+        std::atomic<std::size_t> size_;
+
+
+        /**
+         * Last subscription id given.
+         */
+        unsigned long long uid_;
+
+
+        /**
+         * Mutex for thread safety.
+         */
+        std::mutex mtx_;
+    };
+
+
+    /**
+     * Collection of writes, destroys and renames to commit in a cache
+     * all at once with CacheHandler::Commit. The operations are applied
+     * in the order they have been added, and no reader of the cache can
+     * see a part of them applied and the other not.
+     * Example:
+     *      granada::cache::CacheBatch batch;
+     *      batch.Write(hash, "name", name);
+     *      batch.Write(hash, "roles", roles);
+     *      cache->Commit(batch);
+     */
+    class CacheBatch{
+
+      public:
+
+        /**
+         * Operation of the batch.
+         * Write and destroy of a key have an empty hash,
+         * update always has a hash,
+         * rename uses key as old key and value as new key,
+         * index and unindex use hash as index, key as member
+         * and value as score.
+         */
+        struct Operation{
+          enum Type {WRITE = 0, DESTROY = 1, RENAME = 2, INDEX = 3, UNINDEX = 4, UPDATE = 5};
+          Type type;
+          std::string hash;
+          std::string key;
+          std::string value;
+        };
+
+
+        /**
+         * Constructor
+         */
+        CacheBatch(){};
+
+
+        /**
+         * Adds the insertion or rewrite of a value.
+         * @param key   Key of the value.
+         * @param value Value.
+         */
+        void Write(const std::string& key,const std::string& value){
+          Add(Operation::Type::WRITE, std::string(), key, value);
+        };
+
+
+        /**
+         * Adds the insertion or rewrite of a value of a set.
+         * @param hash  Name of the set.
+         * @param key   Key of the value in the set.
+         * @param value Value.
+         */
+        void Write(const std::string& hash,const std::string& key,const std::string& value){
+          Add(Operation::Type::WRITE, hash, key, value);
+        };
+
+
+        /**
+         * Adds the rewrite of a value of a set only if the set
+         * exists, so a late write does not bring back a set
+         * destroyed in the meantime.
+         * @param hash  Name of the set.
+         * @param key   Key of the value in the set.
+         * @param value Value.
+         */
+        void Update(const std::string& hash,const std::string& key,const std::string& value){
+          Add(Operation::Type::UPDATE, hash, key, value);
+        };
+
+
+        /**
+         * Adds the removal of a key or a set.
+         * Contrary to CacheHandler::Destroy, wildcards are not
+         * expanded, the key is removed as it is.
+         * @param key Key or name of the set.
+         */
+        void Destroy(const std::string& key){
+          Add(Operation::Type::DESTROY, std::string(), key, std::string());
+        };
+
+
+        /**
+         * Adds the removal of a value of a set.
+         * @param hash  Name of the set.
+         * @param key   Key of the value in the set.
+         */
+        void Destroy(const std::string& hash,const std::string& key){
+          Add(Operation::Type::DESTROY, hash, key, std::string());
+        };
+
+
+        /**
+         * Adds the renaming of a key, the key is not
+         * renamed if the new key already exists.
+         * @param old_key Old key to rename.
+         * @param new_key New key.
+         */
+        void Rename(const std::string& old_key, const std::string& new_key){
+          Add(Operation::Type::RENAME, std::string(), old_key, new_key);
+        };
+
+
+        /**
+         * Adds the insertion of a member in an ordered index,
+         * or the update of its score.
+         * @param index   Name of the index.
+         * @param member  Member.
+         * @param score   Score of the member, members are ordered by score.
+         */
+        void Index(const std::string& index, const std::string& member, const long long& score){
+          Add(Operation::Type::INDEX, index, member, std::to_string(score));
+        };
+
+
+        /**
+         * Adds the removal of a member from an ordered index.
+         * @param index   Name of the index.
+         * @param member  Member.
+         */
+        void Unindex(const std::string& index, const std::string& member){
+          Add(Operation::Type::UNINDEX, index, member, std::string());
+        };
+
+
+        /**
+         * Returns the operations of the batch in the order they were added.
+         * @return  Operations.
+         */
+        const std::vector<Operation>& operations() const {
+          return operations_;
+        };
+
+
+        /**
+         * Returns true if the batch has no operation.
+         * @return  True if the batch has no operation, false if it has.
+         */
+        bool empty() const {
+          return operations_.empty();
+        };
+
+
+        /**
+         * Removes all the operations of the batch.
+         */
+        void clear(){
+          operations_.clear();
+        };
+
+
+      private:
+
+        /**
+         * Operations of the batch.
+         */
+        std::vector<Operation> operations_;
+
+
+        /**
+         * Adds an operation to the batch.
+         */
+        void Add(const Operation::Type type, const std::string& hash, const std::string& key, const std::string& value){
+          Operation operation;
+          operation.type = type;
+          operation.hash = hash;
+          operation.key = key;
+          operation.value = value;
+          operations_.push_back(std::move(operation));
+        };
+    };
+
+
     /**
      * Manages cache, data stored as key-value pairs, data can be persistant
      * or not.
@@ -177,6 +518,19 @@ namespace granada{
         virtual const std::string Read(const std::string& hash, const std::string& key) = 0;
 
 
+        /**
+         * Fills a map with all the key-value pairs stored in a set,
+         * in one lock acquisition or one round trip.
+         * @param  hash   Name of the set where the key-value pairs are stored.
+         * @param  values Map to fill with the key-value pairs.
+         * @return        True if the values have been read, false if the
+         *                driver does not support reading a whole set.
+         */
+        virtual const bool ReadAll(const std::string& /*hash*/, std::unordered_map<std::string,std::string>& /*values*/){
+          return false;
+        };
+
+
         /**
          * Fills a vector of strings with the the keys that match an expression.
          * 
@@ -246,10 +600,203 @@ namespace granada{
         virtual bool Rename(const std::string& old_key, const std::string& new_key) = 0;
 
 
+        /**
+         * Applies all the operations of a batch atomically: readers
+         * see either none or all of them. Costs one lock acquisition or
+         * one round trip instead of one per operation.
+         * Drivers without transactions apply the operations one by one.
+         * 
+         * @param batch Batch of writes, destroys and renames.
+         * @return      True if the batch has been applied, false if the
+         *              cache could not be reached or one of the operations
+         *              failed. Then the operations before the failing one
+         *              may have been applied: not all drivers roll back.
+         */
+        virtual bool Commit(const granada::cache::CacheBatch& batch){
+          std::vector<long long> replies;
+          return Commit(batch, replies);
+        };
+
+
+        /**
+         * Applies all the operations of a batch atomically, as Commit(batch),
+         * and gives the result of each operation, so a caller can know which
+         * of two concurrent destroys has removed a key.
+         * Drivers without transactions apply the operations one by one,
+         * checking if the keys exist before destroying or updating them.
+         * 
+         * @param batch   Batch of writes, destroys and renames.
+         * @param replies One reply per operation, in order: the number of keys
+         *                or fields removed by a destroy, 1 if a rename has renamed
+         *                the key or an update has written the value and 0 if not,
+         *                1 for the other operations.
+         * @return        True if the batch has been applied.
+         */
+        virtual bool Commit(const granada::cache::CacheBatch& batch, std::vector<long long>& replies){
+          const std::vector<granada::cache::CacheBatch::Operation>& operations = batch.operations();
+          replies.clear();
+          for (auto it = operations.begin(); it != operations.end(); ++it){
+            long long reply = 1;
+            switch (it->type){
+              case granada::cache::CacheBatch::Operation::Type::WRITE:
+                if (it->hash.empty()){
+                  Write(it->key, it->value);
+                }else{
+                  Write(it->hash, it->key, it->value);
+                }
+                break;
+              case granada::cache::CacheBatch::Operation::Type::DESTROY:
+                if (it->hash.empty()){
+                  reply = Exists(it->key) ? 1 : 0;
+                  Destroy(it->key);
+                }else{
+                  reply = Exists(it->hash, it->key) ? 1 : 0;
+                  Destroy(it->hash, it->key);
+                }
+                break;
+              case granada::cache::CacheBatch::Operation::Type::RENAME:
+                reply = Rename(it->key, it->value) ? 1 : 0;
+                break;
+              case granada::cache::CacheBatch::Operation::Type::UPDATE:
+                reply = 0;
+                if (Exists(it->hash)){
+                  Write(it->hash, it->key, it->value);
+                  reply = 1;
+                }
+                break;
+              case granada::cache::CacheBatch::Operation::Type::INDEX:
+                Index(it->hash, it->key, std::stoll(it->value));
+                break;
+              case granada::cache::CacheBatch::Operation::Type::UNINDEX:
+                Unindex(it->hash, it->key);
+                break;
+            }
+            replies.push_back(reply);
+          }
+          return true;
+        };
+
+
+        /**
+         * Inserts a member in an ordered index or updates its score.
+         * Indexes let find the members with the lowest scores, for example
+         * the keys that expire first, without iterating over all the keys.
+         * Drivers without ordered sets store the index in a set
+         * of member-score pairs.
+         * 
+         * @param index   Name of the index.
+         * @param member  Member.
+         * @param score   Score of the member, members are ordered by score.
+         */
+        virtual void Index(const std::string& index, const std::string& member, const long long& score){
+          Write(index, member, std::to_string(score));
+        };
+
+
+        /**
+         * Removes a member from an ordered index.
+         * @param index   Name of the index.
+         * @param member  Member.
+         */
+        virtual void Unindex(const std::string& index, const std::string& member){
+          Destroy(index, member);
+        };
+
+
+        /**
+         * Removes from an ordered index the members with a score lower
+         * or equal to the given one, lowest scores first, and returns them.
+         * A member is only returned once, even if several threads or processes
+         * pop the same index at the same time.
+         * 
+         * @param index     Name of the index.
+         * @param max_score Maximum score of the members to pop.
+         * @param count     Maximum number of members to pop.
+         * @param members   Vector filled with the members popped.
+         */
+        virtual void PopIndex(const std::string& index, const long long& max_score, const std::size_t& count, std::vector<std::string>& members){
+          members.clear();
+          std::unordered_map<std::string,std::string> values;
+          if (ReadAll(index, values)){
+            std::vector<std::pair<long long,std::string>> scored;
+            for (auto it = values.begin(); it != values.end(); ++it){
+              try{
+                const long long score = std::stoll(it->second);
+                if (score <= max_score){
+                  scored.push_back(std::make_pair(score, it->first));
+                }
+              }catch(const std::logic_error e){}
+            }
+            std::sort(scored.begin(), scored.end());
+            for (auto it = scored.begin(); it != scored.end() && members.size() < count; ++it){
+              Destroy(index, it->second);
+              members.push_back(it->second);
+            }
+          }
+        };
+
+
+        /**
+         * Takes a token from a token bucket stored in the cache, so the
+         * processes sharing the cache share the bucket. The bucket gets a token
+         * every interval milliseconds and holds up to burst tokens. It is stored
+         * as the time it will be full again, in milliseconds since epoch.
+         * Drivers without scripts read and write the key, two processes taking
+         * a token at the same time may both get it.
+         * 
+         * @param key       Key of the bucket.
+         * @param interval  Milliseconds between two tokens.
+         * @param burst     Maximum tokens of the bucket.
+         * @return          0 if a token has been taken, if the bucket is empty,
+         *                  the milliseconds until it has a token again.
+         */
+        virtual long long TakeToken(const std::string& key, const long long& interval, const long long& burst){
+          const long long now = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+          const long long tolerance = interval * (burst > 1 ? burst - 1 : 0);
+          long long full = 0;
+          try{
+            full = std::stoll(Read(key));
+          }catch(const std::logic_error e){}
+          const long long start = full > now ? full : now;
+          if (start - now > tolerance){
+            return start - tolerance - now;
+          }
+          Write(key, std::to_string(start + interval));
+          return 0;
+        };
+
+
         /**
          * Returns an iterator to iterate over keys with an expression.
          */
         virtual std::unique_ptr<granada::cache::CacheHandlerIterator> make_iterator(const std::string& expression) = 0;
+
+
+        /**
+         * Watches the keys matching a pattern. The callback is called
+         * asynchronously, from a thread of the driver, each time a matching
+         * key is written, destroyed or renamed, so derived data can be
+         * invalidated when it goes stale instead of recomputed on every use.
+         * Callbacks should return quickly.
+         * 
+         * @param pattern   Pattern of the keys to watch.
+         *                  Example:
+         *                      plugin.event:value:*
+         *                      => will watch all the plug-in events values.
+         * @param callback  Function called with the change.
+         * @return          Subscription id, 0 if the driver does not support
+         *                  subscriptions.
+         */
+        virtual unsigned long long Subscribe(const std::string& /*pattern*/, granada::cache::function_void_cache_event /*callback*/){
+          return 0;
+        };
+
+
+        /**
+         * Stops watching the keys of a subscription.
+         * @param subscription_id Id returned by Subscribe.
+         */
+        virtual void Unsubscribe(const unsigned long long& /*subscription_id*/){};
         
     };
   }
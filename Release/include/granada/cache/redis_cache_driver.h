@@ -30,11 +30,17 @@
 #pragma once
 
 #include <string>
+#include <vector>
+#include <deque>
+#include <tuple>
+#include <iostream>
+#include <thread>
 #include "granada/defaults.h"
 #include "granada/util/mutex.h"
 #include "granada/util/application.h"
 #include "cache_handler.h"
 #include "redisclient/redissyncclient.h"
+#include "redisclient/redisasyncclient.h"
 
 
 
@@ -66,6 +72,24 @@ namespace granada{
         };
 
 
+        /**
+         * Returns the address of the redis server.
+         * @return Redis server address.
+         */
+        static const std::string& address(){
+          return redis_address_;
+        };
+
+
+        /**
+         * Returns the port of the redis server.
+         * @return Redis server port.
+         */
+        static const unsigned short& port(){
+          return redis_port_;
+        };
+
+
       private:
 
         /**
@@ -113,6 +137,60 @@ namespace granada{
 
 
 
+    /**
+     * Redis async client wrapper, owns the client and the thread
+     * running its io_service. Used to receive the messages of the
+     * channels the client is subscribed to.
+     */
+    class RedisAsyncClientWrapper{
+
+      public:
+
+        /**
+         * Constructor. Connects to the redis server and subscribes
+         * to the given channels once connected.
+         * @param address     Redis server address.
+         * @param port        Redis server port.
+         * @param channels    Channels to subscribe to, and function called
+         *                    with each message published in the channel.
+         */
+        RedisAsyncClientWrapper(const std::string& address, const unsigned short& port, const std::vector<std::pair<std::string,std::function<void(const std::vector<char>&)>>>& channels);
+
+
+        /**
+         * Destructor. Stops the io_service and waits for its thread.
+         */
+        virtual ~RedisAsyncClientWrapper();
+
+
+      private:
+
+        /**
+         * io_service used by the async client.
+         */
+        boost::asio::io_service io_service_;
+
+
+        /**
+         * Keeps the io_service running while there is no message.
+         */
+        std::unique_ptr<boost::asio::io_service::work> work_;
+
+
+        /**
+         * Redis async client.
+         */
+        std::unique_ptr<redisclient::RedisAsyncClient> redis_;
+
+
+        /**
+         * Thread running the io_service.
+         */
+        std::thread thread_;
+    };
+
+
+
     /**
      * Iterates over cache keys.
      * Tool for SCAN or KEYS search in a Redis database, with a given pattern.
@@ -302,6 +380,17 @@ namespace granada{
         virtual const std::string Read(const std::string& hash, const std::string& key);
 
 
+        /**
+         * Fills a map with all the key-value pairs stored in a set,
+         * using one HGETALL.
+         * @param  hash   Name of the set where the key-value pairs are stored.
+         * @param  values Map to fill with the key-value pairs.
+         * @return        True if the values have been read, false if redis
+         *                returned an error.
+         */
+        virtual const bool ReadAll(const std::string& hash, std::unordered_map<std::string,std::string>& values);
+
+
         /**
          * Inserts a key-value pair, rewrites it if it already exists.
          * @param key   Key to identify the value.
@@ -401,6 +490,97 @@ namespace granada{
         };
 
 
+        /**
+         * Applies all the operations of a batch with one EVAL of a
+         * lua script, in one round trip. The server runs the script
+         * without serving other clients in between.
+         * Redis does not roll back a script: if an operation fails,
+         * for example a write to a key holding another type,
+         * the operations before it stay applied.
+         * 
+         * @param batch   Batch of writes, destroys and renames.
+         * @param replies One reply per operation, the integer replies of
+         *                DEL and HDEL, 1 if a rename has renamed the key
+         *                or an update has written the value and 0 if not,
+         *                1 for the other operations.
+         * @return        False if redis has not been reached or one
+         *                of the operations has failed.
+         */
+        virtual bool Commit(const granada::cache::CacheBatch& batch, std::vector<long long>& replies) override;
+        using granada::cache::CacheHandler::Commit;
+
+
+        /**
+         * Inserts a member in an ordered index or updates its score,
+         * the index is a redis sorted set (ZADD).
+         * 
+         * @param index   Name of the index.
+         * @param member  Member.
+         * @param score   Score of the member.
+         */
+        virtual void Index(const std::string& index, const std::string& member, const long long& score) override;
+
+
+        /**
+         * Removes a member from an ordered index (ZREM).
+         * @param index   Name of the index.
+         * @param member  Member.
+         */
+        virtual void Unindex(const std::string& index, const std::string& member) override;
+
+
+        /**
+         * Removes from an ordered index the members with a score lower
+         * or equal to the given one, lowest scores first, and returns them.
+         * Range and removal run in one script, in one round trip, so two
+         * processes popping the same index never get the same member.
+         * 
+         * @param index     Name of the index.
+         * @param max_score Maximum score of the members to pop.
+         * @param count     Maximum number of members to pop.
+         * @param members   Vector filled with the members popped.
+         */
+        virtual void PopIndex(const std::string& index, const long long& max_score, const std::size_t& count, std::vector<std::string>& members) override;
+
+
+        /**
+         * Takes a token from a token bucket stored in redis. The check and
+         * the update run in one script, so the processes sharing the redis
+         * server never take the same token. The key expires when the
+         * bucket is full.
+         * 
+         * @param key       Key of the bucket.
+         * @param interval  Milliseconds between two tokens.
+         * @param burst     Maximum tokens of the bucket.
+         * @return          0 if a token has been taken, if the bucket is empty,
+         *                  the milliseconds until it has a token again.
+         */
+        virtual long long TakeToken(const std::string& key, const long long& interval, const long long& burst) override;
+
+
+        /**
+         * Watches the keys matching a pattern using redis keyspace notifications.
+         * The first subscription enables the notifications in the redis server
+         * (notify-keyspace-events) and subscribes to the keyevent channels.
+         * Redis does not tell which value of a set has changed, so
+         * the events of the sets have "*" as field.
+         * 
+         * @param pattern   Pattern of the keys to watch.
+         *                  Example: plugin.event:value:*
+         * @param callback  Function called with the change, from the thread
+         *                  receiving the redis messages.
+         * @return          Subscription id.
+         */
+        virtual unsigned long long Subscribe(const std::string& pattern, granada::cache::function_void_cache_event callback) override;
+
+
+        /**
+         * Stops watching the keys of a subscription.
+         * @param subscription_id Id returned by Subscribe.
+         */
+        virtual void Unsubscribe(const unsigned long long& subscription_id) override;
+
+
       protected:
 
         /**
@@ -415,6 +595,32 @@ namespace granada{
         static std::mutex mtx_;
 
 
+        /**
+         * Subscriptions to the changes of the keys, shared by
+         * all the redis cache drivers.
+         */
+        static granada::cache::CacheSubscriptions subscriptions_;
+
+
+        /**
+         * Redis client subscribed to the keyevent channels.
+         */
+        static std::unique_ptr<RedisAsyncClientWrapper> subscriber_;
+
+
+        /**
+         * Used for subscribing to the keyevent channels only once.
+         */
+        static granada::util::mutex::call_once subscribe_call_once_;
+
+
+        /**
+         * Enables the keyspace notifications in the redis server
+         * and subscribes to the keyevent channels.
+         */
+        void SubscribeKeyEvents();
+
+
     };
   }
 }
@@ -36,12 +36,16 @@
 
 #pragma once
 #include "cache_handler.h"
+#include <atomic>
+#include <condition_variable>
 #include <regex>
 #include <string>
 #include <deque>
+#include <thread>
 #include <unordered_map>
 #include <map>
 #include "granada/util/string.h"
+#include "granada/util/queue.h"
 
 namespace granada{
   namespace cache{
@@ -158,7 +162,7 @@ namespace granada{
         /**
          * Destructor
          */
-        virtual ~SharedMapCacheDriver(){};
+        virtual ~SharedMapCacheDriver();
 
 
         /**
@@ -195,6 +199,16 @@ namespace granada{
         virtual const std::string Read(const std::string& hash,const std::string& key);
 
 
+        /**
+         * Fills a map with all the key-value pairs
+         * of the map with the given name.
+         * @param  hash   Name of the map.
+         * @param  values Map to fill with the key-value pairs.
+         * @return        True.
+         */
+        virtual const bool ReadAll(const std::string& hash, std::unordered_map<std::string,std::string>& values);
+
+
         /**
          * Set a value in the cache associated with a given key.
          * @param key   Key of the value.
@@ -272,6 +286,71 @@ namespace granada{
         };
 
 
+        /**
+         * Applies all the operations of a batch holding the
+         * lock only once, so readers never see them half applied.
+         * 
+         * @param batch   Batch of writes, destroys and renames.
+         * @param replies One reply per operation, see CacheHandler::Commit.
+         * @return        Always true.
+         */
+        virtual bool Commit(const granada::cache::CacheBatch& batch, std::vector<long long>& replies) override;
+        using granada::cache::CacheHandler::Commit;
+
+
+        /**
+         * Inserts a member in an ordered index or updates its score.
+         * Indexes are kept in memory apart from the other keys, ordered by score.
+         * 
+         * @param index   Name of the index.
+         * @param member  Member.
+         * @param score   Score of the member.
+         */
+        virtual void Index(const std::string& index, const std::string& member, const long long& score) override;
+
+
+        /**
+         * Removes a member from an ordered index.
+         * @param index   Name of the index.
+         * @param member  Member.
+         */
+        virtual void Unindex(const std::string& index, const std::string& member) override;
+
+
+        /**
+         * Removes from an ordered index the members with a score lower
+         * or equal to the given one, lowest scores first, and returns them.
+         * Costs O(log n) per member popped.
+         * 
+         * @param index     Name of the index.
+         * @param max_score Maximum score of the members to pop.
+         * @param count     Maximum number of members to pop.
+         * @param members   Vector filled with the members popped.
+         */
+        virtual void PopIndex(const std::string& index, const long long& max_score, const std::size_t& count, std::vector<std::string>& members) override;
+
+
+        /**
+         * Watches the keys matching a pattern. The changes are pushed
+         * into a lock-free queue by the threads modifying the cache and
+         * delivered to the callback by a dispatcher thread, started with
+         * the first subscription.
+         * 
+         * @param pattern   Pattern of the keys to watch.
+         *                  Example: plugin.event:value:*
+         * @param callback  Function called with the change.
+         * @return          Subscription id.
+         */
+        virtual unsigned long long Subscribe(const std::string& pattern, granada::cache::function_void_cache_event callback) override;
+
+
+        /**
+         * Stops watching the keys of a subscription.
+         * @param subscription_id Id returned by Subscribe.
+         */
+        virtual void Unsubscribe(const unsigned long long& subscription_id) override;
+
+
       protected:
 
         /**
@@ -285,6 +364,91 @@ namespace granada{
         std::mutex mtx_;
 
 
+        /**
+         * Members of an ordered index by score, and the position
+         * of each member, so its score can be updated.
+         */
+        struct OrderedIndex{
+          std::multimap<long long,std::string> by_score;
+          std::unordered_map<std::string,std::multimap<long long,std::string>::iterator> by_member;
+        };
+
+
+        /**
+         * Ordered indexes by name. Protected by mtx_.
+         */
+        std::unordered_map<std::string,OrderedIndex> indexes_;
+
+
+        /**
+         * Inserts or updates a member of an ordered index,
+         * mtx_ has to be locked.
+         */
+        void IndexUnlocked(const std::string& index, const std::string& member, const long long& score);
+
+
+        /**
+         * Removes a member of an ordered index,
+         * mtx_ has to be locked.
+         */
+        void UnindexUnlocked(const std::string& index, const std::string& member);
+
+
+        /**
+         * Subscriptions to the changes of the keys.
+         */
+        granada::cache::CacheSubscriptions subscriptions_;
+
+
+        /**
+         * Changes waiting to be delivered to the subscribers.
+         */
+        granada::util::queue::mpsc_queue<granada::cache::CacheEvent> events_;
+
+
+        /**
+         * Thread delivering the changes to the subscribers.
+         */
+        std::thread dispatcher_;
+
+
+        /**
+         * Used for starting the dispatcher thread only once.
+         */
+        std::once_flag dispatcher_once_;
+
+
+        /**
+         * False when the dispatcher thread has to stop.
+         */
+        std::atomic_bool dispatching_;
+
+
+        /**
+         * Mutex and condition variable used to wake up
+         * the dispatcher thread when there are new changes.
+         */
+        std::mutex dispatcher_mtx_;
+        std::condition_variable dispatcher_cv_;
+
+
+        /**
+         * Queues a change for the subscribers, only if there are subscribers.
+         * @param type  WRITE or DESTROY.
+         * @param key   Key or name of the set.
+         * @param field Key of the value inside the set, empty if the change
+         *              concerns the whole key or set.
+         */
+        void Publish(const granada::cache::CacheEvent::Type type, const std::string& key, const std::string& field);
+
+
+        /**
+         * Delivers the queued changes to the subscribers until
+         * the driver is destroyed.
+         */
+        void Dispatch();
+
+
     };
   }
 }
@@ -29,12 +29,23 @@
 #include <time.h>
 #include <sstream>
 #include <string>
+#include <vector>
 #include <unordered_map>
+#include <list>
+#include <set>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <atomic>
 #include "cpprest/details/basic_types.h"
 #include "cpprest/json.h"
+#include "cpprest/http_msg.h"
 #include "boost/filesystem.hpp"
 #include <boost/functional/hash.hpp>
 #include "granada/util/application.h"
+#include "granada/util/bloom_filter.h"
+#include "granada/util/compression.h"
+#include "granada/util/time.h"
 
 
 namespace granada{
@@ -45,26 +56,61 @@ namespace granada{
      * Web resource
      * Example:
      * 		content_type     => text/javascript; charset=utf-8
-     * 		content_encoding => gzip
      * 		content          => console.log("content of a javascript resource.");
+     * 		gzip_content     => content compressed with gzip.
+     * 		brotli_content   => content compressed with brotli.
+     *
+     * The compressed variants are empty if the resource is not compressed
+     * or if compressing it does not make it smaller.
+     * Large files are not loaded in memory, their content is empty and
+     * file_path holds the absolute path of the file to stream the content from.
+     *
+     * ETag is a strong quoted ETag computed from the content, and headers,
+     * gzip_headers and brotli_headers are the response headers of each variant
+     * (ETag, Last-Modified, Content-Type, Content-Encoding...), computed once
+     * when the resource is loaded. Resources are shared and must not
+     * be modified once cached.
      */
     struct Resource{
       std::string content_type;
-      std::string content_encoding;
       std::string last_modified;
+      std::time_t last_modified_time = 0;
       std::string ETag;
       std::vector<unsigned char> content;
+      std::vector<unsigned char> gzip_content;
+      std::vector<unsigned char> brotli_content;
+      std::string file_path;
+      web::http::http_headers headers;
+      web::http::http_headers gzip_headers;
+      web::http::http_headers brotli_headers;
     };
 
 
     /**
      * Handles the cache of website or web application.
+     * With cache_content=on all the files are loaded when the cache starts,
+     * with cache_content=lazy files are loaded the first time they are
+     * requested, cached once they have been requested cache_admission_hits times
+     * and the least recently used ones are evicted when they do not fit
+     * in maximum_cache_memory.
      */
     class WebResourceCache
     {
       public:
 
 
+        /**
+         * Statistics of the load of the files when the cache starts
+         * (cache_content=on): number of files, bytes loaded in memory and
+         * duration of the load in seconds.
+         */
+        struct LoadStats{
+          std::size_t files = 0;
+          std::uintmax_t bytes = 0;
+          double seconds = 0;
+        };
+
+
         /**
          * Constructor
          */
@@ -72,15 +118,41 @@ namespace granada{
 
 
         /**
-         * Returns Resource type of file containing the "Content type", the "Content encoding"
+         * Destructor, stops watching the root path.
+         */
+        virtual ~WebResourceCache();
+
+
+        /**
+         * Returns Resource type of file containing the "Content type"
          * and the content of the resource.
          * This content could be cached or not, if it is not cached it will retrieve the
          * information from a file in the hard drive.
+         * The cached resources are shared, they are not copied.
          *
          * @param   file_path Relative path of the file. In the case of the http_request, it will be the relative uri path.
-         * @return  string    Content type of the file.
+         * @return            Resource, nullptr if there is no file with the given path.
          */
-        granada::cache::Resource GetFile(std::string& file_path);
+        std::shared_ptr<const granada::cache::Resource> GetFile(std::string& file_path);
+
+
+        /**
+         * Same as GetFile, but if the file is not cached and it has to be compressed,
+         * its content is compressed with the best encoding accepted by the client,
+         * the cached files have all their compressed variants.
+         *
+         * @param   file_path         Relative path of the file. In the case of the http_request, it will be the relative uri path.
+         * @param   accept_encoding   Value of the Accept-Encoding header of the request.
+         * @return                    Resource, nullptr if there is no file with the given path.
+         */
+        std::shared_ptr<const granada::cache::Resource> GetFile(std::string& file_path, const std::string& accept_encoding);
+
+
+        /**
+         * Returns the statistics of the load of the files when the cache started.
+         * @return  Load statistics.
+         */
+        const LoadStats& GetLoadStats();
 
 
         /**
@@ -91,7 +163,8 @@ namespace granada{
 
 
         /**
-         * Insert a record in the files_ unordered map.
+         * Insert a record in the files_ unordered map, or in the
+         * lazily loaded files if cache_content=lazy, where it can be evicted.
          * @param resource_path Path of the resource, it has to be unique.
          * @param resource      Resource.
          */
@@ -100,6 +173,49 @@ namespace granada{
       private:
 
 
+        /**
+         * Files relative paths and their resources. The same resource
+         * is shared by all the paths of a file.
+         */
+        typedef std::unordered_map<std::string, std::shared_ptr<const granada::cache::Resource>> FileMap;
+
+
+        /**
+         * Resource loaded but not cached yet, it can still be modified.
+         * read_path is the path of the file with the content to read, size
+         * bytes, empty if the content is not loaded in memory.
+         * compress is true if the resource has to be compressed.
+         */
+        struct LoadedResource{
+          std::shared_ptr<granada::cache::Resource> resource;
+          std::string read_path;
+          std::size_t size = 0;
+          bool compress = false;
+        };
+
+
+        /**
+         * File found in the root path.
+         */
+        struct FileEntry{
+          std::string relative_path;
+          std::string filename;
+          boost::filesystem::path path;
+          std::uintmax_t size = 0;
+          std::time_t last_modified_time = 0;
+        };
+
+
+        /**
+         * Lazily loaded file, with its position in the recently used list.
+         */
+        struct LazyResource{
+          std::shared_ptr<const granada::cache::Resource> resource;
+          std::size_t size;
+          std::list<std::string>::iterator position;
+        };
+
+
         /**
          * Cache according to the given properties.
          */
@@ -114,23 +230,147 @@ namespace granada{
 
 
         /**
-         * Makes a copy of the root directory and gzip all the
-         * files with the extension indicated to gzip in the
-         * gzip_extensions property of the server configuration file.
+         * Prepare loaded resources to be cached: read their content into a buffer
+         * of the size of the file, compress the content of the files with
+         * the extension indicated in the gzip_extensions property of the server configuration
+         * file, in gzip and brotli if available, and precompute their ETags and headers.
+         * Resources are prepared in parallel using one thread per core.
          * Eample: if html is part of the gzip_extensions property in the server
-         * configuration file then all files with html extension
-         * will be gziped.
+         * configuration file then all cached files with html extension
+         * will be compressed.
+         * @param loaded  Loaded resources.
          */
-        void GzipCopy();
+        void PrepareResources(std::vector<LoadedResource>& loaded);
 
 
         /**
-         * Load files in memory.
+         * Compute the ETag of a resource if it has none, and the response
+         * headers of each of its variants.
+         * @param resource  Resource.
+         */
+        void PrecomputeHeaders(granada::cache::Resource& resource);
+
+
+        /**
+         * Compress the content of a resource into its compressed variants.
+         * Variants that are not smaller than the content are dropped.
+         * @param resource        Resource to compress.
+         * @param gzip            True if a gzip variant has to be created.
+         * @param brotli          True if a brotli variant has to be created.
+         * @param gzip_level      Compression level of gzip, from 1 to 9.
+         * @param brotli_quality  Compression quality of brotli, from 0 to 11.
+         */
+        void Compress(granada::cache::Resource& resource, bool gzip, bool brotli, int gzip_level, int brotli_quality);
+
+
+        /**
+         * Load the files of a directory and its subdirectories. Files that are too large
+         * or do not fit in the remaining cache memory are cached without content, so they are
+         * streamed from the hard drive. The content of the other files is read when
+         * they are prepared.
          * @param  relative_path        Path of the file without the root path (relative uri path).
          * @param maximum_cache_memory  Limit of bytes to load.
+         * @param files                 Map where the loaded files are inserted.
+         * @param loaded                Vector where the loaded resources are inserted, they have
+         *                              to be prepared with PrepareResources before the files are cached.
          * @return  True if some files have been cached, and false if no file has been cached.
          */
-        bool RecursiveLoad(const std::string &relative_path, int& maximum_cache_memory);
+        bool RecursiveLoad(const std::string &relative_path, int& maximum_cache_memory, FileMap& files, std::vector<LoadedResource>& loaded);
+
+
+        /**
+         * List the files of a directory and its subdirectories, with their size
+         * and modification date. Directories are listed in parallel using one
+         * thread per core.
+         * @param relative_path Path of the directory without the root path, ending with a slash.
+         * @param entries       Vector where the files found are inserted.
+         */
+        void ListFiles(const std::string& relative_path, std::vector<FileEntry>& entries);
+
+
+        /**
+         * Create the resource of a file, without its content.
+         * @param  entry                File.
+         * @param  maximum_cache_memory Limit of bytes to load, the size of the content
+         *                              is subtracted if it is going to be loaded.
+         * @return                      Loaded resource, to be prepared with PrepareResources.
+         */
+        LoadedResource LoadResource(const FileEntry& entry, int& maximum_cache_memory);
+
+
+        /**
+         * Insert a resource in a map of files with all the paths the client can
+         * use to request it: path/to/file/default.file and if it is a default file
+         * path/to/file/ and path/to/file. Paths already in the map are not replaced.
+         * @param files         Map of files.
+         * @param relative_path Relative path of the directory of the file, ending with a slash.
+         * @param filename      Name of the file.
+         * @param resource      Resource.
+         */
+        void RecordResource(FileMap& files, const std::string& relative_path, const std::string& filename, const std::shared_ptr<const granada::cache::Resource>& resource);
+
+
+        /**
+         * Watch a directory and its subdirectories for changes.
+         * @param relative_path Path of the directory without the root path, ending with a slash.
+         */
+        void AddWatch(const std::string& relative_path);
+
+
+        /**
+         * Loop of the watcher thread: waits for changes in the watched directories
+         * and reloads the changed files once no change has happened for a moment.
+         * If the kernel has dropped events (IN_Q_OVERFLOW) the whole root path
+         * is reloaded, as any file may have changed.
+         */
+        void Watch();
+
+
+        /**
+         * Reload changed files, directories or removed files, then swap
+         * the files map with the new one. Requests being served keep using
+         * the previous map. If the root path "/" is given all the files are
+         * loaded again, or in lazy mode all the cached files are forgotten.
+         * @param relative_paths  Paths without the root path of the changed files or directories.
+         */
+        void Reload(const std::set<std::string>& relative_paths);
+
+
+        /**
+         * Returns a lazily loaded file and marks it as the most recently used.
+         * @param  path Relative path of the file as requested.
+         * @return      Resource, nullptr if it is not cached.
+         */
+        std::shared_ptr<const granada::cache::Resource> LazyGet(const std::string& path);
+
+
+        /**
+         * Counts a miss of a file and returns true if it has been requested
+         * enough times to be cached. The counts are forgotten regularly
+         * so only the files requested frequently are cached.
+         * @param  path Relative path of the file as requested.
+         * @return      True if the file has to be cached.
+         */
+        bool LazyAdmit(const std::string& path);
+
+
+        /**
+         * Cache a lazily loaded file, evicting the least recently used files
+         * until it fits in the cache memory. Files larger than the whole
+         * cache memory are not cached.
+         * @param path      Relative path of the file as requested.
+         * @param resource  Resource with its compressed variants and headers.
+         */
+        void LazyInsert(const std::string& path, const std::shared_ptr<const granada::cache::Resource>& resource);
+
+
+        /**
+         * Remove the lazily loaded files that may have changed: a changed path,
+         * the files under it if it is a directory, and the default file
+         * paths of its directory.
+         * @param relative_path Path without the root path of the changed file or directory.
+         */
+        void LazyInvalidate(const std::string& relative_path);
 
 
         /**
@@ -164,12 +404,12 @@ namespace granada{
 
 
         /**
-         * Generate ETag based on a string
-         * @param  resource_path Path of the resource, something like /about/index.html
-         * @param  last_modified Modification date of the resource. Format: Tue, 15 Nov 1994 12:45:26 GMT
-         * @return ETag Etag to identify the version of a resource. Example: 17163160063112100381
+         * Generate a strong ETag based on the content of a resource (FNV-1a hash), or
+         * if the content is not in memory on the modification date and the size of the file.
+         * @param  resource Resource.
+         * @return ETag Etag to identify the version of a resource. Example: "3f9a5c0e1b2d4a67"
          */
-        std::string GenerateETag(const std::string& resource_path, const std::string& last_modified);
+        std::string GenerateETag(const granada::cache::Resource& resource);
 
 
         /**
@@ -195,32 +435,57 @@ namespace granada{
 
         /**
          * Contains the files relative paths and their properties.
-         * The properties are the "Content Type", the "Content Encoding"
-         * and the content of the file.
+         * The properties are the "Content Type", the content of
+         * the file and its compressed variants.
          * Examples:
          * 		files_
          * 			/about/
          * 				|_ content_type     => text/html; charset=utf-8
-         * 				|_ content_encoding => gzip
          * 				|_ content          => <html>()...)</html>
+         * 				|_ gzip_content     => gzip compressed <html>()...)</html>
          *      /about
          *      	|_ content_type     => text/html; charset=utf-8
-         *      	|_ content_encoding => gzip
          * 				|_ content          => <html>()...)</html>
+         * 				|_ gzip_content     => gzip compressed <html>()...)</html>
          *      /about/index.html
          *      	|_ content_type     => text/html; charset=utf-8
-         *      	|_ content_encoding => gzip
          * 				|_ content          => <html>()...)</html>
+         * 				|_ gzip_content     => gzip compressed <html>()...)</html>
          *      /resources/js/cookinapps.min.js
          *      	|_ content_type     => text/javascript; charset=utf-8
-         *      	|_ content_encoding => gzip
          * 				|_ content          => console.log("content of a javascript resource.");
+         * 				|_ gzip_content     => gzip compressed console.log(...);
          *      /resources/img/image.png
          *      	|_ content_type     => text/javascript; charset=utf-8
-         *      	|_ content_encoding => ""
          *      	|_ content          => PNG ...
          */
-        std::unordered_map<std::string, granada::cache::Resource> files_;
+        std::shared_ptr<FileMap> files_;
+
+
+        /**
+         * Mutex for modifying the files map, readers do not lock, they
+         * take the current map with an atomic load.
+         */
+        std::mutex files_mutex_;
+
+
+        /**
+         * Bytes of cache memory left for loading files.
+         */
+        int cache_memory_ = 0;
+
+
+        /**
+         * Bytes of cache memory for loading files, taken from
+         * the maximum_cache_memory property.
+         */
+        int maximum_cache_memory_ = 0;
+
+
+        /**
+         * Statistics of the load of the files when the cache started.
+         */
+        LoadStats load_stats_;
 
 
         /**
@@ -245,16 +510,104 @@ namespace granada{
 
 
         /**
-         * JSON Array containing the extensions of the files that have to be gziped.
+         * JSON Array containing the extensions of the files that have to be compressed.
          */
         web::json::value gzip_extensions_;
 
 
         /**
-         * True if files will be gziped. False if not.
+         * True if files will be compressed. False if not.
          */
         bool gzip_content_ = false;
 
+
+        /**
+         * Files with this size in bytes or more are never loaded in memory,
+         * they are streamed from the hard drive. Taken from the stream_file_size
+         * property in MB, 1 MB by default.
+         */
+        std::uintmax_t stream_file_size_ = 1024 * 1024;
+
+
+        /**
+         * inotify file descriptor used to watch the root path,
+         * -1 if the root path is not watched. Taken from the cache_watch
+         * property (on:reload changed files;off:do not watch).
+         */
+        int watch_fd_ = -1;
+
+
+        /**
+         * Watch descriptors and the relative paths of the watched directories.
+         */
+        std::unordered_map<int, std::string> watches_;
+
+
+        /**
+         * Thread reloading the changed files.
+         */
+        std::thread watcher_;
+
+
+        /**
+         * False when the watcher thread has to stop.
+         */
+        std::atomic<bool> watching_;
+
+
+        /**
+         * True if files are loaded when they are requested
+         * instead of when the cache starts (cache_content=lazy).
+         */
+        bool lazy_ = false;
+
+
+        /**
+         * Number of times a file has to be requested to be lazily cached.
+         * Taken from the cache_admission_hits property, 2 by default.
+         */
+        int admission_hits_ = 2;
+
+
+        /**
+         * Lazily loaded files by requested path.
+         */
+        std::unordered_map<std::string, LazyResource> lazy_files_;
+
+
+        /**
+         * Paths of the lazily loaded files, the most recently used first.
+         */
+        std::list<std::string> lazy_order_;
+
+
+        /**
+         * Bytes used by the lazily loaded files, and maximum
+         * taken from the maximum_cache_memory property,
+         * 64 MB if the property is not set.
+         */
+        std::size_t lazy_memory_ = 0;
+        std::size_t lazy_maximum_memory_ = 64 * 1024 * 1024;
+
+
+        /**
+         * Mutex for the lazily loaded files and their order.
+         */
+        std::mutex lazy_mutex_;
+
+
+        /**
+         * Requests of the files that are not cached, to cache
+         * only the files that are requested frequently.
+         */
+        granada::util::bloom::counting_filter lazy_frequency_;
+
+
+        /**
+         * Misses counted since the requests were last forgotten.
+         */
+        std::atomic<std::size_t> lazy_misses_;
+
     };
   }
 }
@@ -71,5 +71,48 @@ namespace granada{
          */
         static std::unique_ptr<utility::nonce_generator> n_generator_;
     };
+
+
+    /**
+     * Generates random alphanumeric strings (A-Za-z0-9) from a
+     * cryptographically secure source (OpenSSL RAND_bytes).
+     * Each thread has its own buffer of random bytes, refilled a block at
+     * a time, so generating a nonce takes no lock and only calls the
+     * random source once every BUFFER_SIZE bytes. The bytes left in the
+     * buffers when the process forks are not used by the child process.
+     * This code is multi-thread safe.
+     */
+    class BufferedNonceGenerator : public NonceGenerator{
+
+      public:
+
+        /**
+         * Size in bytes of the buffer of random bytes of each thread.
+         */
+        static const std::size_t BUFFER_SIZE = 4096;
+
+
+        /**
+         * Constructor
+         */
+        BufferedNonceGenerator(){};
+
+
+        /**
+         * Destructor
+         */
+        virtual ~BufferedNonceGenerator(){};
+
+
+        /**
+         * Generate a random alphanumeric string
+         * with the given length.
+         * Throws std::runtime_error if the random source fails.
+         * 
+         * @param length  Length of the nonce.
+         * @return        Nonce.
+         */
+        std::string generate(int& length) override;
+    };
   }
 }
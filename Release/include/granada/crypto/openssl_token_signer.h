@@ -0,0 +1,282 @@
+/**
+  * Copyright (c) <2016> granada <afernandez@cookinapps.io>
+  *
+  * This source code is licensed under the MIT license.
+  *
+  * Permission is hereby granted, free of charge, to any person obtaining a copy
+  * of this software and associated documentation files (the "Software"), to deal
+  * in the Software without restriction, including without limitation the rights
+  * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  * copies of the Software, and to permit persons to whom the Software is
+  * furnished to do so, subject to the following conditions:
+  *
+  * The above copyright notice and this permission notice shall be included in
+  * all copies or substantial portions of the Software.
+  *
+  * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  * SOFTWARE.
+  *
+  * Signs tokens with HMAC-SHA256 and optionally encrypts
+  * their payload with AES-256-GCM, using OpenSSL.
+  *
+  */
+
+#pragma once
+#include <string>
+#include <vector>
+#include "token_signer.h"
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+#include <openssl/rand.h>
+#include <openssl/sha.h>
+
+namespace granada{
+  namespace crypto{
+    class OpensslTokenSigner : public TokenSigner{
+      public:
+
+        /**
+         * Constructor.
+         * The keys are derived from the given secrets with SHA-256.
+         * @param signing_secret    Secret used to sign the tokens.
+         * @param encryption_secret Secret used to encrypt the payload of the
+         *                          tokens, if empty tokens are only signed
+         *                          and their payload can be read by the client.
+         */
+        OpensslTokenSigner(const std::string& signing_secret, const std::string& encryption_secret){
+          signing_key_ = Digest(signing_secret);
+          if (!encryption_secret.empty()){
+            encryption_key_ = Digest(encryption_secret);
+          }
+        };
+
+
+        /**
+         * Destructor
+         */
+        virtual ~OpensslTokenSigner(){
+          OPENSSL_cleanse(&signing_key_[0], signing_key_.size());
+          if (!encryption_key_.empty()){
+            OPENSSL_cleanse(&encryption_key_[0], encryption_key_.size());
+          }
+        };
+
+
+        /**
+         * Signs a payload and returns a token containing it:
+         *    base64url(payload or iv|encrypted payload|tag) "." base64url(hmac)
+         * @param  payload  Payload to sign.
+         * @return          Signed token, empty if the payload could not be encrypted.
+         */
+        std::string Sign(const std::string& payload) override {
+          std::string body;
+          if (encryption_key_.empty()){
+            body = payload;
+          }else if (!Encrypt(payload, body)){
+            return std::string();
+          }
+          const std::string& encoded_body = Base64UrlEncode(body);
+          return encoded_body + "." + Base64UrlEncode(Hmac(encoded_body));
+        };
+
+
+        /**
+         * Verifies the signature of a token and extracts its payload.
+         * @param  token    Signed token.
+         * @param  payload  Payload contained in the token.
+         * @return          True if the token is valid, false if not.
+         */
+        bool Verify(const std::string& token, std::string& payload) override {
+          const std::size_t dot = token.rfind('.');
+          if (dot == std::string::npos){
+            return false;
+          }
+          const std::string encoded_body = token.substr(0, dot);
+          std::string signature;
+          if (!Base64UrlDecode(token.substr(dot + 1), signature)){
+            return false;
+          }
+          const std::string& expected = Hmac(encoded_body);
+          if (signature.size() != expected.size() || CRYPTO_memcmp(signature.data(), expected.data(), expected.size()) != 0){
+            return false;
+          }
+          std::string body;
+          if (!Base64UrlDecode(encoded_body, body)){
+            return false;
+          }
+          if (encryption_key_.empty()){
+            payload = std::move(body);
+            return true;
+          }
+          return Decrypt(body, payload);
+        };
+
+
+      private:
+
+        /**
+         * Length of the AES-GCM initialization vector.
+         */
+        static const int IV_LENGTH = 12;
+
+
+        /**
+         * Length of the AES-GCM authentication tag.
+         */
+        static const int TAG_LENGTH = 16;
+
+
+        /**
+         * Key used to sign the tokens.
+         */
+        std::string signing_key_;
+
+
+        /**
+         * Key used to encrypt the tokens' payload, empty if
+         * the payload is not encrypted.
+         */
+        std::string encryption_key_;
+
+
+        /**
+         * Returns the SHA-256 digest of a string.
+         */
+        static std::string Digest(const std::string& str){
+          unsigned char digest[SHA256_DIGEST_LENGTH];
+          SHA256(reinterpret_cast<const unsigned char*>(str.data()), str.size(), digest);
+          return std::string(reinterpret_cast<const char*>(digest), SHA256_DIGEST_LENGTH);
+        };
+
+
+        /**
+         * Returns the HMAC-SHA256 of a string using the signing key.
+         */
+        std::string Hmac(const std::string& str){
+          unsigned char mac[EVP_MAX_MD_SIZE];
+          unsigned int mac_length = 0;
+          HMAC(EVP_sha256(), signing_key_.data(), (int)signing_key_.size(), reinterpret_cast<const unsigned char*>(str.data()), str.size(), mac, &mac_length);
+          return std::string(reinterpret_cast<const char*>(mac), mac_length);
+        };
+
+
+        /**
+         * Encrypts a text with AES-256-GCM and a random initialization vector.
+         * @param  text       Text to encrypt.
+         * @param  encrypted  iv|encrypted text|tag.
+         * @return            True if the text has been encrypted.
+         */
+        bool Encrypt(const std::string& text, std::string& encrypted){
+          std::vector<unsigned char> out(IV_LENGTH + text.size() + TAG_LENGTH);
+          if (RAND_bytes(&out[0], IV_LENGTH) != 1){
+            return false;
+          }
+          EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
+          int length = 0;
+          bool ok = ctx != nullptr
+            && EVP_EncryptInit_ex(ctx, EVP_aes_256_gcm(), nullptr, nullptr, nullptr) == 1
+            && EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_IVLEN, IV_LENGTH, nullptr) == 1
+            && EVP_EncryptInit_ex(ctx, nullptr, nullptr, reinterpret_cast<const unsigned char*>(encryption_key_.data()), &out[0]) == 1
+            && EVP_EncryptUpdate(ctx, &out[IV_LENGTH], &length, reinterpret_cast<const unsigned char*>(text.data()), (int)text.size()) == 1
+            && EVP_EncryptFinal_ex(ctx, &out[IV_LENGTH] + length, &length) == 1
+            && EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_GET_TAG, TAG_LENGTH, &out[IV_LENGTH + text.size()]) == 1;
+          EVP_CIPHER_CTX_free(ctx);
+          if (ok){
+            encrypted.assign(reinterpret_cast<const char*>(out.data()), out.size());
+          }
+          return ok;
+        };
+
+
+        /**
+         * Decrypts and authenticates a text encrypted with Encrypt.
+         * @param  encrypted  iv|encrypted text|tag.
+         * @param  text       Decrypted text.
+         * @return            True if the text has been decrypted and authenticated.
+         */
+        bool Decrypt(const std::string& encrypted, std::string& text){
+          if (encrypted.size() < IV_LENGTH + TAG_LENGTH){
+            return false;
+          }
+          const unsigned char* in = reinterpret_cast<const unsigned char*>(encrypted.data());
+          const int text_length = (int)encrypted.size() - IV_LENGTH - TAG_LENGTH;
+          std::vector<unsigned char> out(text_length + 1);
+          std::vector<unsigned char> tag(in + IV_LENGTH + text_length, in + encrypted.size());
+          EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
+          int length = 0;
+          bool ok = ctx != nullptr
+            && EVP_DecryptInit_ex(ctx, EVP_aes_256_gcm(), nullptr, nullptr, nullptr) == 1
+            && EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_IVLEN, IV_LENGTH, nullptr) == 1
+            && EVP_DecryptInit_ex(ctx, nullptr, nullptr, reinterpret_cast<const unsigned char*>(encryption_key_.data()), in) == 1
+            && EVP_DecryptUpdate(ctx, &out[0], &length, in + IV_LENGTH, text_length) == 1
+            && EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_TAG, TAG_LENGTH, &tag[0]) == 1
+            && EVP_DecryptFinal_ex(ctx, &out[0] + length, &length) == 1;
+          EVP_CIPHER_CTX_free(ctx);
+          if (ok){
+            text.assign(reinterpret_cast<const char*>(out.data()), text_length);
+          }
+          return ok;
+        };
+
+
+        /**
+         * Encodes a string in base64url without padding,
+         * so it can be used in cookies and urls.
+         */
+        static std::string Base64UrlEncode(const std::string& str){
+          static const char* alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+          std::string encoded;
+          encoded.reserve((str.size() + 2) / 3 * 4);
+          unsigned int buffer = 0;
+          int bits = 0;
+          for (auto it = str.begin(); it != str.end(); ++it){
+            buffer = (buffer << 8) | (unsigned char)(*it);
+            bits += 8;
+            while (bits >= 6){
+              bits -= 6;
+              encoded.push_back(alphabet[(buffer >> bits) & 0x3F]);
+            }
+          }
+          if (bits > 0){
+            encoded.push_back(alphabet[(buffer << (6 - bits)) & 0x3F]);
+          }
+          return encoded;
+        };
+
+
+        /**
+         * Decodes a base64url string without padding.
+         * @return True if the string is valid base64url.
+         */
+        static bool Base64UrlDecode(const std::string& str, std::string& decoded){
+          decoded.clear();
+          decoded.reserve(str.size() * 3 / 4);
+          unsigned int buffer = 0;
+          int bits = 0;
+          for (auto it = str.begin(); it != str.end(); ++it){
+            const char c = *it;
+            int value;
+            if (c >= 'A' && c <= 'Z') value = c - 'A';
+            else if (c >= 'a' && c <= 'z') value = c - 'a' + 26;
+            else if (c >= '0' && c <= '9') value = c - '0' + 52;
+            else if (c == '-') value = 62;
+            else if (c == '_') value = 63;
+            else return false;
+            buffer = (buffer << 6) | value;
+            bits += 6;
+            if (bits >= 8){
+              bits -= 8;
+              decoded.push_back((char)((buffer >> bits) & 0xFF));
+            }
+          }
+          return true;
+        };
+    };
+  }
+}
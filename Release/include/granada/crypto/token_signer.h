@@ -0,0 +1,68 @@
+/**
+  * Copyright (c) <2016> granada <afernandez@cookinapps.io>
+  *
+  * This source code is licensed under the MIT license.
+  *
+  * Permission is hereby granted, free of charge, to any person obtaining a copy
+  * of this software and associated documentation files (the "Software"), to deal
+  * in the Software without restriction, including without limitation the rights
+  * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  * copies of the Software, and to permit persons to whom the Software is
+  * furnished to do so, subject to the following conditions:
+  *
+  * The above copyright notice and this permission notice shall be included in
+  * all copies or substantial portions of the Software.
+  *
+  * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  * SOFTWARE.
+  *
+  * Signs, verifies and optionally encrypts self-contained tokens.
+  *
+  */
+
+#pragma once
+#include <string>
+
+namespace granada{
+  namespace crypto{
+    class TokenSigner{
+      public:
+
+        /**
+         * Constructor
+         */
+        TokenSigner(){};
+
+
+        /**
+         * Destructor
+         */
+        virtual ~TokenSigner(){};
+
+
+        /**
+         * Signs a payload and returns a token containing it,
+         * the token can be stored in a cookie or in a url.
+         * @param  payload  Payload to sign.
+         * @return          Signed token.
+         */
+        virtual std::string Sign(const std::string& payload){ return std::string(); };
+
+
+        /**
+         * Verifies the signature of a token and extracts its payload.
+         * @param  token    Signed token.
+         * @param  payload  Payload contained in the token, set only if
+         *                  the token is valid.
+         * @return          True if the token has been signed by this
+         *                  signer and has not been altered, false if not.
+         */
+        virtual bool Verify(const std::string& token, std::string& payload){ return false; };
+    };
+  }
+}
@@ -0,0 +1,293 @@
+/**
+  * Copyright (c) <2016> Web App SDK granada <afernandez@cookinapps.io>
+  *
+  * This source code is licensed under the MIT license.
+  *
+  * Permission is hereby granted, free of charge, to any person obtaining a copy
+  * of this software and associated documentation files (the "Software"), to deal
+  * in the Software without restriction, including without limitation the rights
+  * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  * copies of the Software, and to permit persons to whom the Software is
+  * furnished to do so, subject to the following conditions:
+  *
+  * The above copyright notice and this permission notice shall be included in
+  * all copies or substantial portions of the Software.
+  *
+  * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  * SOFTWARE.
+  *
+  *
+  * Admission control of the HTTP requests handled by the controllers.
+  *
+  */
+
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory>
+#include "cpprest/http_listener.h"
+
+namespace granada{
+  namespace http{
+
+    /**
+     * Admission control: sheds the requests a controller cannot handle in time,
+     * so an overload gives fast 503 responses to some clients instead of slow
+     * responses to all of them.
+     */
+    namespace admission{
+
+      /**
+       * Adaptive limit of the requests a controller handles at once.
+       * The limit follows the latency: the lowest latency of each interval
+       * is compared to a long-term baseline of the lowest latencies of the
+       * controller, as CoDel does with the queue delay. If even the fastest
+       * request of an interval took more than twice the baseline, and more than
+       * the target, requests are waiting somewhere (cache, runner, thread pool)
+       * and the limit is decreased by the gradient between both latencies,
+       * at most by half. If not, and the limit has been used, it is increased
+       * by one. The baseline drops at once to a lower latency and rises slowly,
+       * so a controller whose requests are slow by nature keeps its limit.
+       * Acquiring and releasing never take a lock.
+       */
+      class Limiter{
+        public:
+
+          /**
+           * Constructor.
+           * 
+           * @param target        Latency in milliseconds under which the limit
+           *                      is never decreased.
+           * @param interval      Interval in milliseconds at which the limit is updated.
+           * @param initial_limit Initial number of requests handled at once.
+           * @param min_limit     Minimum number of requests handled at once.
+           * @param max_limit     Maximum number of requests handled at once.
+           */
+          Limiter(const long long target, const long long interval, const int initial_limit, const int min_limit, const int max_limit) :
+            target_(target > 0 ? target * 1000 : 1),
+            interval_(interval > 0 ? interval * 1000 : 100000),
+            min_limit_(min_limit > 0 ? min_limit : 1),
+            max_limit_(max_limit > min_limit_ ? max_limit : min_limit_),
+            limit_(std::min(std::max(initial_limit, min_limit_), max_limit_)),
+            in_flight_(0),
+            max_in_flight_(0),
+            min_latency_(std::numeric_limits<std::uint64_t>::max()),
+            baseline_(0),
+            interval_end_(Now() + interval_){};
+
+
+          /**
+           * Takes a place for a request.
+           * 
+           * @return  True if the request can be handled, then Release has to be
+           *          called when it ends, false if it has to be rejected.
+           */
+          bool TryAcquire(){
+            const int in_flight = in_flight_.fetch_add(1, std::memory_order_acq_rel) + 1;
+            if (in_flight > limit_.load(std::memory_order_relaxed)){
+              in_flight_.fetch_sub(1, std::memory_order_acq_rel);
+              return false;
+            }
+            int max_in_flight = max_in_flight_.load(std::memory_order_relaxed);
+            while (in_flight > max_in_flight && !max_in_flight_.compare_exchange_weak(max_in_flight, in_flight, std::memory_order_relaxed));
+            return true;
+          };
+
+
+          /**
+           * Frees the place of a request and takes its latency into account.
+           * 
+           * @param latency Microseconds the request took.
+           */
+          void Release(const std::uint64_t latency){
+            in_flight_.fetch_sub(1, std::memory_order_acq_rel);
+
+            std::uint64_t min_latency = min_latency_.load(std::memory_order_relaxed);
+            while (latency < min_latency && !min_latency_.compare_exchange_weak(min_latency, latency, std::memory_order_relaxed));
+
+            const long long now = Now();
+            long long interval_end = interval_end_.load(std::memory_order_relaxed);
+            if (now >= interval_end && interval_end_.compare_exchange_strong(interval_end, now + interval_, std::memory_order_acq_rel)){
+              // only one thread closes the interval.
+              Update(min_latency_.exchange(std::numeric_limits<std::uint64_t>::max(), std::memory_order_relaxed), max_in_flight_.exchange(0, std::memory_order_relaxed));
+            }
+          };
+
+
+          /**
+           * Returns the current limit.
+           * 
+           * @return Number of requests that can be handled at once.
+           */
+          int limit() const {
+            return limit_.load(std::memory_order_relaxed);
+          };
+
+
+          /**
+           * Returns the number of requests being handled.
+           * 
+           * @return Number of requests being handled.
+           */
+          int in_flight() const {
+            return in_flight_.load(std::memory_order_relaxed);
+          };
+
+
+          /**
+           * Returns the long-term lowest latency.
+           * 
+           * @return Baseline latency in microseconds, 0 before the first update.
+           */
+          std::uint64_t baseline() const {
+            return baseline_.load(std::memory_order_relaxed);
+          };
+
+        private:
+
+          /**
+           * Latency in microseconds under which the limit is never decreased.
+           */
+          const std::uint64_t target_;
+
+
+          /**
+           * Microseconds between two updates of the limit.
+           */
+          const long long interval_;
+
+
+          /**
+           * Minimum limit.
+           */
+          const int min_limit_;
+
+
+          /**
+           * Maximum limit.
+           */
+          const int max_limit_;
+
+
+          /**
+           * Number of requests that can be handled at once.
+           */
+          std::atomic<int> limit_;
+
+
+          /**
+           * Number of requests being handled.
+           */
+          std::atomic<int> in_flight_;
+
+
+          /**
+           * Highest number of requests handled at once in the current interval.
+           */
+          std::atomic<int> max_in_flight_;
+
+
+          /**
+           * Lowest latency of the current interval in microseconds.
+           */
+          std::atomic<std::uint64_t> min_latency_;
+
+
+          /**
+           * Long-term lowest latency in microseconds.
+           */
+          std::atomic<std::uint64_t> baseline_;
+
+
+          /**
+           * End of the current interval in microseconds.
+           */
+          std::atomic<long long> interval_end_;
+
+
+          /**
+           * Updates the limit at the end of an interval.
+           * 
+           * @param min_latency   Lowest latency of the interval.
+           * @param max_in_flight Highest number of requests handled at once.
+           */
+          void Update(const std::uint64_t min_latency, const int max_in_flight){
+            if (min_latency == std::numeric_limits<std::uint64_t>::max()){
+              // no request ended in the interval.
+              return;
+            }
+
+            // a sustained queue only raises the baseline by 1/64 per interval.
+            std::uint64_t baseline = baseline_.load(std::memory_order_relaxed);
+            if (baseline == 0 || min_latency < baseline){
+              baseline = min_latency;
+            }else{
+              baseline += (min_latency - baseline) / 64;
+            }
+            baseline_.store(baseline, std::memory_order_relaxed);
+
+            const int limit = limit_.load(std::memory_order_relaxed);
+            const std::uint64_t tolerated = std::max(target_, baseline * 2);
+            if (min_latency > tolerated){
+              const double gradient = std::max(0.5, (double)tolerated / (double)min_latency);
+              limit_.store(std::max(min_limit_, std::min(limit - 1, (int)(limit * gradient))), std::memory_order_relaxed);
+            }else if (max_in_flight * 2 >= limit){
+              limit_.store(std::min(max_limit_, limit + 1), std::memory_order_relaxed);
+            }
+          };
+
+
+          /**
+           * Returns a monotonic time in microseconds.
+           */
+          static long long Now(){
+            return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+          };
+
+
+          Limiter(const Limiter&) = delete;
+          Limiter& operator=(const Limiter&) = delete;
+      };
+
+
+      /**
+       * Wraps a handler so the requests over the limit are rejected with
+       * a 503 Service Unavailable response and a Retry-After header, without
+       * calling the handler. A request takes its place until it is replied.
+       * 
+       * @param  limiter      Limiter, shared by the handlers of a controller.
+       * @param  retry_after  Seconds of the Retry-After header.
+       * @param  handler      Handler.
+       * @return              Handler with admission control.
+       */
+      inline std::function<void(web::http::http_request)> Admit(const std::shared_ptr<Limiter>& limiter, const int retry_after, const std::function<void(web::http::http_request)>& handler){
+        const utility::string_t retry_after_str = utility::conversions::to_string_t(std::to_string(retry_after > 0 ? retry_after : 1));
+        return [limiter, retry_after_str, handler](web::http::http_request request){
+          if (!limiter->TryAcquire()){
+            web::http::http_response response(web::http::status_codes::ServiceUnavailable);
+            response.headers().add(U("Retry-After"), retry_after_str);
+            request.reply(response);
+            return;
+          }
+          const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+          request.get_response().then([limiter, start](pplx::task<web::http::http_response> task){
+            try{
+              task.get();
+            }catch(const std::exception e){}
+            limiter->Release(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count());
+          });
+          handler(request);
+        };
+      }
+    }
+  }
+}
@@ -27,6 +27,11 @@
   */
 #pragma once
 #include "cpprest/details/basic_types.h"
+#include "cpprest/rawptrstream.h"
+#include "cpprest/filestream.h"
+#include "granada/util/file.h"
+#include "granada/util/time.h"
+#include "granada/crypto/nonce_generator.h"
 #include "granada/cache/web_resource_cache.h"
 #include "granada/http/controller/controller.h"
 #include "granada/http/session/session.h"
@@ -68,6 +73,15 @@ namespace granada{
         virtual ~BrowserController(){};
 
 
+        /**
+         * Adds a route rule: paths matching the pattern never need
+         * a session, the session is not loaded nor opened for them.
+         * @param pattern   Pattern of the paths, "*" matches any sequence.
+         *                  Example: /img/*
+         */
+        void AddNoSessionPath(const std::string& pattern);
+
+
       private:
 
 
@@ -75,6 +89,67 @@ namespace granada{
         void handle_get(web::http::http_request request);
 
 
+        /**
+         * Patterns of the paths that never need a session.
+         * Taken from the "browser_no_session_paths" property (space separated),
+         * if not found it will take default_strings::browser_no_session_paths.
+         */
+        std::vector<std::string> no_session_paths_;
+
+
+        /**
+         * Loads the properties of the controller.
+         */
+        void LoadProperties();
+
+
+        /**
+         * Returns true if the resource with the given path needs a session.
+         * @param path  Path of the resource.
+         */
+        bool NeedsSession(const std::string& path);
+
+
+        /**
+         * Returns true if the client already has the current version of the resource
+         * according to the If-None-Match or, if not present, the If-Modified-Since header.
+         * The ETags of the compressed variants of the resource also match.
+         * @param  resource           Resource.
+         * @param  if_none_match      Value of the If-None-Match header.
+         * @param  if_modified_since  Value of the If-Modified-Since header.
+         * @return                    True if the resource has not been modified.
+         */
+        bool IsNotModified(const granada::cache::Resource& resource, const std::string& if_none_match, const std::string& if_modified_since);
+
+
+        /**
+         * Returns true if the ranges of a Range header can be sent according
+         * to the If-Range header: when it is not present, or when it is the ETag
+         * or the modification date of the current version of the resource.
+         * @param  resource Resource.
+         * @param  if_range Value of the If-Range header.
+         * @return          True if the ranges can be sent, false if the whole content has to be sent.
+         */
+        bool RangeApplies(const granada::cache::Resource& resource, const std::string& if_range);
+
+
+        /**
+         * Removes the quotes and the weak prefix (W/) of an ETag.
+         * @param  etag ETag, example: W/"17163160063112100381"
+         * @return      Unquoted ETag, example: 17163160063112100381
+         */
+        std::string UnquoteETag(const std::string& etag);
+
+
+        /**
+         * Returns the value of a Content-Range header.
+         * @param  range  First and last byte positions of the range.
+         * @param  length Length of the whole content.
+         * @return        Content-Range value, example: bytes 0-99/1000
+         */
+        std::string ContentRange(const std::pair<std::size_t,std::size_t>& range, const std::size_t length);
+
+
         /**
          * Web resource cache
          * Used to cache resources.
@@ -27,7 +27,12 @@
 
 #pragma once
 #include <memory>
+#include <string>
 #include "cpprest/http_listener.h"
+#include "granada/defaults.h"
+#include "granada/util/application.h"
+#include "granada/http/admission.h"
+#include "granada/http/metrics.h"
 
 
 using namespace web;
@@ -67,11 +72,84 @@ namespace granada{
 
         protected:
 
+          /**
+           * Returns a handler recording the metrics of the requests handled by
+           * the given handler, by route (path of the listener) and method.
+           * Example:
+           *      m_listener_->support(methods::GET, Instrument(methods::GET, std::bind(&MyController::handle_get, this, std::placeholders::_1)));
+           *
+           * @param  method   HTTP method handled by the handler.
+           * @param  handler  Handler.
+           * @return          Instrumented handler.
+           */
+          std::function<void(web::http::http_request)> Instrument(const web::http::method& method, const std::function<void(web::http::http_request)>& handler){
+            granada::http::metrics::RouteMetrics& metrics = granada::http::metrics::Registry::Instance().Route(utility::conversions::to_utf8string(m_listener_->uri().path()), utility::conversions::to_utf8string(method));
+            return granada::http::metrics::Instrument(metrics, handler);
+          };
+
+
+          /**
+           * Returns a handler rejecting with a 503 Service Unavailable response the
+           * requests over the adaptive limit of requests the controller handles at once,
+           * if the "admission_control" property is "true". If not, returns the same handler.
+           * All the handlers of a controller share the same limit.
+           * Example:
+           *      m_listener_->support(methods::GET, Instrument(methods::GET, Admit(std::bind(&MyController::handle_get, this, std::placeholders::_1))));
+           *
+           * @param  handler  Handler.
+           * @return          Handler with admission control.
+           */
+          std::function<void(web::http::http_request)> Admit(const std::function<void(web::http::http_request)>& handler){
+            if (!admission_limiter_){
+              std::string admission_control = granada::util::application::GetProperty(entity_keys::admission_control);
+              if (admission_control.empty()){
+                admission_control = default_strings::admission_control;
+              }
+              if (admission_control != entity_keys::_true){
+                return handler;
+              }
+              admission_limiter_ = std::make_shared<granada::http::admission::Limiter>(
+                AdmissionProperty(entity_keys::admission_target_latency, default_numbers::admission_target_latency),
+                AdmissionProperty(entity_keys::admission_interval, default_numbers::admission_interval),
+                AdmissionProperty(entity_keys::admission_initial_limit, default_numbers::admission_initial_limit),
+                AdmissionProperty(entity_keys::admission_min_limit, default_numbers::admission_min_limit),
+                AdmissionProperty(entity_keys::admission_max_limit, default_numbers::admission_max_limit));
+            }
+            return granada::http::admission::Admit(admission_limiter_, AdmissionProperty(entity_keys::admission_retry_after, default_numbers::admission_retry_after), handler);
+          };
+
+
           /**
            * Listener
            */
           std::unique_ptr<web::http::experimental::listener::http_listener> m_listener_;
 
+
+          /**
+           * Limit of the requests handled at once, shared by the handlers
+           * of the controller. Null if there is no admission control.
+           */
+          std::shared_ptr<granada::http::admission::Limiter> admission_limiter_;
+
+        private:
+
+          /**
+           * Returns the value of a numeric admission control property.
+           * 
+           * @param  name           Name of the property.
+           * @param  default_value  Value if the property is not found or is not a number.
+           * @return                Value of the property.
+           */
+          static int AdmissionProperty(const std::string& name, const int default_value){
+            const std::string& value = granada::util::application::GetProperty(name);
+            if (!value.empty()){
+              try{
+                return std::stoi(value);
+              }catch(const std::logic_error e){}
+            }
+            return default_value;
+          };
+
       };
     }
   }
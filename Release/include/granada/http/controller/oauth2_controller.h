@@ -39,6 +39,7 @@
 #include "granada/http/session/session.h"
 #include "granada/http/oauth2/oauth2.h"
 #include "granada/http/controller/controller.h"
+#include "granada/http/controller/response_cache.h"
 
 namespace granada{
   namespace http{
@@ -140,6 +141,14 @@ namespace granada{
           std::shared_ptr<granada::http::oauth2::OAuth2Factory> oauth2_factory_;
 
 
+          /**
+           * Responses of the info URI for a second, by user and client_id,
+           * so the clients polling it do not scan the cache on every request.
+           * Cleared when this controller grants or deletes an authorization.
+           */
+          ResponseCache info_cache_;
+
+
           /**
           * Load the templates and URIs from the server configuration file, if properties are not in this
           * file then take default values from granada/defaults.dat and granada/http/oauth2/oauth2.templates.
@@ -36,6 +36,7 @@
 #include "granada/defaults.h"
 #include "granada/util/mutex.h"
 #include "granada/util/time.h"
+#include "granada/util/rate_limiter.h"
 #include "granada/util/string.h"
 #include "granada/http/session/session.h"
 #include "granada/plugin/plugin.h"
@@ -85,6 +86,33 @@ namespace granada{
           static int PLUGIN_HANDLER_USE_FREQUENCY_LIMIT_;
 
 
+          /**
+           * Number of uses of the same plug-in handler allowed in a row,
+           * then the plug-in handler can be used once every
+           * PLUGIN_HANDLER_USE_FREQUENCY_LIMIT_ milliseconds.
+           * This property takes the value of the "plugin_handler_use_burst"
+           * property from the server.conf file, 1 by default.
+           */
+          static int PLUGIN_HANDLER_USE_BURST_;
+
+
+          /**
+           * True if the use limit is shared by all the processes using
+           * the cache of the plug-in handlers, for example a redis server.
+           * False by default, each process limits the uses it receives.
+           * The value of this property is taken from the property
+           * "plugin_handler_use_limit_shared" of the server configuration file.
+           */
+          static bool PLUGIN_HANDLER_USE_LIMIT_SHARED_;
+
+
+          /**
+           * Token buckets of the plug-in handlers used by this process,
+           * used when the limit is not shared.
+           */
+          static std::unique_ptr<granada::util::rate::token_buckets> plugin_handler_buckets_;
+
+
           /**
            * True if the client is allowed to fire plug-in events
            * in the server. False if not. True by default.
@@ -183,13 +211,16 @@ namespace granada{
 
 
           /**
-           * Locks the thread until Plug-in Handler is usable. Plug-in Handler use
-           * can be limited using the PLUGIN_HANDLER_USE_FREQUENCY_LIMIT_ to prevent
-           * abuse.
+           * Takes a use of the Plug-in Handler without blocking. Plug-in Handler use
+           * can be limited using the PLUGIN_HANDLER_USE_FREQUENCY_LIMIT_ and
+           * PLUGIN_HANDLER_USE_BURST_ to prevent abuse, requests over the limit
+           * are answered with a 429 Too Many Requests response.
            * 
            * @param plugin_handler Plug-in Handler.
+           * @return               0 if the Plug-in Handler can be used, if not the
+           *                       milliseconds until it can be used again.
            */
-          virtual void PluginHandlerLock(granada::plugin::PluginHandler* plugin_handler);
+          virtual long long PluginHandlerThrottle(granada::plugin::PluginHandler* plugin_handler);
 
 
           /**
@@ -303,7 +334,21 @@ namespace granada{
 
 
           /**
-           * Handles POST HTTP request.
+           * Fires an event, runs a plug-in, sends a message or runs a command
+           * depending on the fields of the JSON body of the request.
+           * Called once the runner is admitted for the Plug-in Handler.
+           * 
+           * @param request         HTTP request.
+           * @param plugin_handler  Plugin Handler.
+           * 
+           * @return                Response for the client.
+           */
+          virtual web::json::value ProcessRequest(web::http::http_request& request, granada::plugin::PluginHandler* plugin_handler);
+
+
+          /**
+           * Handles POST HTTP request. The request waits for the runner
+           * as a task, it does not keep a thread busy while queued.
            * 
            * @param request HTTP request.
            */
@@ -0,0 +1,329 @@
+/**
+  * Copyright (c) <2016> Web App SDK granada <afernandez@cookinapps.io>
+  *
+  * This source code is licensed under the MIT license.
+  *
+  * Permission is hereby granted, free of charge, to any person obtaining a copy
+  * of this software and associated documentation files (the "Software"), to deal
+  * in the Software without restriction, including without limitation the rights
+  * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  * copies of the Software, and to permit persons to whom the Software is
+  * furnished to do so, subject to the following conditions:
+  *
+  * The above copyright notice and this permission notice shall be included in
+  * all copies or substantial portions of the Software.
+  *
+  * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  * SOFTWARE.
+  *
+  * Short-lived cache of the responses of controllers.
+  *
+  */
+
+#pragma once
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "cpprest/http_listener.h"
+#include "cpprest/rawptrstream.h"
+#include "granada/http/parser.h"
+
+namespace granada{
+  namespace http{
+    namespace controller{
+
+      /**
+       * Opt-in cache of the responses of the GET requests of a controller,
+       * for endpoints returning the same response to many clients within
+       * a short time. Responses are keyed by method, path, the values of the
+       * selected query parameters and a vary key given by the controller
+       * (e.g. the roles of the session), and kept for a short time (TTL).
+       * When several requests with the same key miss the cache at the same time
+       * only the first one computes the response, the others are answered with it
+       * once it is computed (single-flight), without blocking their threads.
+       * Only 200 responses without cookies are cached.
+       * Example:
+       *      ResponseCache response_cache_(std::chrono::milliseconds(1000), {"client_id"});
+       *
+       *      void handle_get(http_request request){
+       *        response_cache_.Reply(request, "", [](){
+       *          http_response response(status_codes::OK);
+       *          response.set_body(ListPlugins());
+       *          return response;
+       *        });
+       *      }
+       */
+      class ResponseCache{
+        public:
+
+          /**
+           * Constructor.
+           * @param ttl           Time the responses are cached.
+           * @param query_keys    Keys of the query parameters that are part of the cache key,
+           *                      the other query parameters are ignored.
+           * @param max_entries   Maximum number of cached responses.
+           */
+          ResponseCache(const std::chrono::milliseconds& ttl, const std::vector<std::string>& query_keys, const std::size_t max_entries = 1024) :
+            ttl_(ttl),
+            query_keys_(query_keys),
+            max_entries_(max_entries > 0 ? max_entries : 1){};
+
+
+          /**
+           * Replies to a request with its cached response, or with the response
+           * computed by compute if it is not cached or it has expired. If the
+           * response for the same key is being computed by another request,
+           * the request is answered in a continuation once it is computed, and
+           * this function returns at once. compute is copied, as it may be called
+           * in that continuation if the response can not be shared.
+           * @param request   HTTP request.
+           * @param vary      Key of the variant of the response, requests with different
+           *                  vary keys get different responses.
+           * @param compute   Function returning the response.
+           */
+          void Reply(const web::http::http_request& request, const std::string& vary, const std::function<web::http::http_response()>& compute){
+            const std::string key = Key(request, vary);
+
+            std::shared_ptr<const Entry> entry;
+            std::shared_ptr<Flight> flight;
+            bool leader = false;
+            {
+              std::lock_guard<std::mutex> lock(mutex_);
+              auto it = entries_.find(key);
+              if (it != entries_.end() && it->second->expiration > std::chrono::steady_clock::now()){
+                entry = it->second;
+              }else{
+                auto flight_it = flights_.find(key);
+                if (flight_it == flights_.end()){
+                  flight.reset(new Flight());
+                  flight->generation = generation_;
+                  flights_.insert(std::make_pair(key, flight));
+                  leader = true;
+                }else{
+                  flight = flight_it->second;
+                }
+              }
+            }
+
+            if (entry){
+              Send(request, entry);
+              return;
+            }
+
+            if (!leader){
+              // answer when the request computing the response is done,
+              // the thread is not held while waiting.
+              const web::http::http_request waiting = request;
+              const std::function<web::http::http_response()> computing = compute;
+              pplx::create_task(flight->landed).then([waiting, computing](std::shared_ptr<const Entry> landed){
+                if (landed){
+                  Send(waiting, landed);
+                  return;
+                }
+                // the response could not be shared, compute another one.
+                try{
+                  waiting.reply(computing());
+                }catch(const std::exception e){
+                  waiting.reply(web::http::status_codes::InternalError);
+                }
+              });
+              return;
+            }
+
+            web::http::http_response response;
+            try{
+              response = compute();
+              entry = MakeEntry(response);
+            }catch(const std::exception e){
+              Land(key, flight, nullptr);
+              throw;
+            }
+            Land(key, flight, entry);
+
+            if (entry){
+              Send(request, entry);
+            }else{
+              request.reply(response);
+            }
+          };
+
+
+          /**
+           * Removes all the cached responses. The responses being computed
+           * are not cached when they are done, they may be stale, and the
+           * next requests compute new ones.
+           */
+          void Clear(){
+            std::lock_guard<std::mutex> lock(mutex_);
+            ++generation_;
+            entries_.clear();
+            flights_.clear();
+          };
+
+        private:
+
+          /**
+           * Cached response.
+           */
+          struct Entry{
+            web::http::status_code status_code;
+            web::http::http_headers headers;
+            std::vector<unsigned char> body;
+            std::chrono::steady_clock::time_point expiration;
+          };
+
+
+          /**
+           * Response being computed, landed is set when it is done, the waiting
+           * requests are answered in its continuations. The entry it is set with
+           * is nullptr if the response can not be shared.
+           */
+          struct Flight{
+            pplx::task_completion_event<std::shared_ptr<const Entry>> landed;
+
+            /**
+             * Generation of the cache when the flight started.
+             */
+            unsigned long long generation;
+          };
+
+
+          /**
+           * Time the responses are cached.
+           */
+          const std::chrono::milliseconds ttl_;
+
+
+          /**
+           * Keys of the query parameters that are part of the cache key.
+           */
+          const std::vector<std::string> query_keys_;
+
+
+          /**
+           * Maximum number of cached responses.
+           */
+          const std::size_t max_entries_;
+
+
+          /**
+           * Mutex for the cached responses and the responses being computed.
+           */
+          std::mutex mutex_;
+
+
+          /**
+           * Cached responses by key.
+           */
+          std::unordered_map<std::string, std::shared_ptr<const Entry>> entries_;
+
+
+          /**
+           * Responses being computed by key.
+           */
+          std::unordered_map<std::string, std::shared_ptr<Flight>> flights_;
+
+
+          /**
+           * Incremented by Clear, responses computed by flights
+           * of an older generation are not cached.
+           */
+          unsigned long long generation_ = 0;
+
+
+          /**
+           * Returns the cache key of a request: method, path,
+           * values of the selected query parameters and vary key.
+           */
+          std::string Key(const web::http::http_request& request, const std::string& vary){
+            std::string key = utility::conversions::to_utf8string(request.method()) + " " + utility::conversions::to_utf8string(request.request_uri().path());
+            if (!query_keys_.empty()){
+              const std::string query = utility::conversions::to_utf8string(request.request_uri().query());
+              for (auto it = query_keys_.begin(); it != query_keys_.end(); ++it){
+                key += "&" + *it + "=" + granada::http::parser::FindQueryParameter(query, *it).to_string();
+              }
+            }
+            return key + "|" + vary;
+          };
+
+
+          /**
+           * Returns the entry caching a response, nullptr if
+           * the response can not be cached.
+           */
+          std::shared_ptr<const Entry> MakeEntry(web::http::http_response& response){
+            if (response.status_code() != web::http::status_codes::OK || response.headers().has(utility::conversions::to_string_t(entity_keys::session_set_cookie))){
+              return nullptr;
+            }
+            std::shared_ptr<Entry> entry(new Entry());
+            entry->status_code = response.status_code();
+            entry->headers = response.headers();
+            entry->body = response.extract_vector().get();
+            entry->expiration = std::chrono::steady_clock::now() + ttl_;
+            return entry;
+          };
+
+
+          /**
+           * Caches the computed response, unless the cache has been cleared
+           * since the flight started, and answers the requests waiting for it.
+           */
+          void Land(const std::string& key, const std::shared_ptr<Flight>& flight, const std::shared_ptr<const Entry>& entry){
+            {
+              std::lock_guard<std::mutex> lock(mutex_);
+              auto flight_it = flights_.find(key);
+              if (flight_it != flights_.end() && flight_it->second == flight){
+                flights_.erase(flight_it);
+              }
+              if (entry && flight->generation == generation_){
+                if (entries_.size() >= max_entries_){
+                  // remove the expired responses, or any response if none has expired.
+                  const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+                  for (auto it = entries_.begin(); it != entries_.end();){
+                    if (it->second->expiration <= now){
+                      it = entries_.erase(it);
+                    }else{
+                      ++it;
+                    }
+                  }
+                  if (entries_.size() >= max_entries_){
+                    entries_.erase(entries_.begin());
+                  }
+                }
+                entries_[key] = entry;
+              }
+            }
+            flight->landed.set(entry);
+          };
+
+
+          /**
+           * Replies with a cached response, its body is not copied,
+           * the entry is kept alive until the response has been sent.
+           */
+          static void Send(const web::http::http_request& request, const std::shared_ptr<const Entry>& entry){
+            web::http::http_response response(entry->status_code);
+            response.headers() = entry->headers;
+            if (!entry->body.empty()){
+              concurrency::streams::rawptr_buffer<uint8_t> buffer(entry->body.data(), entry->body.size());
+              response.set_body(concurrency::streams::istream(buffer), entry->body.size(), entry->headers.content_type());
+            }
+            request.reply(response).then([entry](pplx::task<void> t){
+              try{
+                t.get();
+              }catch(const std::exception e){}
+            });
+          };
+      };
+    }
+  }
+}
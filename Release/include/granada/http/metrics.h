@@ -0,0 +1,366 @@
+/**
+  * Copyright (c) <2016> Web App SDK granada <afernandez@cookinapps.io>
+  *
+  * This source code is licensed under the MIT license.
+  *
+  * Permission is hereby granted, free of charge, to any person obtaining a copy
+  * of this software and associated documentation files (the "Software"), to deal
+  * in the Software without restriction, including without limitation the rights
+  * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  * copies of the Software, and to permit persons to whom the Software is
+  * furnished to do so, subject to the following conditions:
+  *
+  * The above copyright notice and this permission notice shall be included in
+  * all copies or substantial portions of the Software.
+  *
+  * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  * SOFTWARE.
+  *
+  * Metrics of the HTTP requests handled by the controllers.
+  *
+  */
+
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "cpprest/http_listener.h"
+
+namespace granada{
+  namespace http{
+
+    /**
+     * Metrics of the HTTP requests handled by the controllers,
+     * in Prometheus text format.
+     */
+    namespace metrics{
+
+      /**
+       * Metrics of the requests of a route (the path of a controller) and
+       * a method: number of requests by status class, bytes received and sent,
+       * and a latency histogram.
+       * The latency histogram is a log-linear (HDR) histogram of microseconds with
+       * 8 buckets per power of two, so each bucket is at most 12.5% wide.
+       * Counters are split in stripes, each thread records in its own stripe
+       * with relaxed atomic additions, without locks, and the stripes
+       * are added up when the metrics are read.
+       */
+      class RouteMetrics{
+        public:
+
+          /**
+           * Number of latency buckets, up to about 2^40 microseconds.
+           */
+          static const std::size_t BUCKETS = 312;
+
+
+          /**
+           * Constructor.
+           * @param route   Route, example: /plugin
+           * @param method  HTTP method, example: POST
+           */
+          RouteMetrics(const std::string& route, const std::string& method) : route_(route), method_(method){
+            for (std::size_t i = 0; i < STRIPES; ++i){
+              Stripe& stripe = stripes_[i];
+              for (std::size_t j = 0; j < 5; ++j){
+                stripe.status[j].store(0, std::memory_order_relaxed);
+              }
+              stripe.bytes_in.store(0, std::memory_order_relaxed);
+              stripe.bytes_out.store(0, std::memory_order_relaxed);
+              stripe.latency_sum.store(0, std::memory_order_relaxed);
+              for (std::size_t j = 0; j < BUCKETS; ++j){
+                stripe.buckets[j].store(0, std::memory_order_relaxed);
+              }
+            }
+          };
+
+
+          /**
+           * Returns the route.
+           */
+          const std::string& route(){
+            return route_;
+          };
+
+
+          /**
+           * Returns the HTTP method.
+           */
+          const std::string& method(){
+            return method_;
+          };
+
+
+          /**
+           * Records a request. Can be called from any thread.
+           * @param status_code HTTP status code of the response.
+           * @param bytes_in    Bytes of the body of the request.
+           * @param bytes_out   Bytes of the body of the response.
+           * @param latency     Microseconds until the response was ready.
+           */
+          void Record(const int status_code, const std::uint64_t bytes_in, const std::uint64_t bytes_out, const std::uint64_t latency){
+            Stripe& stripe = stripes_[StripeIndex()];
+            int status_class = status_code / 100 - 1;
+            if (status_class < 0 || status_class > 4){
+              status_class = 4;
+            }
+            stripe.status[status_class].fetch_add(1, std::memory_order_relaxed);
+            stripe.bytes_in.fetch_add(bytes_in, std::memory_order_relaxed);
+            stripe.bytes_out.fetch_add(bytes_out, std::memory_order_relaxed);
+            stripe.latency_sum.fetch_add(latency, std::memory_order_relaxed);
+            stripe.buckets[BucketIndex(latency)].fetch_add(1, std::memory_order_relaxed);
+          };
+
+
+          /**
+           * Appends the metrics in Prometheus text format, one line per sample.
+           * The histogram buckets are reduced to the le bounds of the
+           * Prometheus histogram, and p50, p90, p99 and p999 are given as quantiles.
+           * @param requests    Samples of granada_http_requests_total.
+           * @param bytes       Samples of granada_http_request_bytes_total and granada_http_response_bytes_total.
+           * @param histogram   Samples of granada_http_request_duration_seconds.
+           * @param quantiles   Samples of granada_http_request_duration_quantile_seconds.
+           */
+          void Write(std::ostringstream& requests, std::ostringstream& bytes, std::ostringstream& histogram, std::ostringstream& quantiles){
+            std::uint64_t status[5] = {0, 0, 0, 0, 0};
+            std::uint64_t bytes_in = 0;
+            std::uint64_t bytes_out = 0;
+            std::uint64_t latency_sum = 0;
+            std::vector<std::uint64_t> buckets(BUCKETS, 0);
+            for (std::size_t i = 0; i < STRIPES; ++i){
+              Stripe& stripe = stripes_[i];
+              for (std::size_t j = 0; j < 5; ++j){
+                status[j] += stripe.status[j].load(std::memory_order_relaxed);
+              }
+              bytes_in += stripe.bytes_in.load(std::memory_order_relaxed);
+              bytes_out += stripe.bytes_out.load(std::memory_order_relaxed);
+              latency_sum += stripe.latency_sum.load(std::memory_order_relaxed);
+              for (std::size_t j = 0; j < BUCKETS; ++j){
+                buckets[j] += stripe.buckets[j].load(std::memory_order_relaxed);
+              }
+            }
+
+            const std::string labels = "route=\"" + route_ + "\",method=\"" + method_ + "\"";
+            std::uint64_t count = 0;
+            for (std::size_t j = 0; j < 5; ++j){
+              count += status[j];
+              if (status[j] > 0){
+                requests << "granada_http_requests_total{" << labels << ",status=\"" << j + 1 << "xx\"} " << status[j] << "\n";
+              }
+            }
+            bytes << "granada_http_request_bytes_total{" << labels << "} " << bytes_in << "\n";
+            bytes << "granada_http_response_bytes_total{" << labels << "} " << bytes_out << "\n";
+
+            // cumulative counts of the buckets under each bound.
+            static const double bounds[] = {0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10};
+            std::size_t bucket = 0;
+            std::uint64_t cumulative = 0;
+            for (const double bound : bounds){
+              const std::uint64_t bound_microseconds = (std::uint64_t)(bound * 1000000);
+              while (bucket < BUCKETS && BucketUpperBound(bucket) <= bound_microseconds){
+                cumulative += buckets[bucket++];
+              }
+              histogram << "granada_http_request_duration_seconds_bucket{" << labels << ",le=\"" << bound << "\"} " << cumulative << "\n";
+            }
+            histogram << "granada_http_request_duration_seconds_bucket{" << labels << ",le=\"+Inf\"} " << count << "\n";
+            histogram << "granada_http_request_duration_seconds_sum{" << labels << "} " << latency_sum / 1000000.0 << "\n";
+            histogram << "granada_http_request_duration_seconds_count{" << labels << "} " << count << "\n";
+
+            if (count > 0){
+              static const double quantile_values[] = {0.5, 0.9, 0.99, 0.999};
+              for (const double quantile : quantile_values){
+                // upper bound of the bucket containing the quantile.
+                const std::uint64_t rank = (std::uint64_t)(quantile * count + 0.5);
+                std::uint64_t seen = 0;
+                std::size_t j = 0;
+                for (; j < BUCKETS - 1; ++j){
+                  seen += buckets[j];
+                  if (seen >= rank && seen > 0){
+                    break;
+                  }
+                }
+                quantiles << "granada_http_request_duration_quantile_seconds{" << labels << ",quantile=\"" << quantile << "\"} " << BucketUpperBound(j) / 1000000.0 << "\n";
+              }
+            }
+          };
+
+
+          /**
+           * Returns the index of the bucket of a latency in microseconds:
+           * the latency itself under 8, then 8 buckets per power of two.
+           */
+          static std::size_t BucketIndex(const std::uint64_t latency){
+            if (latency < 8){
+              return (std::size_t)latency;
+            }
+            int msb = 3;
+            while (msb < 63 && (latency >> (msb + 1)) != 0){
+              ++msb;
+            }
+            const std::size_t index = (msb - 2) * 8 + ((latency >> (msb - 3)) & 7);
+            return index < BUCKETS ? index : BUCKETS - 1;
+          };
+
+
+          /**
+           * Returns the highest latency in microseconds of a bucket.
+           */
+          static std::uint64_t BucketUpperBound(const std::size_t index){
+            if (index < 8){
+              return index;
+            }
+            const int msb = (int)(index / 8) + 2;
+            return ((std::uint64_t)(8 + index % 8) << (msb - 3)) + ((std::uint64_t)1 << (msb - 3)) - 1;
+          };
+
+        private:
+
+          /**
+           * Number of stripes.
+           */
+          static const std::size_t STRIPES = 8;
+
+
+          /**
+           * Counters of a stripe, aligned so two stripes
+           * do not share a cache line.
+           */
+          struct alignas(64) Stripe{
+            std::atomic<std::uint64_t> status[5];
+            std::atomic<std::uint64_t> bytes_in;
+            std::atomic<std::uint64_t> bytes_out;
+            std::atomic<std::uint64_t> latency_sum;
+            std::atomic<std::uint64_t> buckets[BUCKETS];
+          };
+
+
+          /**
+           * Returns the stripe of the current thread.
+           */
+          static std::size_t StripeIndex(){
+            static thread_local const std::size_t index = std::hash<std::thread::id>()(std::this_thread::get_id()) % STRIPES;
+            return index;
+          };
+
+
+          const std::string route_;
+          const std::string method_;
+          Stripe stripes_[STRIPES];
+      };
+
+
+      /**
+       * Metrics of all the routes, shared by the whole process.
+       */
+      class Registry{
+        public:
+
+          /**
+           * Returns the registry of the process.
+           */
+          static Registry& Instance(){
+            static Registry registry;
+            return registry;
+          };
+
+
+          /**
+           * Returns the metrics of a route and a method, creating them if
+           * they do not exist. The metrics live as long as the process.
+           * @param route   Route, example: /plugin
+           * @param method  HTTP method, example: POST
+           * @return        Metrics of the route and method.
+           */
+          RouteMetrics& Route(const std::string& route, const std::string& method){
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (auto it = routes_.begin(); it != routes_.end(); ++it){
+              if ((*it)->route() == route && (*it)->method() == method){
+                return **it;
+              }
+            }
+            routes_.push_back(std::unique_ptr<RouteMetrics>(new RouteMetrics(route, method)));
+            return *routes_.back();
+          };
+
+
+          /**
+           * Returns the metrics of all the routes in Prometheus text format.
+           */
+          std::string Prometheus(){
+            std::ostringstream requests;
+            std::ostringstream bytes;
+            std::ostringstream histogram;
+            std::ostringstream quantiles;
+            {
+              std::lock_guard<std::mutex> lock(mutex_);
+              for (auto it = routes_.begin(); it != routes_.end(); ++it){
+                (*it)->Write(requests, bytes, histogram, quantiles);
+              }
+            }
+            std::ostringstream out;
+            out << "# HELP granada_http_requests_total HTTP requests by route, method and status class.\n";
+            out << "# TYPE granada_http_requests_total counter\n" << requests.str();
+            out << "# HELP granada_http_request_bytes_total Bytes received in request bodies.\n";
+            out << "# TYPE granada_http_request_bytes_total counter\n";
+            out << "# HELP granada_http_response_bytes_total Bytes sent in response bodies.\n";
+            out << "# TYPE granada_http_response_bytes_total counter\n" << bytes.str();
+            out << "# HELP granada_http_request_duration_seconds Time until the response is ready.\n";
+            out << "# TYPE granada_http_request_duration_seconds histogram\n" << histogram.str();
+            out << "# HELP granada_http_request_duration_quantile_seconds Quantiles of the time until the response is ready.\n";
+            out << "# TYPE granada_http_request_duration_quantile_seconds gauge\n" << quantiles.str();
+            return out.str();
+          };
+
+        private:
+
+          /**
+           * Mutex for the routes.
+           */
+          std::mutex mutex_;
+
+
+          /**
+           * Metrics of the routes.
+           */
+          std::vector<std::unique_ptr<RouteMetrics>> routes_;
+      };
+
+
+      /**
+       * Returns a handler recording the metrics of the requests handled by
+       * the given handler: the latency is measured until the response is
+       * ready to be sent (http_request::reply), bytes from the Content-Length headers.
+       * @param  metrics  Metrics of the route and method of the handler.
+       * @param  handler  Handler of the requests.
+       * @return          Instrumented handler.
+       */
+      inline std::function<void(web::http::http_request)> Instrument(RouteMetrics& metrics, const std::function<void(web::http::http_request)>& handler){
+        RouteMetrics* route_metrics = &metrics;
+        return [route_metrics, handler](web::http::http_request request){
+          const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+          const std::uint64_t bytes_in = request.headers().content_length();
+          request.get_response().then([route_metrics, start, bytes_in](pplx::task<web::http::http_response> task){
+            try{
+              web::http::http_response response = task.get();
+              const std::uint64_t latency = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+              route_metrics->Record(response.status_code(), bytes_in, response.headers().content_length(), latency);
+            }catch(const std::exception e){}
+          });
+          handler(request);
+        };
+      }
+    }
+  }
+}
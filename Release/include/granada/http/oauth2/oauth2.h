@@ -33,6 +33,7 @@
 #include <string>
 #include <deque>
 #include <unordered_map>
+#include <stdexcept>
 #include "cpprest/details/basic_types.h"
 #include "cpprest/json.h"
 #include "cpprest/http_msg.h"
@@ -424,6 +425,7 @@ namespace granada{
            *                         Example:
            *                         		MSG_INSERT => this role will give the client the permission to create user messages.
            * @param secret          Password of the client, the client can use it to ask for a OAuth 2.0 code.
+           * @throws std::runtime_error If the client could not be stored in the cache.
            */
           virtual void Create(const std::string& type, const std::vector<std::string>& redirect_uris, const std::string& application_name, const std::vector<std::string>& roles, std::string& secret);
 
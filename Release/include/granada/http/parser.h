@@ -28,7 +28,10 @@
 
 #include <string>
 #include <sstream>
+#include <fstream>
+#include <vector>
 #include <unordered_map>
+#include <boost/utility/string_ref.hpp>
 #include "cpprest/details/basic_types.h"
 #include "cpprest/http_listener.h"
 #include "cpprest/base_uri.h"
@@ -66,6 +69,69 @@ namespace granada{
       std::unordered_map<std::string, std::string> ParseQueryString(const std::string& query_string);
 
 
+      /**
+       * Key-value pairs pointing into the parsed string, they are only
+       * valid while the parsed string is not modified or destroyed.
+       */
+      typedef std::vector<std::pair<boost::string_ref, boost::string_ref>> StringRefPairs;
+
+
+      /**
+       * Parse the value of a Cookie header in place, without copying
+       * the names and contents of the cookies.
+       * Example:
+       *      cookie1=content1; cookie2=content2
+       *
+       * will be parsed into:
+       *      cookies (vector)
+       *        |_ (cookie1, content1)
+       *        |_ (cookie2, content2)
+       *
+       * @param cookies Value of the Cookie header.
+       * @param parsed  Vector where the cookies are inserted in order.
+       */
+      void ParseCookies(const boost::string_ref& cookies, StringRefPairs& parsed);
+
+
+      /**
+       * Returns the content of the first cookie with the given name, found
+       * scanning the value of the Cookie header in place.
+       * @param  cookies  Value of the Cookie header.
+       * @param  name     Name of the cookie.
+       * @return          Content of the cookie, empty if there is no such cookie.
+       */
+      boost::string_ref FindCookie(const boost::string_ref& cookies, const boost::string_ref& name);
+
+
+      /**
+       * Parse a query string in place, without copying the keys and values.
+       * Values are not decoded, use web::uri::decode on the values
+       * containing percent-encoded characters.
+       * Example:
+       *      id=0&quantity=2
+       *
+       * will be parsed into:
+       *      query (vector)
+       *        |_ (id, 0)
+       *        |_ (quantity, 2)
+       *
+       * @param query_string  Query string.
+       * @param parsed        Vector where the keys and values are inserted in order.
+       */
+      void ParseQueryString(const boost::string_ref& query_string, StringRefPairs& parsed);
+
+
+      /**
+       * Returns the value of the last parameter with the given key and a
+       * non empty value, found scanning the query string in place.
+       * The value is not decoded.
+       * @param  query_string Query string.
+       * @param  key          Key of the parameter.
+       * @return              Value of the parameter, empty if there is no such parameter.
+       */
+      boost::string_ref FindQueryParameter(const boost::string_ref& query_string, const boost::string_ref& key);
+
+
       /*
        * Parse an http_request with multipart/form data content type into a unordered_map.
        * example:
@@ -97,6 +163,10 @@ namespace granada{
        * 		|_ filename (vector<unsigned char>)
        * 		|_ Content-Type (vector<unsigned char>)
        *
+       * The body is parsed with a MultipartParser keeping all the parts in memory,
+       * use ParseMultipartFormData with a MultipartParser to write large parts
+       * to temporary files instead.
+       *
        * @param request HTTP request containing multipart/form data.
        * @return        Parsed multipart/form data content.
        */
@@ -145,6 +215,178 @@ namespace granada{
       std::vector<unsigned char>::iterator GetIteratorMDF(const char *chr, std::vector<unsigned char> &body, const bool end);
 
 
+      /**
+       * Part of a multipart/form-data body, with the properties of its
+       * Content-Disposition (name, filename) and Content-Type headers.
+       * The content of the part is in value, or if it is larger than the spill size
+       * of the parser, in a temporary file with path file_path, removed when the
+       * parser is destroyed unless it has been moved. size is the size
+       * of the content in bytes.
+       */
+      struct MultipartPart{
+        std::string name;
+        std::string filename;
+        std::string content_type;
+        std::vector<unsigned char> value;
+        std::string file_path;
+        std::size_t size = 0;
+      };
+
+
+      /**
+       * Incremental parser of multipart/form-data bodies. The body is consumed
+       * chunk by chunk by a state machine, so it never has to be in memory at once.
+       * Boundaries are searched with Boyer-Moore-Horspool and each byte of the body
+       * is copied once, to the value of its part or to its temporary file, so parsing
+       * time is linear in the size of the body.
+       * Example:
+       *      MultipartParser parser(boundary, 1024 * 1024);
+       *      ParseMultipartFormData(request, parser);
+       *      for (auto& part : parser.GetParts()) ...
+       */
+      class MultipartParser{
+        public:
+
+          /**
+           * Constructor.
+           * @param boundary    Boundary of the multipart/form-data body, without the leading dashes
+           *                    of the delimiter. Example: ----WebKitFormBoundaryKS484Mi6jduf07q
+           * @param spill_size  Parts with more bytes are written to temporary files.
+           */
+          MultipartParser(const std::string& boundary, const std::size_t spill_size);
+
+
+          /**
+           * Destructor, removes the temporary files of the parts.
+           */
+          virtual ~MultipartParser();
+
+
+          /**
+           * Parses the next chunk of the body.
+           * @param  data   Chunk of the body.
+           * @param  length Length of the chunk in bytes.
+           * @return        False if the body is malformed or a part could not be
+           *                written to its temporary file, true otherwise.
+           */
+          bool Consume(const unsigned char* data, const std::size_t length);
+
+
+          /**
+           * Returns true if the closing delimiter of the body has been parsed.
+           */
+          bool IsComplete();
+
+
+          /**
+           * Returns the parsed parts, the last one may still be incomplete
+           * if the body has not been completely parsed.
+           */
+          std::vector<MultipartPart>& GetParts();
+
+        private:
+
+          /**
+           * States of the parser: before the first delimiter, after a delimiter,
+           * in the headers of a part, in the content of a part, after the closing
+           * delimiter, and after an error.
+           */
+          enum class State { PREAMBLE, DELIMITER, HEADERS, BODY, END, FAILED };
+
+
+          /**
+           * Parses the headers of a part into the last part.
+           * @param begin First byte of the headers.
+           * @param end   Byte after the last header.
+           */
+          void ParseHeaders(const unsigned char* begin, const unsigned char* end);
+
+
+          /**
+           * Appends content to the last part, spilling it to a temporary
+           * file if it becomes larger than the spill size.
+           * @param  data   Content.
+           * @param  length Length of the content in bytes.
+           * @return        False if the temporary file could not be written.
+           */
+          bool Write(const unsigned char* data, const std::size_t length);
+
+
+          /**
+           * Searches the delimiter with Boyer-Moore-Horspool.
+           * @param  data   Bytes where the delimiter is searched.
+           * @param  length Number of bytes.
+           * @return        Position of the delimiter, length if it is not found.
+           */
+          std::size_t Find(const unsigned char* data, const std::size_t length);
+
+
+          /**
+           * Delimiter preceding each part: CRLF, two dashes and the boundary.
+           */
+          std::string delimiter_;
+
+
+          /**
+           * Boyer-Moore-Horspool shift for each byte value.
+           */
+          std::size_t shift_[256];
+
+
+          /**
+           * Parts with more bytes are written to temporary files.
+           */
+          std::size_t spill_size_;
+
+
+          /**
+           * State of the parser.
+           */
+          State state_;
+
+
+          /**
+           * Bytes received that can not be parsed yet: the end of a chunk
+           * that may be the beginning of a delimiter, or incomplete headers.
+           */
+          std::vector<unsigned char> buffer_;
+
+
+          /**
+           * Parsed parts.
+           */
+          std::vector<MultipartPart> parts_;
+
+
+          /**
+           * Temporary file of the last part, if it has been spilled.
+           */
+          std::ofstream file_;
+
+
+          MultipartParser(const MultipartParser&) = delete;
+          MultipartParser& operator=(const MultipartParser&) = delete;
+      };
+
+
+      /**
+       * Parse the body of an http_request with multipart/form-data content type,
+       * reading the body stream chunk by chunk.
+       * @param  request  HTTP request containing multipart/form-data.
+       * @param  parser   Parser, constructed with the boundary of the request.
+       * @return          True if the whole body has been parsed.
+       */
+      bool ParseMultipartFormData(const web::http::http_request& request, MultipartParser& parser);
+
+
+      /**
+       * Returns the boundary parameter of a multipart Content-Type header.
+       * @param  headers Headers of the HTTP Request.
+       * @return         Boundary. Example: ----WebKitFormBoundaryKS484Mi6jduf07q
+       */
+      std::string ExtractMultipartBoundary(const web::http::http_headers& headers);
+
+
       /**
        * Returns an URI extracted from the Referer header.
        * @param  request HTTP request containing the Referer header.
@@ -152,6 +394,33 @@ namespace granada{
        */
       std::string ParseURIFromReferer(const web::http::http_request& request);
 
+
+      /**
+       * Parse the value of a Range header into the byte ranges of a content
+       * with the given length. Each range is a pair with the first and the last
+       * byte positions, both included. Ranges that can not be satisfied are
+       * skipped, if none can be satisfied the ranges vector is left empty.
+       * Overlapping and adjacent ranges are merged and the ranges are sorted,
+       * so the parts never add up to more than the content.
+       * A header with more than 16 ranges, or with more than two ranges
+       * overlapping others, is refused: a client asking the same bytes many
+       * times is not downloading a file.
+       * Example:
+       *      range:
+       *          bytes=0-99, 500-, -100
+       *      length:
+       *          1000
+       *      ranges:
+       *          (0,99), (500,999)
+       *
+       * @param  range  Value of the Range header.
+       * @param  length Length of the content in bytes.
+       * @param  ranges Vector where the parsed ranges are inserted.
+       * @return        True if the header is a valid bytes range, false if it is not
+       *                and has to be ignored.
+       */
+      bool ParseRange(const std::string& range, const std::size_t length, std::vector<std::pair<std::size_t,std::size_t>>& ranges);
+
     }
   }
 }
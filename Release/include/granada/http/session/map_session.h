@@ -195,6 +195,15 @@ namespace granada{
           };
 
 
+          /**
+           * Destructor. Stops writing the update times behind
+           * while cache() can still be called.
+           */
+          virtual ~MapSessionHandler(){
+            StopFlushingTouches();
+          };
+
+
           /**
            * Returns a pointer to the cache used to store the sessions' values.
            * @return  Pointer to the cache used to store the sessions' values.
@@ -0,0 +1,284 @@
+/**
+  * Copyright (c) <2016> granada <afernandez@cookinapps.io>
+  *
+  * This source code is licensed under the MIT license.
+  *
+  * Permission is hereby granted, free of charge, to any person obtaining a copy
+  * of this software and associated documentation files (the "Software"), to deal
+  * in the Software without restriction, including without limitation the rights
+  * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  * copies of the Software, and to permit persons to whom the Software is
+  * furnished to do so, subject to the following conditions:
+  *
+  * The above copyright notice and this permission notice shall be included in
+  * all copies or substantial portions of the Software.
+  *
+  * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  * SOFTWARE.
+  *
+  * Signed session with its data and revoked sessions stored in redis.
+  *
+  */
+
+#pragma once
+#include "granada/util/mutex.h"
+#include "signed_session.h"
+#include "granada/cache/redis_cache_driver.h"
+
+namespace granada{
+  namespace http{
+    namespace session{
+
+      class RedisSignedSessionHandler;
+
+      /**
+       * Signed session with its data stored in redis.
+       */
+      class RedisSignedSession : public SignedSession
+      {
+        public:
+
+          /**
+           * Constructor
+           */
+          RedisSignedSession();
+
+
+          /**
+           * Constructor.
+           * Loads session.
+           * Retrieves the signed token of the session from the HTTP request
+           * and verifies it using the session handler.
+           * If session does not exist or token is not found
+           * a new session is created.
+           * This constructor is recommended for sessions that store token in cookie
+           *
+           * @param  request  Http request.
+           * @param  response Http response.
+           */
+          RedisSignedSession(const web::http::http_request &request,web::http::http_response &response);
+
+
+          /**
+           * Constructor.
+           * Loads session.
+           * Retrieves the signed token of the session from the HTTP request
+           * and verifies it using the session handler.
+           * This constructor is recommended for sessions that use get and post values.
+           * 
+           * @param  request  Http request.
+           */
+          RedisSignedSession(const web::http::http_request &request);
+
+
+          /**
+           * Constructor.
+           * Loads a session with the given signed token using the session handler.
+           * 
+           * @param token Signed token.
+           */
+          RedisSignedSession(const std::string& token);
+
+
+          /**
+           * Destructor
+           */
+          virtual ~RedisSignedSession(){};
+
+
+          /**
+           * Returns a pointer to the roles of a session.
+           * @return Pointer to the roles of the session.
+           */
+          virtual granada::http::session::SessionRoles* roles() override {
+            return roles_.get();
+          };
+
+
+          /**
+           * Returns the pointer of Session Handler that manages the session.
+           * @return Session Handler.
+           */
+          virtual granada::http::session::SessionHandler* session_handler() override {
+            return session_handler_.get();
+          };
+
+
+          /**
+           * Returns a pointer to the collection of functions
+           * that are called when closing the session.
+           * 
+           * @return  Pointer to the collection of functions that are
+           *          called when session is closed.
+           */
+          virtual granada::Functions* close_callbacks() override {
+            return RedisSignedSession::close_callbacks_.get();
+          };
+
+
+        private:
+
+          /**
+           * Used for loading the properties only once.
+           */
+          static granada::util::mutex::call_once load_properties_call_once_;
+
+
+          /**
+           * Functions called when the session is closed.
+           */
+          static std::unique_ptr<granada::Functions> close_callbacks_;
+
+
+          /**
+           * Hanlder of the sessions lifetime.
+           */
+          static std::unique_ptr<granada::http::session::SessionHandler> session_handler_;
+
+
+          /**
+           * Manager of the roles of the session and its properties
+           */
+          std::unique_ptr<granada::http::session::SessionRoles> roles_;
+
+      };
+
+
+
+      class RedisSignedSessionHandler : public SignedSessionHandler
+      {
+        public:
+
+          /**
+           * Constructor
+           * Initialize the session properties and the
+           * session cleaner once per all the RedisSignedSessions.
+           */
+          RedisSignedSessionHandler(){
+            RedisSignedSessionHandler::load_properties_call_once_.call([this](){
+              this->LoadProperties();
+            });
+
+            // thread for cleaning the sessions.
+            RedisSignedSessionHandler::clean_sessions_call_once_.call([this]{
+              if (clean_sessions_frequency()>-1){
+                RedisSignedSessionHandler::clean_sessions_timer_.set([this]{
+                  CleanSessions();
+                },clean_sessions_frequency());
+              }
+            });
+          };
+
+
+          /**
+           * Destructor. Stops writing the update times behind
+           * while cache() can still be called.
+           */
+          virtual ~RedisSignedSessionHandler(){
+            StopFlushingTouches();
+          };
+
+
+          /**
+           * Returns a pointer to the cache used to store the sessions' data
+           * and the revoked sessions.
+           * @return  Pointer to the cache.
+           */
+          virtual granada::cache::CacheHandler* cache() override {
+            return RedisSignedSessionHandler::cache_.get();
+          }
+
+        protected:
+
+
+          /**
+           * Returns a pointer to a nonce string generator,
+           * for generating unique sessions ids.
+           * @return  Pointer to a nonce string generator.
+           */
+          virtual granada::crypto::NonceGenerator* nonce_generator() override {
+            return RedisSignedSessionHandler::nonce_generator_.get();
+          }
+
+
+          /**
+           * Returns a Session factory used to test sessions
+           * status without knowing their type.
+           * @return  Session factory.
+           */
+          virtual granada::http::session::SessionFactory* factory() override {
+            return RedisSignedSessionHandler::factory_.get();
+          }
+
+
+        private:
+
+          /**
+           * Used for loading the properties only once.
+           */
+          static granada::util::mutex::call_once load_properties_call_once_;
+
+
+          /**
+           * Used for calling clean sessions function only once.
+           */
+          static granada::util::mutex::call_once clean_sessions_call_once_;
+
+
+          /**
+           * Timer for calling CleanSessions function each n seconds.
+           */
+          static granada::util::time::timer clean_sessions_timer_;
+
+
+          /**
+           * Pointer to the cache used to store the sessions' data
+           * and the revoked sessions.
+           */
+          static std::unique_ptr<granada::cache::CacheHandler> cache_;
+
+
+          /**
+           * Nonce string generator, for generating unique sessions ids.
+           */
+          static std::unique_ptr<granada::crypto::NonceGenerator> nonce_generator_;
+
+
+          /**
+           * Session factory used to test sessions status without knowing
+           * their type.
+           */
+          static std::unique_ptr<granada::http::session::SessionFactory> factory_;
+
+      };
+
+
+      class RedisSignedSessionFactory : public SessionFactory{
+        public:
+
+
+          virtual std::unique_ptr<granada::http::session::Session> Session_unique_ptr() override {
+            return granada::util::memory::make_unique<granada::http::session::RedisSignedSession>();
+          };
+
+          virtual std::unique_ptr<granada::http::session::Session> Session_unique_ptr(const web::http::http_request &request,web::http::http_response &response) override {
+            return granada::util::memory::make_unique<granada::http::session::RedisSignedSession>(request,response);
+          };
+
+          virtual std::unique_ptr<granada::http::session::Session> Session_unique_ptr(const web::http::http_request &request) override {
+            return granada::util::memory::make_unique<granada::http::session::RedisSignedSession>(request);
+          };
+
+          virtual std::unique_ptr<granada::http::session::Session> Session_unique_ptr(const std::string& token) override {
+            return granada::util::memory::make_unique<granada::http::session::RedisSignedSession>(token);
+          };
+      };
+
+    }
+  }
+}
@@ -26,9 +26,15 @@
   *
   */
 #pragma once
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
 #include <memory>
 #include <mutex>
 #include <string>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
 #include "cpprest/details/basic_types.h"
 #include "cpprest/json.h"
 #include "cpprest/http_listener.h"
@@ -36,9 +42,12 @@
 #include "granada/functions.h"
 #include "granada/util/memory.h"
 #include "granada/util/application.h"
+#include "granada/util/mutex.h"
 #include "granada/util/time.h"
 #include "granada/util/string.h"
+#include "granada/util/vector.h"
 #include "granada/util/json.h"
+#include "granada/util/bloom_filter.h"
 #include "granada/http/parser.h"
 #include "granada/crypto/nonce_generator.h"
 #include "granada/cache/cache_handler.h"
@@ -112,9 +121,19 @@ namespace granada{
 
 
           /**
-           * Destructor
+           * Destructor.
+           * Flushes the session data changed and not stored yet,
+           * a cache error is reported but not thrown.
            */
-          virtual ~Session(){};
+          virtual ~Session(){
+            try{
+              Flush();
+            }catch(const std::exception& e){
+              std::cout << "Session data could not be flushed: " << e.what() << std::endl;
+            }catch(...){
+              std::cout << "Session data could not be flushed." << std::endl;
+            }
+          };
 
 
           /**
@@ -127,6 +146,7 @@ namespace granada{
           virtual void set(const std::string token,const std::time_t update_time){
             token_ = std::move(token);
             update_time_ = std::move(update_time);
+            stored_update_time_ = update_time_;
           };
 
 
@@ -148,6 +168,8 @@ namespace granada{
            * Updates a session, updating the session update time to now and saving it.
            * That means the session will timeout in now + timeout. It will keep
            * the session alive.
+           * The stored update time is only refreshed once every "session_touch_frequency"
+           * seconds, the other updates only change the update time of this object.
            */
           virtual void Update();
 
@@ -205,6 +227,14 @@ namespace granada{
           virtual const long GetSessionTimeout();
 
 
+          /**
+           * Returns the time from which the session is garbage,
+           * 0 if the session never times out.
+           * @return Time from which the session is garbage.
+           */
+          virtual const std::time_t GetGarbageTime();
+
+
           /**
            * Write session data.
            * @param key   Key or name of the data.
@@ -228,6 +258,26 @@ namespace granada{
           virtual void Destroy(const std::string& key);
 
 
+          /**
+           * Stores the session data written or destroyed since the session
+           * was loaded, in one batch. Only used when "session_unit_of_work"
+           * property is "true", in other case the data is stored on each write.
+           * Called when the session is destroyed, usually at the end of the request.
+           */
+          virtual void Flush();
+
+
+          /**
+           * Returns true if the session data is loaded once and
+           * read locally, and the changes are stored when the session is flushed.
+           * Taken from the "session_unit_of_work" property, false for this
+           * session if its cache can't read all the data at once.
+           */
+          virtual const bool unit_of_work(){
+            return Session::unit_of_work_ && !unit_of_work_unsupported_;
+          };
+
+
           /**
            * Returns the session in a JSON object format.
            * @return  Session in form of JSON object.
@@ -363,6 +413,23 @@ namespace granada{
           static long session_garbage_extra_timeout_;
 
 
+          /**
+           * Minimum seconds between two writes of the update time of a session,
+           * updates in between are coalesced. Taken from the "session_touch_frequency"
+           * property, if not found it will take default_numbers::session_touch_frequency.
+           * It is never more than half the session timeout. 0 writes on every update.
+           */
+          static long touch_frequency_;
+
+
+          /**
+           * True if the session data is loaded once with all its values and
+           * the changes are flushed together. Taken from the "session_unit_of_work"
+           * property, if not found it will take default_strings::session_unit_of_work.
+           */
+          static bool unit_of_work_;
+
+
           /**
            * Where the session token is stored: cookie || query || json
            * for this session. It can be different from the
@@ -383,6 +450,63 @@ namespace granada{
           std::time_t update_time_;
 
 
+          /**
+           * Update time stored wherever the sessions are stored,
+           * 0 if the session has not been saved yet.
+           */
+          std::time_t stored_update_time_ = 0;
+
+
+          /**
+           * Session data loaded in unit of work mode.
+           */
+          std::unordered_map<std::string,std::string> data_;
+
+
+          /**
+           * Keys of the session data written or destroyed
+           * and not flushed yet.
+           */
+          std::unordered_set<std::string> dirty_keys_;
+
+
+          /**
+           * True if the session data has been loaded.
+           */
+          bool data_loaded_ = false;
+
+
+          /**
+           * True if the cache of this session can't read all the session
+           * data at once, the data is then read and written on each call.
+           */
+          bool unit_of_work_unsupported_ = false;
+
+
+          /**
+           * Cache and key of the session data to flush, they are kept
+           * because the session handler can't be reached from the destructor.
+           */
+          granada::cache::CacheHandler* data_cache_ = nullptr;
+          std::string data_hash_;
+
+
+          /**
+           * Loads all the session data in one read, if not already loaded.
+           * @return  True if the data is held by the session, false if the
+           *          cache can't read it at once, then the unit of work
+           *          is not used by this session.
+           */
+          virtual const bool LoadData();
+
+
+          /**
+           * Forgets the session data loaded and not flushed,
+           * for example when the session is closed.
+           */
+          virtual void ClearData();
+
+
           /**
            * Method that loads the session properties: token label,
            * token support, session timout...
@@ -478,6 +602,15 @@ namespace granada{
             return Session::session_garbage_extra_timeout_;
           }
 
+
+          /**
+           * Returns the minimum seconds between two writes
+           * of the update time of a session.
+           */
+          virtual const long& touch_frequency(){
+            return Session::touch_frequency_;
+          }
+
       };
 
 
@@ -485,6 +618,11 @@ namespace granada{
        * Class for managing session roles.
        * Roles are used to manage user permissions,
        * for example letting or not the user to access some data. 
+       * The names of the roles of a session are stored in the session value
+       * hash, with the role properties alongside. They are read once per
+       * session object and held as a bitmap, one bit per RoleRegistry id of
+       * this process, so checking a role is a bit test. When the registry is
+       * full the other roles are held and compared by name.
        */
       class SessionRoles
       {
@@ -582,6 +720,76 @@ namespace granada{
           granada::http::session::Session* session_;
 
 
+          /**
+           * Roles bitmap, a bit set per role id. The ids are only
+           * valid in this process, the cache stores the role names.
+           */
+          unsigned long long roles_ = 0;
+
+
+          /**
+           * Names of the roles of the session that have no id
+           * because the RoleRegistry is full.
+           */
+          std::unordered_set<std::string> named_roles_;
+
+
+          /**
+           * Role properties, by "role:<role name>:<key>".
+           */
+          std::unordered_map<std::string,std::string> properties_;
+
+
+          /**
+           * Token of the session whose roles are loaded,
+           * empty if they are not loaded.
+           */
+          std::string loaded_token_;
+
+
+          /**
+           * True if properties_ holds all the role properties, false if
+           * the cache driver can't read them at once and they are read one by one.
+           */
+          bool properties_loaded_ = false;
+
+
+          /**
+           * Loads the roles and the role properties of the
+           * session, if they are not already loaded.
+           */
+          virtual void LoadRoles();
+
+
+          /**
+           * Stores the names of the roles set in the roles bitmap
+           * and the roles held by name, comma separated.
+           * 
+           * @param batch Batch where the write is added.
+           */
+          virtual void WriteRoles(granada::cache::CacheBatch& batch);
+
+
+          /**
+           * Returns the key to access the session value hash,
+           * where the roles bitmap and the role properties are stored.
+           */
+          virtual const std::string session_value_hash(){
+            return cache_namespaces::session_value + session_->GetToken();
+          };
+
+
+          /**
+           * Returns the key of a role property in the session value hash.
+           * 
+           * @param role_name Name of the role.
+           * @param key       Key or name of the property.
+           */
+          virtual const std::string property_key(const std::string& role_name, const std::string& key){
+            return entity_keys::session_role_property + role_name + ":" + key;
+          };
+
+
           /**
            * Returns the key to access a role data.
            * 
@@ -595,6 +803,126 @@ namespace granada{
 
 
 
+      /**
+       * Gives a small integer id to each role name, so the roles of
+       * a session can be stored as a bitmap.
+       * Roles listed in the "session_role_registry" property (comma separated)
+       * take the first ids in that order, other roles take the next free id
+       * the first time they are used, so they can be different in each process.
+       * Only the ids of the listed roles can leave the process, in the roles
+       * bitmap of signed sessions.
+       * This code is multi-thread safe.
+       */
+      class RoleRegistry
+      {
+        public:
+
+          /**
+           * Maximum number of roles, a role bitmap has one bit per role.
+           */
+          static const int MAX_ROLES = 64;
+
+
+          /**
+           * Returns the id of a role.
+           * @param  role_name  Name of the role.
+           * @return            Id of the role, -1 if the role is not registered.
+           */
+          static const int Id(const std::string& role_name);
+
+
+          /**
+           * Returns the id of a role, registering the role if it is not.
+           * @param  role_name  Name of the role.
+           * @return            Id of the role, -1 if there are already
+           *                    MAX_ROLES roles registered, then the role
+           *                    has to be kept by name.
+           */
+          static const int Register(const std::string& role_name);
+
+
+          /**
+           * Returns the id of a role only if it is listed in the
+           * "session_role_registry" property. The ids of those roles are
+           * the same in every process and after a restart, as long as
+           * the property does not change, the ids of the roles registered
+           * while running depend on the order they are first used.
+           * @param  role_name  Name of the role.
+           * @return            Id of the role, -1 if the role is not configured.
+           */
+          static const int ConfiguredId(const std::string& role_name);
+
+
+          /**
+           * Returns a fingerprint of the "session_role_registry" property,
+           * it changes if a role is added, removed or moved in the list,
+           * so role bitmaps written with other ids can be detected.
+           * @return Fingerprint, 16 hexadecimal characters.
+           */
+          static const std::string Fingerprint();
+
+
+          /**
+           * Returns the name of the role with the given id.
+           * @param  id Id of the role.
+           * @return    Name of the role, empty if there is no role with that id.
+           */
+          static const std::string Name(const int& id);
+
+
+        private:
+
+          /**
+           * Names of the roles, the position is the id of the role.
+           */
+          static std::vector<std::string> names_;
+
+
+          /**
+           * Ids of the roles by name.
+           */
+          static std::unordered_map<std::string,int> ids_;
+
+
+          /**
+           * Number of roles listed in the "session_role_registry"
+           * property, they have the ids 0 to configured_ - 1.
+           */
+          static int configured_;
+
+
+          /**
+           * Fingerprint of the "session_role_registry" property.
+           */
+          static std::string fingerprint_;
+
+
+          /**
+           * Mutex for thread safety.
+           */
+          static std::mutex mtx_;
+
+
+          /**
+           * Used for loading the properties only once.
+           */
+          static granada::util::mutex::call_once load_properties_call_once_;
+
+
+          /**
+           * Registers the roles listed in the "session_role_registry" property.
+           */
+          static void LoadProperties();
+
+
+          /**
+           * Registers a role, the mutex has to be locked.
+           */
+          static const int RegisterUnlocked(const std::string& role_name);
+      };
+
+
+
       /**
        * Abstract class for managing sessions life.
        */
@@ -608,6 +936,13 @@ namespace granada{
           SessionHandler(){};
 
 
+          /**
+           * Destructor.
+           * Stops writing the update times behind, see StopFlushingTouches.
+           */
+          virtual ~SessionHandler();
+
+
           /**
            * Check if session exists wherever sessions are stored.
            * Returns true if session exists and false if it does not.
@@ -617,6 +952,21 @@ namespace granada{
           virtual const bool SessionExists(const std::string& token);
 
 
+          /**
+           * Returns false if the session with the given token definitely
+           * does not exist, without using the cache, true if it may exist.
+           * When the "session_token_filter" property is "true" the tokens of
+           * the sessions are kept in a counting Bloom filter, so unknown tokens
+           * are rejected in memory. The filter only knows the sessions opened and
+           * closed by this process and the ones stored when it is first used, it
+           * should not be enabled when several processes share the sessions.
+           * 
+           * @param token Session token.
+           * @return      False if the session does not exist, true if it may exist.
+           */
+          virtual const bool MayExist(const std::string& token);
+
+
           /**
            * Generate a new unique token.
            * @return Generated Token.
@@ -640,6 +990,24 @@ namespace granada{
           virtual void SaveSession(granada::http::session::Session* session);
 
 
+          /**
+           * Stores the new update time of a session already saved.
+           * If "session_touch_flush_frequency" is not negative, the update time
+           * is written behind: kept in memory and written with the update times of
+           * the other sessions in one batch, every that many seconds, even if
+           * no other session is touched, and when the process exits.
+           * @param session Pointer to the Session touched.
+           */
+          virtual void TouchSession(granada::http::session::Session* session);
+
+
+          /**
+           * Writes the update times of the sessions touched
+           * and not written yet, in one batch.
+           */
+          virtual void FlushTouches();
+
+
           /**
            * Remove session from wherever the sessions are stored.
            * @param session Session to remove.
@@ -651,10 +1019,25 @@ namespace granada{
            * Remove garbage sessions from wherever sessions are stored.
            * It can be called from an application control panel, or better
            * called every n seconds, hours or days.
+           * Sessions are indexed by the time they become garbage, so only the
+           * garbage sessions are visited, "session_clean_batch" at a time.
+           * The first call indexes the sessions already stored, unless another
+           * process or a previous run has already done it.
            */
           virtual void CleanSessions();
 
 
+          /**
+           * Moves the roles stored by previous versions, one "session:roles:<token>:<role>"
+           * hash per role, to the session value hash, so sessions opened before
+           * a deploy keep their roles. Done once per process by the first CleanSessions,
+           * as it scans all the keys, and skipped when another process has already done it.
+           * Only the sessions with a value hash are moved, signed sessions keep
+           * their role properties in "session:roles:" keys.
+           */
+          virtual void MigrateRoles();
+
+
           /**
            * Returns a pointer to the cache handler used to store the sessions data.
            * @return Pointer to the cache handler used to store the sessions data.
@@ -682,12 +1065,178 @@ namespace granada{
           static double clean_sessions_frequency_;
 
 
+          /**
+           * Seconds the update times of the touched sessions are kept
+           * in memory before being written in one batch. Taken from the
+           * "session_touch_flush_frequency" property, if not found it will take
+           * default_numbers::session_touch_flush_frequency. Negative values
+           * write the update times immediately.
+           */
+          static long touch_flush_frequency_;
+
+
+          /**
+           * Maximum number of garbage sessions taken from the index at once.
+           * Taken from the "session_clean_batch" property, if not found it will
+           * take default_numbers::session_clean_batch.
+           */
+          static long clean_batch_;
+
+
+          /**
+           * Update times and garbage times of the touched
+           * sessions not written yet, by token.
+           */
+          std::unordered_map<std::string,std::pair<std::time_t,std::time_t>> touches_;
+
+
+          /**
+           * Used for indexing the sessions already stored only once.
+           */
+          std::once_flag index_sessions_once_;
+
+
+          /**
+           * Used for moving the roles stored by previous versions only once.
+           */
+          std::once_flag migrate_roles_once_;
+
+
+          /**
+           * True if the tokens of the sessions are kept in a counting Bloom filter.
+           * Taken from the "session_token_filter" property, if not found it will
+           * take default_strings::session_token_filter.
+           */
+          static bool token_filter_enabled_;
+
+
+          /**
+           * Number of counters of the filter, about ten per session gives less
+           * than 1% of false positives. Taken from the "session_token_filter_size" property,
+           * if not found it will take default_numbers::session_token_filter_size.
+           */
+          static long token_filter_size_;
+
+
+          /**
+           * Counting Bloom filter with the tokens of the sessions.
+           */
+          std::unique_ptr<granada::util::bloom::counting_filter> token_filter_;
+
+
+          /**
+           * Used for creating and filling the token filter only once.
+           */
+          std::once_flag token_filter_once_;
+
+
+          /**
+           * Creates the token filter and adds the tokens of
+           * the sessions already stored, if the filter is enabled.
+           */
+          virtual void LoadTokenFilter();
+
+
+          /**
+           * Last time the touches were written.
+           */
+          std::time_t touches_flush_time_ = 0;
+
+
+          /**
+           * Timer writing the touches every "session_touch_flush_frequency"
+           * seconds, so they do not wait for the next touch.
+           */
+          granada::util::time::timer touches_timer_;
+
+
+          /**
+           * Used for starting the touches timer only once,
+           * with the first touch written behind.
+           */
+          std::once_flag touches_timer_once_;
+
+
+          /**
+           * Handlers writing touches behind, their touches
+           * are written when the process exits.
+           */
+          static std::unordered_set<granada::http::session::SessionHandler*> touching_handlers_;
+
+
+          /**
+           * Mutex for touching_handlers_.
+           */
+          static std::mutex touching_handlers_mtx_;
+
+
+          /**
+           * Used for registering FlushAllTouches only once.
+           */
+          static std::once_flag flush_at_exit_once_;
+
+
+          /**
+           * Starts the touches timer and registers the handler
+           * so its touches are written when the process exits.
+           */
+          virtual void StartFlushingTouches();
+
+
+          /**
+           * Stops the touches timer, waits for a flush in progress and
+           * unregisters the handler. The timer calls virtual functions, so
+           * the destructors of the handlers implementing them call it first,
+           * before their part of the handler is destroyed.
+           */
+          void StopFlushingTouches();
+
+
+          /**
+           * Writes the touches of all the handlers, called when the process
+           * exits, before the caches are destroyed.
+           */
+          static void FlushAllTouches();
+
+
+          /**
+           * Mutex for touches_.
+           */
+          std::mutex touches_mtx_;
+
+
           /**
            * Loads properties needed, like clean session frequency.
            */
           virtual void LoadProperties();
 
 
+          /**
+           * Adds the session to the index of sessions
+           * by garbage time, if it can time out.
+           * 
+           * @param session Session to index.
+           * @param batch   Batch where the index update is added.
+           */
+          virtual void IndexSession(granada::http::session::Session* session, granada::cache::CacheBatch& batch);
+
+
+          /**
+           * Indexes all the sessions stored by garbage time, used for the
+           * sessions stored before the index existed. Done only once for all
+           * the processes: the "session:expiry.indexed" key is written after.
+           */
+          virtual void IndexSessions();
+
+
+          /**
+           * Returns the key of the index of sessions by garbage time.
+           */
+          virtual const std::string session_expiry_index(){
+            return cache_namespaces::session_expiry;
+          };
+
+
           /**
            * Returns a pointer to a generator of random alphanumeric strings.
            * Used to generate sessions' tokens.
@@ -799,6 +1348,87 @@ namespace granada{
 
       };
 
+
+
+      /**
+       * Handle of the session of a request that only loads it, parsing the
+       * token and using the cache, the first time it is used. Requests that
+       * never use it do no session work at all.
+       * Example:
+       *      granada::http::session::LazySession session(session_factory_.get(), request, response);
+       *      if (authorization_needed){
+       *        session->roles()->Is("USER");
+       *      }
+       */
+      class LazySession
+      {
+        public:
+
+          /**
+           * Constructor.
+           * 
+           * @param factory   Factory used to load the session.
+           * @param request   HTTP request.
+           * @param response  HTTP response, a cookie with the token may be
+           *                  added if a new session is opened.
+           */
+          LazySession(granada::http::session::SessionFactory* factory, const web::http::http_request &request, web::http::http_response &response) : factory_(factory), request_(request), response_(response){};
+
+
+          /**
+           * Returns the session, loading it if it is not loaded yet.
+           * @return  Session.
+           */
+          granada::http::session::Session* get(){
+            if (!session_){
+              session_ = factory_->Session_unique_ptr(request_, response_);
+            }
+            return session_.get();
+          };
+
+
+          /**
+           * Returns the session, loading it if it is not loaded yet.
+           * @return  Session.
+           */
+          granada::http::session::Session* operator->(){
+            return get();
+          };
+
+
+          /**
+           * Returns true if the session has been loaded.
+           */
+          bool loaded() const {
+            return session_ != nullptr;
+          };
+
+        private:
+
+          /**
+           * Factory used to load the session.
+           */
+          granada::http::session::SessionFactory* factory_;
+
+
+          /**
+           * HTTP request.
+           */
+          web::http::http_request request_;
+
+
+          /**
+           * HTTP response.
+           */
+          web::http::http_response& response_;
+
+
+          /**
+           * Session, nullptr while it is not loaded.
+           */
+          std::unique_ptr<granada::http::session::Session> session_;
+      };
+
     }
   }
 }
@@ -0,0 +1,518 @@
+/**
+  * Copyright (c) <2016> granada <afernandez@cookinapps.io>
+  *
+  * This source code is licensed under the MIT license.
+  *
+  * Permission is hereby granted, free of charge, to any person obtaining a copy
+  * of this software and associated documentation files (the "Software"), to deal
+  * in the Software without restriction, including without limitation the rights
+  * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  * copies of the Software, and to permit persons to whom the Software is
+  * furnished to do so, subject to the following conditions:
+  *
+  * The above copyright notice and this permission notice shall be included in
+  * all copies or substantial portions of the Software.
+  *
+  * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  * SOFTWARE.
+  *
+  * Stateless session: the token given to the client carries the
+  * session id, its issue and update times, its expiry and its roles,
+  * signed and optionally encrypted. Only the roles listed in the
+  * "session_role_registry" property can be given to a signed session,
+  * tokens signed with another list of roles are refused. Loading a session only verifies the
+  * token, the cache only stores the session data and the list of
+  * closed (revoked) sessions.
+  *
+  */
+
+#pragma once
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include "session.h"
+#include "granada/crypto/token_signer.h"
+#include "granada/crypto/openssl_token_signer.h"
+
+namespace granada{
+  namespace http{
+    namespace session{
+
+      /**
+       * Session whose state travels in a signed token.
+       * GetToken() returns the session id, used to store the session
+       * data, GetSignedToken() returns the token the client has to
+       * send back. When the token is stored in a cookie, the cookie
+       * is set or renewed automatically.
+       */
+      class SignedSession : public Session
+      {
+        public:
+
+          /**
+           * Constructor.
+           */
+          SignedSession() : issue_time_(0), signed_update_time_(0), roles_(0), dirty_(false), response_(nullptr){
+            update_time_ = 0;
+          };
+
+
+          /**
+           * Destructor
+           */
+          virtual ~SignedSession(){};
+
+
+          /**
+           * Set the values of the session read from a signed token.
+           * 
+           * @param token         Session id.
+           * @param issue_time    Time the session was opened.
+           * @param update_time   Session update time.
+           * @param roles         Roles bitmap.
+           * @param signed_token  Signed token containing the values.
+           */
+          virtual void set(const std::string& token, const std::time_t& issue_time, const std::time_t& update_time, const unsigned long long& roles, const std::string& signed_token);
+
+
+          /**
+           * Opens a new session with a unique id and a new signed token.
+           */
+          virtual void Open() override;
+
+
+          /**
+           * Opens a new session with a unique id and if session token
+           * support is a cookie it stores the signed token in a cookie.
+           * @param response Response to store the cookie with the signed token.
+           */
+          virtual void Open(web::http::http_response &response) override;
+
+
+          /**
+           * Updates the session update time, the token is only signed again
+           * if the roles have changed or if the last one is older than
+           * the "session_token_refresh" property, so most of the updates
+           * do nothing.
+           */
+          virtual void Update() override;
+
+
+          /**
+           * Write session data, the update time of the data is also
+           * written so the data of the sessions that time out is cleaned.
+           * @param key   Key or name of the data.
+           * @param value Data as string.
+           */
+          virtual void Write(const std::string& key, const std::string& value) override;
+
+
+          /**
+           * Returns the session in a JSON object format, the "token"
+           * is the signed token.
+           * @return  Session in form of JSON object.
+           */
+          virtual web::json::value to_json() override;
+
+
+          /**
+           * Returns the signed token, the token the client
+           * has to send back.
+           * @return Signed token.
+           */
+          virtual const std::string& GetSignedToken(){
+            return signed_token_;
+          };
+
+
+          /**
+           * Sets the signed token and the update time it contains.
+           * @param signed_token  Signed token.
+           */
+          virtual void SetSignedToken(const std::string& signed_token){
+            signed_token_.assign(signed_token);
+            signed_update_time_ = update_time_;
+          };
+
+
+          /**
+           * Returns the time the session was opened.
+           * @return Time the session was opened.
+           */
+          virtual const std::time_t& GetIssueTime(){
+            return issue_time_;
+          };
+
+
+          /**
+           * Returns the time the session expires if not updated,
+           * 0 if sessions do not time out.
+           * @return Expiry time.
+           */
+          virtual const std::time_t GetExpiryTime(){
+            if (application_session_timeout() < 0){
+              return 0;
+            }
+            return update_time_ + application_session_timeout();
+          };
+
+
+          /**
+           * Returns the roles bitmap, a bit set per role id.
+           * @return Roles bitmap.
+           */
+          virtual const unsigned long long& GetRoles(){
+            return roles_;
+          };
+
+
+          /**
+           * Sets the roles bitmap, the token will be signed again
+           * on the next update.
+           * @param roles Roles bitmap.
+           */
+          virtual void SetRoles(const unsigned long long& roles){
+            if (roles != roles_){
+              roles_ = roles;
+              dirty_ = true;
+            }
+          };
+
+
+        protected:
+
+          /**
+           * Minimum seconds between two signatures of the token.
+           * This value is taken from the "session_token_refresh" property,
+           * if not found the value will be default_numbers::session_token_refresh.
+           */
+          static long token_refresh_;
+
+
+          /**
+           * Time the session was opened.
+           */
+          std::time_t issue_time_;
+
+
+          /**
+           * Update time contained in the signed token.
+           */
+          std::time_t signed_update_time_;
+
+
+          /**
+           * Roles bitmap.
+           */
+          unsigned long long roles_;
+
+
+          /**
+           * True if the token has to be signed again because
+           * the values it contains have changed.
+           */
+          bool dirty_;
+
+
+          /**
+           * Signed token.
+           */
+          std::string signed_token_;
+
+
+          /**
+           * Cookie with the signed token added to the response.
+           */
+          std::string cookie_;
+
+
+          /**
+           * Response where the cookie with the signed token is set,
+           * nullptr if the session has not been loaded from a request
+           * with its response.
+           */
+          web::http::http_response* response_;
+
+
+          /**
+           * Loads the session properties and the token refresh.
+           */
+          virtual void LoadProperties() override;
+
+
+          /**
+           * Loads the session from the token found in the request,
+           * keeps the response to renew the cookie when the token is
+           * signed again.
+           *
+           * @param  request  Http request.
+           * @param  response Http response.
+           * @return          True if session has been retrieved or created successfuly.
+           */
+          virtual const bool LoadSession(const web::http::http_request &request,web::http::http_response &response) override;
+
+
+          /**
+           * Adds or replaces the cookie with the signed token
+           * in the response.
+           */
+          virtual void SetCookie();
+      };
+
+
+
+      /**
+       * Roles of a signed session, stored as a bitmap in the
+       * signed token, so checking a role does not use the cache.
+       * Role properties are stored in the cache.
+       * The roles have to be listed in the "session_role_registry" property,
+       * so their ids are the same in all the processes and after restarts.
+       */
+      class SignedSessionRoles : public SessionRoles
+      {
+        public:
+
+          /**
+           * Constructor
+           * 
+           * @param session Pointer to session owner of the roles.
+           */
+          SignedSessionRoles(granada::http::session::SignedSession* session){
+            session_ = session;
+            signed_session_ = session;
+          };
+
+
+          /**
+           * Check if the role with the given name is in the roles bitmap.
+           * @param  role_name Name of the role to check.
+           * @return           true | false
+           */
+          virtual const bool Is(const std::string& role_name) override;
+
+
+          /**
+           * Add a new role if it has not already been added.
+           * @param  role_name Name of the role.
+           * @return           True if role added correctly, false if the role
+           *                   was already added or is not listed in the
+           *                   "session_role_registry" property.
+           */
+          virtual const bool Add(const std::string& role_name) override;
+
+
+          /**
+           * Remove a role and its properties.
+           * @param role_name Name of the role.
+           */
+          virtual void Remove(const std::string& role_name) override;
+
+
+          /**
+           * Remove all roles.
+           */
+          virtual void RemoveAll() override;
+
+
+          /**
+           * Set a role property, it has to be a string.
+           * @param role_name Role name
+           * @param key       Key or name of the property.
+           * @param value     Value of the property.
+           */
+          virtual void SetProperty(const std::string& role_name, const std::string& key, const std::string& value) override;
+
+
+          /**
+           * Get a role property, returns a string.
+           * @param  role_name Role name.
+           * @param  key       Key or name of the property.
+           * @return           Value of the property (string).
+           */
+          virtual const std::string GetProperty(const std::string& role_name, const std::string& key) override;
+
+
+          /**
+           * Remove a role property.
+           * @param role_name Role name.
+           * @param key       Key or name of the property.
+           */
+          virtual void DestroyProperty(const std::string& role_name, const std::string& key) override;
+
+
+        protected:
+
+          /**
+           * Pointer of the signed session, owner of the roles.
+           */
+          granada::http::session::SignedSession* signed_session_;
+      };
+
+
+
+      /**
+       * Handler of signed sessions: signs and verifies the tokens
+       * and keeps the list of revoked sessions. The revoked sessions are
+       * stored in the cache and mirrored in memory when the cache
+       * supports subscriptions, so loading a session does not use the cache.
+       */
+      class SignedSessionHandler : public SessionHandler
+      {
+        public:
+
+          /**
+           * Constructor
+           */
+          SignedSessionHandler() : revoked_subscription_(0){};
+
+
+          /**
+           * Destructor
+           */
+          virtual ~SignedSessionHandler(){};
+
+
+          /**
+           * Returns true if a session with the given id has been
+           * revoked or has data stored.
+           * @param  token Id of the session to check.
+           * @return       true if session exists and false if it does not.
+           */
+          virtual const bool SessionExists(const std::string& token) override;
+
+
+          /**
+           * Verifies a signed token and if it is valid and not revoked
+           * assigns its values to the virgin session.
+           * @param token  Signed token.
+           * @param virgin Pointer of the virgin session.
+           */
+          virtual void LoadSession(const std::string& token, granada::http::session::Session* virgin) override;
+
+
+          /**
+           * Signs the values of the session and sets its signed token.
+           * Only writes the new update time to the data of the session,
+           * if it has data, so its data is not taken as garbage.
+           * @param session Pointer to Session to save.
+           */
+          virtual void SaveSession(granada::http::session::Session* session) override;
+
+
+          /**
+           * Revokes the session and removes its data.
+           * @param session Session to remove.
+           */
+          virtual void DeleteSession(granada::http::session::Session* session) override;
+
+
+          /**
+           * Removes the data of the timed out sessions and the revoked
+           * sessions whose token has expired.
+           */
+          virtual void CleanSessions() override;
+
+
+          /**
+           * Returns true if the session with the given id has been revoked.
+           * @param  id Id of the session.
+           * @return    True if the session has been revoked.
+           */
+          virtual const bool IsRevoked(const std::string& id);
+
+
+        protected:
+
+          /**
+           * Signs and verifies the tokens.
+           */
+          static std::unique_ptr<granada::crypto::TokenSigner> signer_;
+
+
+          /**
+           * Used for creating the signer only once, the first time
+           * it is needed. A plain once flag because it is checked on
+           * every token signature and verification.
+           */
+          static std::once_flag signer_once_;
+
+
+          /**
+           * Revoked sessions ids and the time their token expires,
+           * mirror of the revoked sessions stored in the cache.
+           */
+          std::unordered_map<std::string,std::time_t> revoked_;
+
+
+          /**
+           * Mutex for revoked_.
+           */
+          std::mutex revoked_mtx_;
+
+
+          /**
+           * Used for watching the revoked sessions only once,
+           * the first time a session is checked.
+           */
+          std::once_flag watch_revoked_once_;
+
+
+          /**
+           * Id of the subscription to the revoked sessions,
+           * 0 if the cache does not support subscriptions and the
+           * revoked sessions have to be read from the cache.
+           */
+          unsigned long long revoked_subscription_;
+
+
+          /**
+           * Subscribes to the revoked sessions in the cache and loads them.
+           */
+          virtual void WatchRevoked();
+
+
+          /**
+           * Returns the signer of the tokens, creates it the first time.
+           * The signing secret is taken from the "session_signing_secret" property,
+           * if it is not found a random secret is used and the tokens are only
+           * valid in this process. If the "session_encryption_secret" property
+           * is found, the content of the tokens is encrypted.
+           * @return Pointer to the signer of the tokens.
+           */
+          virtual granada::crypto::TokenSigner* signer();
+
+
+          /**
+           * Returns the key used to store a revoked session in the cache.
+           * 
+           * @param id  Session id.
+           * @return    Key of the revoked session.
+           */
+          virtual const std::string session_revoked_hash(const std::string& id){
+            return cache_namespaces::session_revoked + id;
+          };
+
+
+          /**
+           * Returns the key used to store the session data in the cache.
+           * 
+           * @param id  Session id.
+           * @return    Key of the session data.
+           */
+          virtual const std::string session_data_hash(const std::string& id){
+            return cache_namespaces::session_data + id;
+          };
+      };
+
+    }
+  }
+}
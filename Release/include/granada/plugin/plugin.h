@@ -28,6 +28,7 @@
   */
 
 #pragma once
+#include <functional>
 #include <mutex>
 #include <memory>
 #include <vector>
@@ -47,6 +48,7 @@
 #include "granada/util/application.h"
 #include "granada/cache/cache_handler.h"
 #include "granada/runner/runner.h"
+#include "granada/runner/runner_scheduler.h"
 
 
 namespace granada{
@@ -1007,14 +1009,31 @@ namespace granada{
 
 
         /**
-         * For increasing server performance the use of the runner is limited.
-         * This function returns true if runner is usable or false if it is not,
-         * normally if false is returned it is because it has been used
-         * very frequently.
+         * Runs a function once the runner is admitted for this Plug-in Handler,
+         * without blocking the calling thread while waiting. For increasing server
+         * performance the use of the runner is limited: only a number of
+         * Plug-in Handlers use it at once, and the same Plug-in Handler has to wait
+         * RUNNER_USE_FREQUENCY_LIMIT_ milliseconds between two uses.
+         * The scripts run by the function do not wait for the runner again.
+         * The Plug-in Handler has to live until the returned task is completed.
          * 
-         * @return  True is runner is usable, false if not.
+         * @param function  Function using the runner.
+         * @return          Task completed with true once the function has run, or with
+         *                  false if the runner could not be admitted in time
+         *                  and the function has not run.
          */
-        virtual void RunnerLock();
+        virtual pplx::task<bool> RunAdmitted(std::function<void()> function);
+
+
+        /**
+         * Runs a script with the runner. Waits for the runner if it is not
+         * already admitted in this thread with RunAdmitted.
+         * 
+         * @param script  Script to run.
+         * @return        Response of the script, or a JSON with a runner_busy
+         *                error if the runner could not be admitted in time.
+         */
+        virtual std::string RunScript(const std::string& script);
 
 
         /**
@@ -1126,6 +1145,15 @@ namespace granada{
          * from defaults values, default value is: 50ms.
          */
         static int RUNNER_USE_FREQUENCY_LIMIT_;
+
+
+        /**
+         * Admits the uses of the runner, one queue per Plug-in Handler.
+         * Its maximum number of runner uses at once is taken from the
+         * "plugin_runner_concurrency" property and the milliseconds a use can
+         * wait from the "plugin_runner_admission_timeout" property.
+         */
+        static std::unique_ptr<granada::runner::Scheduler> runner_scheduler_;
         
 
         /**
@@ -0,0 +1,460 @@
+/**
+  * Copyright (c) <2016> granada <afernandez@cookinapps.io>
+  *
+  * This source code is licensed under the MIT license.
+  *
+  * Permission is hereby granted, free of charge, to any person obtaining a copy
+  * of this software and associated documentation files (the "Software"), to deal
+  * in the Software without restriction, including without limitation the rights
+  * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  * copies of the Software, and to permit persons to whom the Software is
+  * furnished to do so, subject to the following conditions:
+  *
+  * The above copyright notice and this permission notice shall be included in
+  * all copies or substantial portions of the Software.
+  *
+  * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  * SOFTWARE.
+  *
+  * Admission of the runs of scripts or executables: limits how many run
+  * at once and how often the same user can run them.
+  */
+
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "pplx/pplxtasks.h"
+
+namespace granada{
+
+  namespace runner{
+
+    /**
+     * Admits the runs of scripts or executables. Each key, for example
+     * a Plug-in Handler id, has its own queue, and the queues are served
+     * round-robin so a key sending many runs does not delay the others.
+     * At most concurrency runs are admitted at once, and two admissions
+     * of the same key are at least interval milliseconds apart.
+     * 
+     * Waiting runs are tasks, not blocked threads: Admit returns a task
+     * completed by the scheduler thread when the run is admitted, or when
+     * its deadline passes.
+     */
+    class Scheduler
+    {
+      public:
+
+        /**
+         * Constructor.
+         * 
+         * @param concurrency Maximum runs admitted at once, the number of
+         *                    hardware threads if 0.
+         * @param interval    Minimum milliseconds between two admissions
+         *                    of the same key, 0 for no minimum.
+         * @param timeout     Milliseconds a run can wait before being refused,
+         *                    0 to wait as long as needed.
+         */
+        Scheduler(const std::size_t concurrency, const long long interval, const long long timeout) :
+          concurrency_(concurrency > 0 ? concurrency : (std::thread::hardware_concurrency() > 0 ? std::thread::hardware_concurrency() : 1)),
+          interval_(interval > 0 ? interval : 0),
+          timeout_(timeout > 0 ? timeout : 0),
+          running_(0),
+          waiting_(0),
+          sweep_size_(1024),
+          stop_(false){
+          thread_ = std::thread(&Scheduler::Dispatch, this);
+        };
+
+
+        /**
+         * Destructor. Refuses the runs still waiting.
+         */
+        virtual ~Scheduler(){
+          {
+            std::lock_guard<std::mutex> lg(mtx_);
+            stop_ = true;
+          }
+          cv_.notify_all();
+          thread_.join();
+        };
+
+
+        /**
+         * Asks to run for a key. Never blocks.
+         * 
+         * @param key Key of the queue, for example a Plug-in Handler id.
+         * @return    Task completed with true when the run is admitted, then
+         *            Release has to be called when the run ends, or with false
+         *            if the run could not be admitted before its deadline.
+         */
+        pplx::task<bool> Admit(const std::string& key){
+          const clock::time_point now = clock::now();
+          pplx::task_completion_event<bool> admitted;
+          {
+            std::lock_guard<std::mutex> lg(mtx_);
+            if (stop_){
+              return pplx::task_from_result(false);
+            }
+            Sweep(now);
+            Queue& queue = queues_[key];
+            if (waiting_ == 0 && running_ < concurrency_ && queue.next <= now){
+              // nobody waiting, admit without going through the scheduler thread.
+              ++running_;
+              queue.next = now + std::chrono::milliseconds(interval_);
+              return pplx::task_from_result(true);
+            }
+            Waiter waiter;
+            waiter.admitted = admitted;
+            waiter.deadline = timeout_ > 0 ? now + std::chrono::milliseconds(timeout_) : clock::time_point::max();
+            queue.waiters.push_back(std::move(waiter));
+            if (!queue.ready){
+              queue.ready = true;
+              ready_.push_back(key);
+            }
+            ++waiting_;
+          }
+          cv_.notify_one();
+          return pplx::create_task(admitted);
+        };
+
+
+        /**
+         * Ends an admitted run, letting another one be admitted.
+         */
+        void Release(){
+          {
+            std::lock_guard<std::mutex> lg(mtx_);
+            if (running_ > 0){
+              --running_;
+            }
+          }
+          cv_.notify_one();
+        };
+
+
+        /**
+         * Marks the current thread as running an admitted run while the scope
+         * lives, so the scripts it runs do not wait for an admission again.
+         * Runners calling back the application from other threads pass the
+         * mark on with Scope(Scheduler::Admitted()).
+         */
+        class Scope{
+          public:
+
+            /**
+             * Constructor.
+             * @param admitted  True to mark the thread, false to do nothing.
+             */
+            explicit Scope(const bool admitted = true) : admitted_(admitted){
+              if (admitted_){
+                ++Depth();
+              }
+            };
+
+
+            /**
+             * Destructor, removes the mark.
+             */
+            ~Scope(){
+              if (admitted_){
+                --Depth();
+              }
+            };
+
+          private:
+
+            const bool admitted_;
+
+            Scope(const Scope&) = delete;
+            Scope& operator=(const Scope&) = delete;
+        };
+
+
+        /**
+         * Returns true if the current thread is running an admitted run.
+         * 
+         * @return True if a Scope marks the current thread.
+         */
+        static bool Admitted(){
+          return Depth() > 0;
+        };
+
+
+        /**
+         * Returns the number of runs admitted and not released yet.
+         * 
+         * @return Number of runs running.
+         */
+        std::size_t running(){
+          std::lock_guard<std::mutex> lg(mtx_);
+          return running_;
+        };
+
+
+        /**
+         * Returns the number of runs waiting to be admitted.
+         * 
+         * @return Number of runs waiting.
+         */
+        std::size_t waiting(){
+          std::lock_guard<std::mutex> lg(mtx_);
+          return waiting_;
+        };
+
+      private:
+
+        typedef std::chrono::steady_clock clock;
+
+
+        /**
+         * Run waiting to be admitted.
+         */
+        struct Waiter{
+
+          /**
+           * Completed when the run is admitted or refused.
+           */
+          pplx::task_completion_event<bool> admitted;
+
+
+          /**
+           * Time after which the run is refused.
+           */
+          clock::time_point deadline;
+        };
+
+
+        /**
+         * Queue of the runs of a key.
+         */
+        struct Queue{
+
+          Queue() : next(), ready(false){};
+
+
+          /**
+           * Waiting runs, in arrival order.
+           */
+          std::deque<Waiter> waiters;
+
+
+          /**
+           * Time from which the next run of the key can be admitted.
+           */
+          clock::time_point next;
+
+
+          /**
+           * True if the key is in the round-robin list.
+           */
+          bool ready;
+        };
+
+
+        /**
+         * Maximum runs admitted at once.
+         */
+        const std::size_t concurrency_;
+
+
+        /**
+         * Minimum milliseconds between two admissions of the same key.
+         */
+        const long long interval_;
+
+
+        /**
+         * Milliseconds a run can wait before being refused.
+         */
+        const long long timeout_;
+
+
+        /**
+         * Number of runs admitted and not released.
+         */
+        std::size_t running_;
+
+
+        /**
+         * Number of runs waiting.
+         */
+        std::size_t waiting_;
+
+
+        /**
+         * Number of queues from which queues without
+         * waiting runs are removed.
+         */
+        std::size_t sweep_size_;
+
+
+        /**
+         * True when the scheduler is being destroyed.
+         */
+        bool stop_;
+
+
+        /**
+         * Queues by key.
+         */
+        std::unordered_map<std::string,Queue> queues_;
+
+
+        /**
+         * Keys with waiting runs, served round-robin.
+         */
+        std::deque<std::string> ready_;
+
+
+        /**
+         * Mutex protecting the queues and the counters.
+         */
+        std::mutex mtx_;
+
+
+        /**
+         * Wakes the scheduler thread when a run arrives or ends.
+         */
+        std::condition_variable cv_;
+
+
+        /**
+         * Thread admitting and refusing the waiting runs.
+         */
+        std::thread thread_;
+
+
+        /**
+         * Number of Scopes marking the current thread.
+         */
+        static int& Depth(){
+          static thread_local int depth = 0;
+          return depth;
+        };
+
+
+        /**
+         * Scheduler thread loop: refuses the runs whose deadline has passed,
+         * admits waiting runs while there is room, one per key in turn,
+         * and sleeps until something can change.
+         */
+        void Dispatch(){
+          std::unique_lock<std::mutex> lock(mtx_);
+          while (!stop_){
+            const clock::time_point now = clock::now();
+            clock::time_point wake = clock::time_point::max();
+            std::vector<std::pair<pplx::task_completion_event<bool>,bool>> completed;
+
+            // keys admitted in this pass go behind the keys still
+            // waiting for their turn, so a full scheduler does not
+            // keep serving the first keys.
+            std::deque<std::string> waiting_keys;
+            std::deque<std::string> served_keys;
+            for (std::size_t i = ready_.size(); i > 0; --i){
+              const std::string key = std::move(ready_.front());
+              ready_.pop_front();
+              Queue& queue = queues_[key];
+
+              // deadlines of the same key come in order.
+              while (!queue.waiters.empty() && queue.waiters.front().deadline <= now){
+                completed.push_back(std::make_pair(queue.waiters.front().admitted, false));
+                queue.waiters.pop_front();
+                --waiting_;
+              }
+
+              bool served = false;
+              if (!queue.waiters.empty() && running_ < concurrency_ && queue.next <= now){
+                completed.push_back(std::make_pair(queue.waiters.front().admitted, true));
+                queue.waiters.pop_front();
+                --waiting_;
+                ++running_;
+                queue.next = now + std::chrono::milliseconds(interval_);
+                served = true;
+              }
+
+              if (queue.waiters.empty()){
+                queue.ready = false;
+              }else{
+                (served ? served_keys : waiting_keys).push_back(key);
+                if (queue.waiters.front().deadline < wake){
+                  wake = queue.waiters.front().deadline;
+                }
+                if (running_ < concurrency_ && queue.next < wake){
+                  wake = queue.next;
+                }
+              }
+            }
+            ready_.swap(waiting_keys);
+            ready_.insert(ready_.end(), served_keys.begin(), served_keys.end());
+
+            if (!completed.empty()){
+              // continuations may take long, complete the tasks unlocked.
+              lock.unlock();
+              for (auto it = completed.begin(); it != completed.end(); ++it){
+                it->first.set(it->second);
+              }
+              lock.lock();
+              continue;
+            }
+
+            if (wake == clock::time_point::max()){
+              cv_.wait(lock);
+            }else{
+              cv_.wait_until(lock, wake);
+            }
+          }
+
+          // refuse the runs still waiting.
+          std::vector<pplx::task_completion_event<bool>> refused;
+          for (auto it = queues_.begin(); it != queues_.end(); ++it){
+            for (auto waiter = it->second.waiters.begin(); waiter != it->second.waiters.end(); ++waiter){
+              refused.push_back(waiter->admitted);
+            }
+          }
+          queues_.clear();
+          ready_.clear();
+          lock.unlock();
+          for (auto it = refused.begin(); it != refused.end(); ++it){
+            it->set(false);
+          }
+        };
+
+
+        /**
+         * Removes the queues without waiting runs that do not delay
+         * their next run anymore, when there are many queues.
+         * Needs the mutex.
+         * 
+         * @param now Current time.
+         */
+        void Sweep(const clock::time_point& now){
+          if (queues_.size() >= sweep_size_){
+            for (auto it = queues_.begin(); it != queues_.end();){
+              if (it->second.waiters.empty() && it->second.next <= now){
+                it = queues_.erase(it);
+              }else{
+                ++it;
+              }
+            }
+            sweep_size_ = queues_.size() * 2 > 1024 ? queues_.size() * 2 : 1024;
+          }
+        };
+
+
+        Scheduler(const Scheduler&) = delete;
+        Scheduler& operator=(const Scheduler&) = delete;
+    };
+  }
+}
@@ -26,11 +26,16 @@
   * https://developer.mozilla.org/en-US/docs/Mozilla/Projects/SpiderMonkey
   */
 #pragma once
+#include <atomic>
+#include <exception>
 #include <mutex>
 #include <map>
 #include "cpprest/json.h"
 #include "granada/defaults.h"
+#include "granada/util/mutex.h"
+#include "granada/util/application.h"
 #include "runner.h"
+#include "runner_scheduler.h"
 #include "jsapi.h"
 
 using namespace JS;
@@ -49,6 +54,10 @@ namespace granada{
      * 
      * If you are using Valgrind to detect memory leaks please read:
      * https://developer.mozilla.org/en-US/docs/Mozilla/Testing/Valgrind
+     * 
+     * A runtime and its context are bound to the thread that creates them,
+     * so each thread keeps its own runtime and reuses it for all its runs,
+     * only the global object is new in each run.
      */
     class SpiderMonkeyJavascriptRunner : public Runner
     {
@@ -74,7 +83,8 @@ namespace granada{
         /**
          * @override
          * Run given javascript script and returns the return/response
-         * of the script in form of string.
+         * of the script in form of string. The script runs in a new global
+         * object of the runtime of the calling thread.
          * 
          * @param _script   Javascript script.
          * @return          Return/Response returned by the script run.
@@ -105,6 +115,141 @@ namespace granada{
 
       protected:
 
+        /**
+         * Runtime and context, reused by the runs of a thread.
+         */
+        struct Runtime{
+
+          Runtime() : runtime(nullptr), context(nullptr), runs(0), busy(false){};
+
+
+          /**
+           * Destroys the context and the runtime.
+           */
+          ~Runtime(){
+            Close();
+          };
+
+
+          /**
+           * Creates the runtime and the context if they do not exist yet.
+           * @return True if the runtime can be used.
+           */
+          bool Open();
+
+
+          /**
+           * Destroys the context and the runtime, unless the
+           * JS engine has already been shut down.
+           */
+          void Close();
+
+
+          /**
+           * Counts a run and collects the garbage it has left or, after
+           * RUNTIME_RUNS_ runs, destroys the runtime.
+           */
+          void Recycle();
+
+
+          JSRuntime* runtime;
+          JSContext* context;
+
+
+          /**
+           * Number of runs since the runtime was created.
+           */
+          unsigned long long runs;
+
+
+          /**
+           * True while a script is running, a script run while the
+           * runtime is busy uses a runtime of its own.
+           */
+          bool busy;
+
+
+          /**
+           * Marks a runtime busy while it lives. Then the run is counted
+           * with Recycle or, if the run has thrown, the runtime is closed,
+           * so it is not left busy and the next run opens a new one.
+           */
+          class Lease{
+            public:
+
+              /**
+               * Constructor, marks the runtime busy.
+               * @param runtime Runtime of the run.
+               */
+              explicit Lease(Runtime& runtime) : runtime_(runtime){
+                runtime_.busy = true;
+              };
+
+
+              /**
+               * Destructor, frees the runtime.
+               */
+              ~Lease(){
+                runtime_.busy = false;
+                if (std::uncaught_exception()){
+                  runtime_.Close();
+                }else{
+                  runtime_.Recycle();
+                }
+              };
+
+            private:
+
+              Runtime& runtime_;
+
+              Lease(const Lease&) = delete;
+              Lease& operator=(const Lease&) = delete;
+          };
+        };
+
+
+        /**
+         * Maximum bytes of the heap of a runtime.
+         * Value taken from the "runner_spidermonkey_runtime_maxbytes" property.
+         */
+        static int RUNTIME_MAXBYTES_;
+
+
+        /**
+         * Size of the stack chunks of a context.
+         * Value taken from the "runner_spidermonkey_context_stackchunksize" property.
+         */
+        static int CONTEXT_STACKCHUNKSIZE_;
+
+
+        /**
+         * Number of runs between two full garbage collections of a runtime,
+         * 0 to let spidermonkey decide when to collect.
+         * Value taken from the "runner_spidermonkey_gc_frequency" property.
+         */
+        static int GC_FREQUENCY_;
+
+
+        /**
+         * Number of runs after which a runtime is replaced by a new one,
+         * 0 to never replace it.
+         * Value taken from the "runner_spidermonkey_runtime_runs" property.
+         */
+        static int RUNTIME_RUNS_;
+
+
+        /**
+         * Used for loading the properties only once.
+         */
+        static granada::util::mutex::call_once load_properties_call_once_;
+
+
+        /**
+         * True once the JS engine has been shut down, the runtimes of
+         * the threads still alive are not destroyed anymore.
+         */
+        static std::atomic<bool> shut_down_;
+
 
         /* The class of the global object. */
         static JSClass global_class_;
@@ -141,6 +286,29 @@ namespace granada{
         const std::string runner_initialization_error_ = "{\"" + default_strings::runner_error + "\":\"" + default_errors::runner_initialization_error + "\"}";
 
 
+        /**
+         * Returns the runtime of the calling thread.
+         * @return Runtime of the calling thread.
+         */
+        static Runtime& ThreadRuntime();
+
+
+        /**
+         * Loads the runtimes properties.
+         */
+        static void LoadProperties();
+
+
+        /**
+         * Runs a script in a new global object of the given runtime.
+         * 
+         * @param runtime Runtime, already open.
+         * @param _script Javascript script.
+         * @return        Return/Response returned by the script run.
+         */
+        std::string Run(Runtime& runtime, const std::string& _script);
+
+
         /**
          * Initializes the JS engine so that further operations can be performed.
          * It is currently not possible to initialize this runner multiple times
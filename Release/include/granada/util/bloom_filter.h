@@ -0,0 +1,192 @@
+/**
+  * Copyright (c) <2016> Web App SDK granada <afernandez@cookinapps.io>
+  *
+  * This source code is licensed under the MIT license.
+  *
+  * Permission is hereby granted, free of charge, to any person obtaining a copy
+  * of this software and associated documentation files (the "Software"), to deal
+  * in the Software without restriction, including without limitation the rights
+  * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  * copies of the Software, and to permit persons to whom the Software is
+  * furnished to do so, subject to the following conditions:
+  *
+  * The above copyright notice and this permission notice shall be included in
+  * all copies or substantial portions of the Software.
+  *
+  * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  * SOFTWARE.
+  *
+  * Probabilistic sets that can be shared by multiple threads without locks.
+  * 
+  */
+
+#pragma once
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+
+namespace granada {
+  namespace util {
+    namespace bloom{
+
+      /**
+       * Lock-free counting Bloom filter of strings.
+       * Tells if a string has definitely not been added, or if it
+       * may have been added. Each string sets hashes_count one byte counters,
+       * so strings can also be removed. A counter that reaches 255
+       * stays at 255, its strings may give false positives but never
+       * false negatives.
+       */
+      class counting_filter{
+        public:
+
+          /**
+           * Constructor.
+           * 
+           * @param counters_count  Number of counters, about ten per string
+           *                        expected to be in the filter at once gives
+           *                        less than 1% of false positives with 4 hashes.
+           * @param hashes_count    Number of counters set per string.
+           */
+          counting_filter(const std::size_t counters_count, const int hashes_count) :
+            counters_count_(counters_count > 0 ? counters_count : 1),
+            hashes_count_(hashes_count > 0 ? hashes_count : 1),
+            counters_(new std::atomic<unsigned char>[counters_count > 0 ? counters_count : 1]){
+            for (std::size_t i = 0; i < counters_count_; ++i){
+              counters_[i].store(0, std::memory_order_relaxed);
+            }
+          };
+
+
+          /**
+           * Adds a string. Can be called from any thread.
+           * 
+           * @param value String to add.
+           */
+          void add(const std::string& value){
+            std::size_t h1, h2;
+            hash(value, h1, h2);
+            for (int i = 0; i < hashes_count_; ++i){
+              std::atomic<unsigned char>& counter = counters_[(h1 + i * h2) % counters_count_];
+              unsigned char count = counter.load(std::memory_order_relaxed);
+              while (count < 255 && !counter.compare_exchange_weak(count, count + 1, std::memory_order_release, std::memory_order_relaxed));
+            }
+          };
+
+
+          /**
+           * Removes a string, only strings that have been added
+           * should be removed. Can be called from any thread.
+           * 
+           * @param value String to remove.
+           */
+          void remove(const std::string& value){
+            std::size_t h1, h2;
+            hash(value, h1, h2);
+            for (int i = 0; i < hashes_count_; ++i){
+              std::atomic<unsigned char>& counter = counters_[(h1 + i * h2) % counters_count_];
+              unsigned char count = counter.load(std::memory_order_relaxed);
+              while (count > 0 && count < 255 && !counter.compare_exchange_weak(count, count - 1, std::memory_order_release, std::memory_order_relaxed));
+            }
+          };
+
+
+          /**
+           * Returns false if the string has definitely not been added,
+           * true if it may have been added. Can be called from any thread.
+           * 
+           * @param value String to check.
+           * @return      False if the string is not in the filter.
+           */
+          bool may_contain(const std::string& value) const {
+            std::size_t h1, h2;
+            hash(value, h1, h2);
+            for (int i = 0; i < hashes_count_; ++i){
+              if (counters_[(h1 + i * h2) % counters_count_].load(std::memory_order_acquire) == 0){
+                return false;
+              }
+            }
+            return true;
+          };
+
+
+          /**
+           * Returns an estimate of the number of times a string has been added
+           * and not removed: the lowest of its counters. It can be higher than
+           * the real number but never lower, unless a counter stays at 255.
+           * Can be called from any thread.
+           * 
+           * @param value String to count.
+           * @return      Estimated number of times the string has been added.
+           */
+          unsigned char count(const std::string& value) const {
+            std::size_t h1, h2;
+            hash(value, h1, h2);
+            unsigned char minimum = 255;
+            for (int i = 0; i < hashes_count_; ++i){
+              unsigned char count = counters_[(h1 + i * h2) % counters_count_].load(std::memory_order_acquire);
+              if (count < minimum){
+                minimum = count;
+              }
+            }
+            return minimum;
+          };
+
+
+          /**
+           * Removes all the strings, used to forget old strings. Can be called
+           * from any thread, strings added at the same time may be kept partially.
+           */
+          void clear(){
+            for (std::size_t i = 0; i < counters_count_; ++i){
+              counters_[i].store(0, std::memory_order_relaxed);
+            }
+          };
+
+        private:
+
+          /**
+           * Number of counters.
+           */
+          const std::size_t counters_count_;
+
+
+          /**
+           * Number of counters set per string.
+           */
+          const int hashes_count_;
+
+
+          /**
+           * Counters.
+           */
+          std::unique_ptr<std::atomic<unsigned char>[]> counters_;
+
+
+          /**
+           * Computes the two hashes used to derive the positions
+           * of the counters of a string (double hashing).
+           */
+          void hash(const std::string& value, std::size_t& h1, std::size_t& h2) const {
+            h1 = std::hash<std::string>()(value);
+            // FNV-1a, odd so all the positions are reachable.
+            unsigned long long fnv = 14695981039346656037ULL;
+            for (auto it = value.begin(); it != value.end(); ++it){
+              fnv = (fnv ^ (unsigned char)*it) * 1099511628211ULL;
+            }
+            h2 = (std::size_t)(fnv | 1);
+          };
+
+
+          counting_filter(const counting_filter&) = delete;
+          counting_filter& operator=(const counting_filter&) = delete;
+      };
+    }
+  }
+}
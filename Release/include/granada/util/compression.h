@@ -0,0 +1,167 @@
+/**
+  * Copyright (c) <2016> Web App SDK granada <afernandez@cookinapps.io>
+  *
+  * This source code is licensed under the MIT license.
+  *
+  * Permission is hereby granted, free of charge, to any person obtaining a copy
+  * of this software and associated documentation files (the "Software"), to deal
+  * in the Software without restriction, including without limitation the rights
+  * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  * copies of the Software, and to permit persons to whom the Software is
+  * furnished to do so, subject to the following conditions:
+  *
+  * The above copyright notice and this permission notice shall be included in
+  * all copies or substantial portions of the Software.
+  *
+  * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  * SOFTWARE.
+  *
+  * In-process compression of contents: gzip with zlib and brotli when
+  * granada is built with GRANADA_BROTLI.
+  */
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include "zlib.h"
+#ifdef GRANADA_BROTLI
+  #include "brotli/encode.h"
+#endif
+#include "string.h"
+
+namespace granada{
+  namespace util{
+
+    /**
+     * Compression of contents and negotiation of content encodings.
+     */
+    namespace compression{
+
+      /**
+       * Compress a content in gzip format.
+       * @param  content    Content to compress.
+       * @param  compressed Vector where the compressed content is stored.
+       * @param  level      Compression level, from 1 (fastest) to 9 (smallest).
+       * @return            True if the content has been compressed, false if not.
+       */
+      static bool gzip(const std::vector<unsigned char>& content, std::vector<unsigned char>& compressed, int level = Z_DEFAULT_COMPRESSION){
+        z_stream stream;
+        stream.zalloc = Z_NULL;
+        stream.zfree = Z_NULL;
+        stream.opaque = Z_NULL;
+        // 15 window bits + 16 to write a gzip header instead of a zlib one.
+        if (deflateInit2(&stream, level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK){
+          return false;
+        }
+        compressed.resize(deflateBound(&stream, (uLong)content.size()));
+        stream.next_in = (Bytef*)content.data();
+        stream.avail_in = (uInt)content.size();
+        stream.next_out = compressed.data();
+        stream.avail_out = (uInt)compressed.size();
+        int result = deflate(&stream, Z_FINISH);
+        compressed.resize(stream.total_out);
+        deflateEnd(&stream);
+        if (result != Z_STREAM_END){
+          compressed.clear();
+          return false;
+        }
+        return true;
+      }
+
+
+      /**
+       * Returns true if brotli compression is available.
+       * @return  True if granada is built with brotli, false if not.
+       */
+      static inline bool brotli_available(){
+        #ifdef GRANADA_BROTLI
+          return true;
+        #else
+          return false;
+        #endif
+      }
+
+
+      /**
+       * Compress a content in brotli format.
+       * @param  content    Content to compress.
+       * @param  compressed Vector where the compressed content is stored.
+       * @param  quality    Compression quality, from 0 (fastest) to 11 (smallest).
+       * @return            True if the content has been compressed, false if not
+       *                    or if brotli is not available.
+       */
+      static bool brotli(const std::vector<unsigned char>& content, std::vector<unsigned char>& compressed, int quality = 5){
+        #ifdef GRANADA_BROTLI
+          std::size_t compressed_size = BrotliEncoderMaxCompressedSize(content.size());
+          if (compressed_size == 0){
+            return false;
+          }
+          compressed.resize(compressed_size);
+          if (BrotliEncoderCompress(quality, BROTLI_DEFAULT_WINDOW, BROTLI_MODE_GENERIC, content.size(), content.data(), &compressed_size, compressed.data()) == BROTLI_FALSE){
+            compressed.clear();
+            return false;
+          }
+          compressed.resize(compressed_size);
+          return true;
+        #else
+          compressed.clear();
+          return false;
+        #endif
+      }
+
+
+      /**
+       * Returns true if the given content encoding is accepted according to
+       * the value of an Accept-Encoding header. Encodings with a quality
+       * of 0 are not accepted, "*" accepts any encoding.
+       * Example:
+       *      accept_encoding:
+       *          gzip, deflate, br;q=0
+       *      accepted:
+       *          gzip
+       *      not accepted:
+       *          br
+       *
+       * @param  accept_encoding  Value of the Accept-Encoding header.
+       * @param  encoding         Content encoding, example: gzip.
+       * @return                  True if the encoding is accepted, false if not.
+       */
+      static bool accepts(const std::string& accept_encoding, const std::string& encoding){
+        bool accepted = false;
+        std::vector<std::string> codings;
+        granada::util::string::split(accept_encoding, ',', codings);
+        for (auto it = codings.begin(); it != codings.end(); ++it){
+          std::string coding = *it;
+          std::string quality;
+          std::size_t pos = coding.find(';');
+          if (pos != std::string::npos){
+            quality = coding.substr(pos + 1);
+            coding = coding.substr(0, pos);
+            granada::util::string::trim(quality);
+          }
+          granada::util::string::trim(coding);
+          granada::util::string::to_lower(coding);
+          if (coding == encoding || coding == "*"){
+            // q=0, q=0.0 ... mean not acceptable.
+            bool refused = false;
+            if (quality.length() > 2 && (quality[0] == 'q' || quality[0] == 'Q') && quality[1] == '='){
+              refused = quality.find_first_not_of("0.", 2) == std::string::npos;
+            }
+            if (coding == encoding){
+              return !refused;
+            }
+            accepted = !refused;
+          }
+        }
+        return accepted;
+      }
+
+    }
+  }
+}
@@ -33,6 +33,7 @@
 #include <unordered_map>
 #include <fstream>
 #include <sstream>
+#include <cstddef>
 #include "string.h"
 
 namespace granada{
@@ -91,6 +92,27 @@ namespace granada{
       }
 
 
+      /**
+       * Reads the content of a file into a buffer allocated once with
+       * the expected size of the file. If the file is shorter than expected
+       * the buffer is shrunk to the bytes read.
+       * @param   file_path   Path of the file.
+       * @param   size        Expected size of the file in bytes.
+       * @param   content     Buffer where the content is read.
+       * @return              True if the file could be read.
+       */
+      static inline bool ReadContent(const std::string& file_path, const std::size_t size, std::vector<unsigned char>& content){
+        std::ifstream ifs(file_path, std::ios::binary);
+        if (!ifs.good()){
+          return false;
+        }
+        content.resize(size);
+        ifs.read(reinterpret_cast<char*>(content.data()), size);
+        content.resize((std::size_t)ifs.gcount());
+        return true;
+      }
+
+
       /**
        * Replace a deque of key tags in a file by a value.
        * Example:
@@ -0,0 +1,143 @@
+/**
+  * Copyright (c) <2016> Web App SDK granada <afernandez@cookinapps.io>
+  *
+  * This source code is licensed under the MIT license.
+  *
+  * Permission is hereby granted, free of charge, to any person obtaining a copy
+  * of this software and associated documentation files (the "Software"), to deal
+  * in the Software without restriction, including without limitation the rights
+  * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  * copies of the Software, and to permit persons to whom the Software is
+  * furnished to do so, subject to the following conditions:
+  *
+  * The above copyright notice and this permission notice shall be included in
+  * all copies or substantial portions of the Software.
+  *
+  * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  * SOFTWARE.
+  *
+  * Queues that can be shared by multiple threads without locks.
+  * 
+  */
+
+#pragma once
+#include <atomic>
+#include <deque>
+#include <utility>
+
+namespace granada {
+  namespace util {
+    namespace queue{
+
+      /**
+       * Lock-free multiple producers single consumer queue.
+       * Producers push values one by one, the consumer takes all
+       * the pushed values at once, in the same order they were pushed.
+       * Neither the producers nor the consumer ever block.
+       */
+      template <typename T>
+      class mpsc_queue{
+        public:
+
+          /**
+           * Constructor.
+           */
+          mpsc_queue() : head_(nullptr){};
+
+
+          /**
+           * Destructor. Frees the values that have not been popped.
+           */
+          ~mpsc_queue(){
+            node* n = head_.exchange(nullptr);
+            while (n != nullptr){
+              node* next = n->next;
+              delete n;
+              n = next;
+            }
+          };
+
+
+          /**
+           * Pushes a value in the queue. Can be called from any thread.
+           * 
+           * @param value Value to push.
+           */
+          void push(T value){
+            node* n = new node(std::move(value));
+            n->next = head_.load(std::memory_order_relaxed);
+            while (!head_.compare_exchange_weak(n->next, n, std::memory_order_release, std::memory_order_relaxed));
+          };
+
+
+          /**
+           * Returns true if there is no value in the queue.
+           * 
+           * @return  True if queue is empty, false if it is not.
+           */
+          bool empty() const {
+            return head_.load(std::memory_order_acquire) == nullptr;
+          };
+
+
+          /**
+           * Takes all the values of the queue and appends them to the given
+           * deque in the order they were pushed. Only one thread at a time
+           * should call this function.
+           * 
+           * @param values  Deque where the values are appended.
+           * @return        Number of values popped.
+           */
+          std::size_t pop_all(std::deque<T>& values){
+            node* n = head_.exchange(nullptr, std::memory_order_acquire);
+
+            // nodes are linked from the last pushed to the first pushed,
+            // reverse them to keep the order.
+            node* reversed = nullptr;
+            while (n != nullptr){
+              node* next = n->next;
+              n->next = reversed;
+              reversed = n;
+              n = next;
+            }
+
+            std::size_t count = 0;
+            while (reversed != nullptr){
+              node* next = reversed->next;
+              values.push_back(std::move(reversed->value));
+              delete reversed;
+              reversed = next;
+              ++count;
+            }
+            return count;
+          };
+
+        private:
+
+          /**
+           * Node of the queue.
+           */
+          struct node{
+            node(T&& _value) : value(std::move(_value)), next(nullptr){};
+            T value;
+            node* next;
+          };
+
+
+          /**
+           * Last pushed node.
+           */
+          std::atomic<node*> head_;
+
+
+          mpsc_queue(const mpsc_queue&) = delete;
+          mpsc_queue& operator=(const mpsc_queue&) = delete;
+      };
+    }
+  }
+}
@@ -0,0 +1,208 @@
+/**
+  * Copyright (c) <2016> Web App SDK granada <afernandez@cookinapps.io>
+  *
+  * This source code is licensed under the MIT license.
+  *
+  * Permission is hereby granted, free of charge, to any person obtaining a copy
+  * of this software and associated documentation files (the "Software"), to deal
+  * in the Software without restriction, including without limitation the rights
+  * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  * copies of the Software, and to permit persons to whom the Software is
+  * furnished to do so, subject to the following conditions:
+  *
+  * The above copyright notice and this permission notice shall be included in
+  * all copies or substantial portions of the Software.
+  *
+  * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  * SOFTWARE.
+  *
+  * Rate limiting with token buckets that can be shared by multiple threads
+  * without locks.
+  * 
+  */
+
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+
+namespace granada {
+  namespace util {
+    namespace rate{
+
+      /**
+       * Lock-free table of token buckets keyed by strings, for example
+       * session tokens. Each bucket gets rate tokens per second and holds
+       * up to burst tokens, a key can be used burst times in a row and then
+       * rate times per second.
+       * 
+       * A bucket is stored as the time it will be full again (generic cell
+       * rate algorithm), so taking a token is a single compare and swap and
+       * a bucket that has been full for a while is the same as no bucket:
+       * its slot is reused by other keys. When all the slots a key can use
+       * are taken by busy keys, it shares the bucket of its first slot.
+       */
+      class token_buckets{
+        public:
+
+          /**
+           * Constructor.
+           * 
+           * @param rate        Tokens added to each bucket per second.
+           * @param burst       Maximum tokens of a bucket, at least 1.
+           * @param slots_count Number of buckets, the number of keys expected
+           *                    to be limited at once, by default 4096.
+           */
+          token_buckets(const double rate, const double burst, const std::size_t slots_count = 4096) :
+            interval_(rate > 0 ? (long long)(1000000 / rate) : 0),
+            tolerance_(rate > 0 && burst > 1 ? (long long)(1000000 / rate * (burst - 1)) : 0),
+            slots_count_(slots_count > 0 ? slots_count : 1),
+            slots_(new slot[slots_count > 0 ? slots_count : 1]){
+            for (std::size_t i = 0; i < slots_count_; ++i){
+              slots_[i].key.store(0, std::memory_order_relaxed);
+              slots_[i].full.store(0, std::memory_order_relaxed);
+            }
+          };
+
+
+          /**
+           * Takes a token from the bucket of a key. Never blocks, can be
+           * called from any thread.
+           * 
+           * @param key Key of the bucket, for example a session token.
+           * @return    0 if a token has been taken, if the bucket is empty,
+           *            the milliseconds until it has a token again.
+           */
+          long long acquire(const std::string& key){
+            if (interval_ == 0){
+              return 0;
+            }
+            const long long now = microseconds();
+            slot& bucket = find(key, now);
+            long long full = bucket.full.load(std::memory_order_relaxed);
+            for (;;){
+              const long long start = full > now ? full : now;
+              if (start - now > tolerance_){
+                // the bucket is empty, time until the next token.
+                return (start - tolerance_ - now + 999) / 1000;
+              }
+              if (bucket.full.compare_exchange_weak(full, start + interval_, std::memory_order_acq_rel, std::memory_order_relaxed)){
+                return 0;
+              }
+            }
+          };
+
+        private:
+
+          /**
+           * Bucket of a key.
+           */
+          struct slot{
+
+            /**
+             * Hash of the key, 0 if the slot has never been used.
+             */
+            std::atomic<std::size_t> key;
+
+
+            /**
+             * Time in microseconds when the bucket will be full.
+             */
+            std::atomic<long long> full;
+          };
+
+
+          /**
+           * Number of slots looked at to find the bucket of a key.
+           */
+          static const std::size_t PROBES = 8;
+
+
+          /**
+           * Microseconds between two tokens.
+           */
+          const long long interval_;
+
+
+          /**
+           * Microseconds a bucket can be ahead of the current time,
+           * (burst - 1) tokens.
+           */
+          const long long tolerance_;
+
+
+          /**
+           * Number of slots.
+           */
+          const std::size_t slots_count_;
+
+
+          /**
+           * Buckets.
+           */
+          std::unique_ptr<slot[]> slots_;
+
+
+          /**
+           * Returns the bucket of a key: the slot with its hash, a free
+           * slot or a slot whose bucket is full, which is claimed for the key.
+           * 
+           * @param key Key of the bucket.
+           * @param now Current time in microseconds.
+           * @return    Bucket of the key.
+           */
+          slot& find(const std::string& key, const long long now){
+            std::size_t hash = std::hash<std::string>()(key);
+            if (hash == 0){
+              hash = 1;
+            }
+            const std::size_t first = hash % slots_count_;
+            std::size_t idle = slots_count_;
+            for (std::size_t i = 0; i < PROBES && i < slots_count_; ++i){
+              const std::size_t position = (first + i) % slots_count_;
+              slot& candidate = slots_[position];
+              std::size_t owner = candidate.key.load(std::memory_order_acquire);
+              if (owner == hash){
+                return candidate;
+              }
+              if (owner == 0){
+                if (candidate.key.compare_exchange_strong(owner, hash, std::memory_order_acq_rel) || owner == hash){
+                  return candidate;
+                }
+              }else if (idle == slots_count_ && candidate.full.load(std::memory_order_relaxed) <= now){
+                idle = position;
+              }
+            }
+            if (idle != slots_count_){
+              // a full bucket is the same as a new one, reuse it.
+              slot& candidate = slots_[idle];
+              std::size_t owner = candidate.key.load(std::memory_order_acquire);
+              if (candidate.full.load(std::memory_order_relaxed) <= now && candidate.key.compare_exchange_strong(owner, hash, std::memory_order_acq_rel)){
+                return candidate;
+              }
+            }
+            return slots_[first];
+          };
+
+
+          /**
+           * Returns a monotonic time in microseconds.
+           */
+          static long long microseconds(){
+            return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+          };
+
+
+          token_buckets(const token_buckets&) = delete;
+          token_buckets& operator=(const token_buckets&) = delete;
+      };
+    }
+  }
+}
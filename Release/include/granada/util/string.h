@@ -250,6 +250,50 @@ namespace granada{
         }
       }
 
+
+      /**
+       * Returns true if the given string matches the given pattern,
+       * "*" matches any sequence of characters, even an empty one.
+       * Example:
+       *      str:
+       *          session:value:6464
+       *      patterns that match:
+       *          session:value:*
+       *          *:value:*
+       *          session:value:6464
+       *
+       * @param  str      String to check.
+       * @param  pattern  Pattern/expression.
+       * @return          True if the string matches the pattern, false if not.
+       */
+      static bool wildcard_match(const std::string& str, const std::string& pattern){
+        std::size_t s = 0;
+        std::size_t p = 0;
+        std::size_t star = std::string::npos;
+        std::size_t star_s = 0;
+        while (s < str.length()){
+          if (p < pattern.length() && pattern[p] == '*'){
+            // remember the position of the wildcard, try first
+            // matching an empty sequence.
+            star = p++;
+            star_s = s;
+          }else if (p < pattern.length() && pattern[p] == str[s]){
+            ++s;
+            ++p;
+          }else if (star != std::string::npos){
+            // make the last wildcard absorb one more character.
+            p = star + 1;
+            s = ++star_s;
+          }else{
+            return false;
+          }
+        }
+        while (p < pattern.length() && pattern[p] == '*'){
+          ++p;
+        }
+        return p == pattern.length();
+      }
+
     }
   }
 }
@@ -27,9 +27,13 @@
 #pragma once
 #include <atomic>
 #include <thread>
+#include <mutex>
+#include <condition_variable>
 #include <string>
 #include <sstream>
 #include <ctime>
+#include <cstdio>
+#include <cstring>
 #include <chrono>
 #include <sys/timeb.h>
 
@@ -67,6 +71,64 @@ namespace granada{
       };
 
 
+      /**
+       * Format time_t as an HTTP date (IMF-fixdate), always in GMT.
+       * Example: Tue, 15 Nov 1994 12:45:26 GMT
+       * @param  _time Time to format.
+       * @return       Formatted date.
+       */
+      static std::string format_http_date(const std::time_t& _time){
+        std::tm tm;
+        #ifdef _WIN32
+          gmtime_s(&tm,&_time);
+        #else
+          gmtime_r(&_time,&tm);
+        #endif
+        static const char* days[] = {"Sun","Mon","Tue","Wed","Thu","Fri","Sat"};
+        static const char* months[] = {"Jan","Feb","Mar","Apr","May","Jun","Jul","Aug","Sep","Oct","Nov","Dec"};
+        char buffer[32];
+        std::snprintf(buffer, sizeof(buffer), "%s, %02d %s %04d %02d:%02d:%02d GMT", days[tm.tm_wday], tm.tm_mday, months[tm.tm_mon], tm.tm_year + 1900, tm.tm_hour, tm.tm_min, tm.tm_sec);
+        return buffer;
+      };
+
+
+      /**
+       * Parse an HTTP date into time_t. Accepts the IMF-fixdate format
+       * and the obsolete RFC 850 and asctime formats:
+       *      Sun, 06 Nov 1994 08:49:37 GMT
+       *      Sunday, 06-Nov-94 08:49:37 GMT
+       *      Sun Nov  6 08:49:37 1994
+       * @param  date_str HTTP date.
+       * @return          Parsed time, -1 if the date can not be parsed.
+       */
+      static std::time_t parse_http_date(const std::string& date_str){
+        static const char* months = "JanFebMarAprMayJunJulAugSepOctNovDec";
+        char month[4] = {0};
+        int day, year, hour, minute, second;
+        if (std::sscanf(date_str.c_str(), "%*3s, %2d %3s %4d %2d:%2d:%2d GMT", &day, month, &year, &hour, &minute, &second) != 6){
+          if (std::sscanf(date_str.c_str(), "%*[^,], %2d-%3s-%2d %2d:%2d:%2d GMT", &day, month, &year, &hour, &minute, &second) == 6){
+            year += year < 70 ? 2000 : 1900;
+          }else if (std::sscanf(date_str.c_str(), "%*3s %3s %d %2d:%2d:%2d %4d", month, &day, &hour, &minute, &second, &year) != 6){
+            return -1;
+          }
+        }
+        const char* found = std::strstr(months, month);
+        if (std::strlen(month) != 3 || found == nullptr || (found - months) % 3 != 0){
+          return -1;
+        }
+        int mon = (int)(found - months) / 3 + 1;
+
+        // days since 1970-01-01 of the civil date, without time zone conversions.
+        int y = year - (mon <= 2 ? 1 : 0);
+        int era = (y >= 0 ? y : y - 399) / 400;
+        int yoe = y - era * 400;
+        int doy = (153 * (mon + (mon > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+        int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+        long long days = (long long)era * 146097 + doe - 719468;
+        return (std::time_t)(days * 86400 + hour * 3600 + minute * 60 + second);
+      };
+
+
       /**
        * Returns true if the difference in seconds between now and the given time is higher than
        * the given timeout seconds plus an extra seconds.
@@ -151,7 +213,7 @@ namespace granada{
        */
       class timer{
         public:
-          timer(){};
+          timer() : loop_(false), started_(false){};
 
           /**
            * Constructor
@@ -162,7 +224,7 @@ namespace granada{
            * @param   unit  Optional. "s" by default. "s" if num is in seconds
            *                and ms if it is in milliseconds.
            */
-          timer(std::function<void(void)> fn,int num,const std::string unit = "s"){
+          timer(std::function<void(void)> fn,int num,const std::string unit = "s") : loop_(false), started_(false){
             set(std::move(fn),std::move(num),std::move(unit));
           };
 
@@ -184,18 +246,38 @@ namespace granada{
               }else{
                 num_ = std::move(num);
               }
-              pplx::create_task([this,fn]{
+              task_ = pplx::create_task([this,fn]{
                 recursive(fn);
               });
+              started_ = true;
             }
           };
 
 
           /**
-           * Stops the timer
+           * Stops the timer, a wait between two calls is interrupted.
+           * The function may still be running when stop returns,
+           * use join to wait for it.
            */
           void stop(){
-            loop_ = false;
+            {
+              std::lock_guard<std::mutex> lg(mtx_);
+              loop_ = false;
+            }
+            cv_.notify_all();
+          };
+
+
+          /**
+           * Stops the timer and waits until the function has returned,
+           * so the objects it uses can be destroyed.
+           * Must not be called from the function itself.
+           */
+          void join(){
+            stop();
+            if (started_){
+              task_.wait();
+            }
           };
 
         private:
@@ -215,16 +297,42 @@ namespace granada{
           std::atomic_bool loop_;
 
 
+          /**
+           * Task calling the function, waited by join.
+           */
+          pplx::task<void> task_;
+
+
+          /**
+           * True if the task has been started.
+           */
+          bool started_;
+
+
+          /**
+           * Mutex and condition variable used to wait between
+           * two calls, so stop can interrupt the wait.
+           */
+          std::mutex mtx_;
+          std::condition_variable cv_;
+
+
           /**
            * Calls a function recursively
            * 
            * @param fn Function to call.
            */
           void recursive(std::function<void(void)> fn){
-            granada::util::time::sleep_milliseconds(num_);
-            fn();
-            if (loop_){
-              recursive(fn);
+            // loop instead of recursing, so a timer running
+            // every few seconds does not grow the stack.
+            while (true){
+              {
+                std::unique_lock<std::mutex> lk(mtx_);
+                if (cv_.wait_for(lk, std::chrono::milliseconds(num_), [this]{ return !loop_; })){
+                  return;
+                }
+              }
+              fn();
             }
           };
 
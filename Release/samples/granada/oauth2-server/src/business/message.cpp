@@ -33,11 +33,12 @@ namespace granada{
 
   Message::Message(std::shared_ptr<granada::cache::CacheHandler>& cache){
     cache_ = cache;
-    n_generator_ = std::unique_ptr<utility::nonce_generator>(new utility::nonce_generator(16));
+    n_generator_ = std::unique_ptr<granada::crypto::NonceGenerator>(new granada::crypto::BufferedNonceGenerator());
   }
 
   void Message::Create(const std::string username, const std::string& message){
-	std::string message_id = utility::conversions::to_utf8string(n_generator_->generate());
+	int message_id_length = 16;
+	std::string message_id = n_generator_->generate(message_id_length);
     if (cache_->Exists("message:" + username + ":" + message_id)){
       Create(username,message);
     }else{
@@ -36,6 +36,7 @@
 #include "granada/util/string.h"
 #include "granada/util/time.h"
 #include "granada/cache/cache_handler.h"
+#include "granada/crypto/nonce_generator.h"
 #include "cpprest/asyncrt_utils.h"
 
 namespace granada{
@@ -93,9 +94,8 @@ namespace granada{
 
       /**
        * Nonce string generator, for generating unique strings tokens.
-       * From cpprest/asyncrt_utils.h
        * Generate a nonce string containing random alphanumeric characters (A-Za-z0-9).
        */
-      std::unique_ptr<utility::nonce_generator> n_generator_;
+      std::unique_ptr<granada::crypto::NonceGenerator> n_generator_;
   };
 }
@@ -36,7 +36,7 @@ namespace granada{
     namespace controller{
       ApplicationController::ApplicationController(utility::string_t url,std::shared_ptr<granada::http::session::SessionFactory>& session_factory)
       {
-        n_generator_ = std::unique_ptr<utility::nonce_generator>(new utility::nonce_generator(32));
+        n_generator_ = std::unique_ptr<granada::crypto::NonceGenerator>(new granada::crypto::BufferedNonceGenerator());
         m_listener_ = std::unique_ptr<http_listener>(new http_listener(url));
         m_listener_->support(methods::GET, std::bind(&ApplicationController::handle_get, this, std::placeholders::_1));
         m_listener_->support(methods::PUT, std::bind(&ApplicationController::handle_put, this, std::placeholders::_1));
@@ -85,7 +85,8 @@ namespace granada{
               MessageApplicationSessionFactory(session, request, response);
 
               // generate state
-			  std::string state(utility::conversions::to_utf8string(n_generator_->generate()));
+			  int state_length = 32;
+			  std::string state(n_generator_->generate(state_length));
               session->roles()->SetProperty("msg.user", "state", state);
               session->roles()->SetProperty("msg.user", "state.creation.time", granada::util::time::stringify(std::time(nullptr)));
               oauth2_response.response_type = "code";
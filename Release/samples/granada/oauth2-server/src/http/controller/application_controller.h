@@ -37,6 +37,7 @@
 #include "granada/http/parser.h"
 #include "granada/http/controller/controller.h"
 #include "cpprest/asyncrt_utils.h"
+#include "granada/crypto/nonce_generator.h"
 #include "../../business/message.h"
 #include "boost/filesystem.hpp"
 
@@ -63,10 +64,9 @@ namespace granada{
 
           /**
            * Nonce string generator, for generating unique strings tokens.
-           * From cpprest/asyncrt_utils.h
            * Generate a nonce string containing random alphanumeric characters (A-Za-z0-9).
            */
-          std::unique_ptr<utility::nonce_generator> n_generator_;
+          std::unique_ptr<granada::crypto::NonceGenerator> n_generator_;
 
 
           /**
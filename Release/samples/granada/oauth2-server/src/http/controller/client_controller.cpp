@@ -73,7 +73,7 @@ namespace granada{
             granada::util::string::split(roles_str,' ',roles);
 
             // generate client secret
-            granada::crypto::CPPRESTNonceGenerator n_generator;
+            granada::crypto::BufferedNonceGenerator n_generator;
             int password_length = 12;
             std::string password = n_generator.generate(password_length);
 
@@ -38,7 +38,7 @@ namespace granada{
       {
 		  session_factory_ = session_factory;
 		  cache_ = cache;
-        n_generator_ = std::unique_ptr<utility::nonce_generator>(new utility::nonce_generator(32));
+        n_generator_ = std::unique_ptr<granada::crypto::NonceGenerator>(new granada::crypto::BufferedNonceGenerator());
         m_listener_ = std::unique_ptr<http_listener>(new http_listener(url));
         m_listener_->support(methods::PUT, std::bind(&MessageController::handle_put, this, std::placeholders::_1));
         m_listener_->support(methods::POST, std::bind(&MessageController::handle_post, this, std::placeholders::_1));
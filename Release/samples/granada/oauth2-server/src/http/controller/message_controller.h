@@ -31,6 +31,7 @@
 #include "cpprest/details/basic_types.h"
 #include "cpprest/json.h"
 #include "cpprest/asyncrt_utils.h"
+#include "granada/crypto/nonce_generator.h"
 #include "granada/cache/cache_handler.h"
 #include "cpprest/http_client.h"
 #include "granada/http/parser.h"
@@ -54,10 +55,9 @@ namespace granada{
 
           /**
            * Nonce string generator, for generating unique strings tokens.
-           * From cpprest/asyncrt_utils.h
            * Generate a nonce string containing random alphanumeric characters (A-Za-z0-9).
            */
-          std::unique_ptr<utility::nonce_generator> n_generator_;
+          std::unique_ptr<granada::crypto::NonceGenerator> n_generator_;
 
 
           /**
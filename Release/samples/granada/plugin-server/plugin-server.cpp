@@ -31,6 +31,7 @@
 #include "granada/plugin/map_spidermonkey_plugin.h"
 #include "granada/http/controller/browser_controller.h"
 #include "granada/http/controller/plugin_controller.h"
+#include "granada/http/controller/metrics_controller.h"
 
 ////
 // Vector containing all used controllers.
@@ -71,6 +72,22 @@ void on_initialize(const string_t& address)
   g_controllers.push_back(std::move(plugin_controller));
   ucout << "Plugin Controller: Initialized... Listening for requests at: " << addr << std::endl;
 
+  ////
+  // Metrics Controller
+  // Responds with the metrics of the requests in Prometheus text format.
+  // get property "metrics_controller" from the server configuration file
+  // If this property equals "on" we will use metrics controller.
+  std::string metrics_module = granada::util::application::GetProperty("metrics_controller");
+  if(!metrics_module.empty() && metrics_module=="on"){
+    uri_builder metrics_uri(address);
+    metrics_uri.append_path(U("metrics"));
+    auto metrics_addr = metrics_uri.to_uri().to_string();
+    std::unique_ptr<granada::http::controller::Controller> metrics_controller(new granada::http::controller::MetricsController(metrics_addr));
+    metrics_controller->open().wait();
+    g_controllers.push_back(std::move(metrics_controller));
+    ucout << "Metrics Controller: Initialized... Listening for requests at: " << metrics_addr << std::endl;
+  }
+
   return;
 }
 
@@ -83,6 +83,36 @@ namespace granada{
     }
 
 
+    RedisAsyncClientWrapper::RedisAsyncClientWrapper(const std::string& address, const unsigned short& port, const std::vector<std::pair<std::string,std::function<void(const std::vector<char>&)>>>& channels){
+      work_.reset(new boost::asio::io_service::work(io_service_));
+      redis_.reset(new redisclient::RedisAsyncClient(io_service_));
+
+      redisclient::RedisAsyncClient* redis = redis_.get();
+      redis->asyncConnect(boost::asio::ip::address::from_string(address), port, [redis,channels](bool ok, const std::string& errmsg){
+        if (ok){
+          for (auto it = channels.begin(); it != channels.end(); ++it){
+            redis->subscribe(it->first, it->second);
+          }
+        }else{
+          std::cout << "Can t connect to redis: " << errmsg << std::endl;
+        }
+      });
+
+      thread_ = std::thread([this]{
+        io_service_.run();
+      });
+    }
+
+
+    RedisAsyncClientWrapper::~RedisAsyncClientWrapper(){
+      work_.reset();
+      io_service_.stop();
+      if (thread_.joinable()){
+        thread_.join();
+      }
+    }
+
+
     std::unique_ptr<granada::cache::RedisCacheDriver> RedisIterator::cache_(new granada::cache::RedisCacheDriver());
 
     RedisIterator::RedisIterator(const std::string& expression){
@@ -184,6 +214,9 @@ namespace granada{
 
     std::mutex RedisCacheDriver::mtx_;
     std::unique_ptr<RedisSyncClientWrapper> RedisCacheDriver::redis_(new RedisSyncClientWrapper());
+    granada::cache::CacheSubscriptions RedisCacheDriver::subscriptions_;
+    std::unique_ptr<RedisAsyncClientWrapper> RedisCacheDriver::subscriber_;
+    granada::util::mutex::call_once RedisCacheDriver::subscribe_call_once_;
 
     const bool RedisCacheDriver::Exists(const std::string& key){
 
@@ -247,6 +280,27 @@ namespace granada{
     }
 
 
+    const bool RedisCacheDriver::ReadAll(const std::string& hash, std::unordered_map<std::string,std::string>& values){
+      values.clear();
+
+      const redisclient::RedisValue& result = [&]{
+        std::lock_guard<std::mutex> lg(mtx_);
+        return redis_->get()->command("HGETALL", {hash});
+      }();
+
+      if(result.isOk() && result.isArray())
+      {
+        // reply is a flat array: field, value, field, value...
+        const std::vector<redisclient::RedisValue>& fields = result.toArray();
+        for (std::size_t i = 0; i + 1 < fields.size(); i += 2){
+          values[fields[i].toString()] = fields[i + 1].toString();
+        }
+        return true;
+      }
+      return false;
+    }
+
+
     void RedisCacheDriver::Write(const std::string& key,const std::string& value){
       std::lock_guard<std::mutex> lg(mtx_);
       redis_->get()->command("SET", {key, value});
@@ -296,6 +350,133 @@ namespace granada{
     }
 
 
+    bool RedisCacheDriver::Commit(const granada::cache::CacheBatch& batch, std::vector<long long>& replies){
+      replies.clear();
+      if (batch.empty()){
+        return true;
+      }
+
+      // the whole batch is one script: one round trip, and no other
+      // client runs a command while the script runs.
+      // Each operation takes four arguments: type, hash, key and value.
+      // A rename of a missing key replies 0 instead of failing, as
+      // RENAMENX would, an update of a missing hash replies 0.
+      static const std::string script =
+        "local replies = {} "
+        "for i = 1, #ARGV, 4 do "
+          "local op, hash, key, value = ARGV[i], ARGV[i+1], ARGV[i+2], ARGV[i+3] "
+          "local reply = 1 "
+          "if op == '0' then "
+            "if hash == '' then redis.call('SET', key, value) else redis.call('HSET', hash, key, value) end "
+          "elseif op == '1' then "
+            "if hash == '' then reply = redis.call('DEL', key) else reply = redis.call('HDEL', hash, key) end "
+          "elseif op == '2' then "
+            "if redis.call('EXISTS', key) == 1 then reply = redis.call('RENAMENX', key, value) else reply = 0 end "
+          "elseif op == '3' then "
+            "redis.call('ZADD', hash, value, key) "
+          "elseif op == '4' then "
+            "redis.call('ZREM', hash, key) "
+          "elseif op == '5' then "
+            "if redis.call('EXISTS', hash) == 1 then redis.call('HSET', hash, key, value) else reply = 0 end "
+          "end "
+          "replies[#replies + 1] = reply "
+        "end "
+        "return replies";
+
+      const std::vector<granada::cache::CacheBatch::Operation>& operations = batch.operations();
+      std::deque<redisclient::RedisBuffer> args = {script, "0"};
+      for (auto it = operations.begin(); it != operations.end(); ++it){
+        args.push_back(std::to_string((int)it->type));
+        args.push_back(it->hash);
+        args.push_back(it->key);
+        args.push_back(it->value);
+      }
+
+      const redisclient::RedisValue& result = [&]{
+        std::lock_guard<std::mutex> lg(mtx_);
+        return redis_->get()->command("EVAL", args);
+      }();
+
+      // the script answers with the reply of each operation,
+      // or with an error if one of the operations failed.
+      if(result.isOk() && result.isArray())
+      {
+        const std::vector<redisclient::RedisValue>& values = result.toArray();
+        if (values.size() != operations.size()){
+          return false;
+        }
+        for (auto it = values.begin(); it != values.end(); ++it){
+          replies.push_back(it->isInt() ? it->toInt() : 1);
+        }
+        return true;
+      }
+      return false;
+    }
+
+
+    void RedisCacheDriver::Index(const std::string& index, const std::string& member, const long long& score){
+      std::lock_guard<std::mutex> lg(mtx_);
+      redis_->get()->command("ZADD", {index, std::to_string(score), member});
+    }
+
+
+    void RedisCacheDriver::Unindex(const std::string& index, const std::string& member){
+      std::lock_guard<std::mutex> lg(mtx_);
+      redis_->get()->command("ZREM", {index, member});
+    }
+
+
+    void RedisCacheDriver::PopIndex(const std::string& index, const long long& max_score, const std::size_t& count, std::vector<std::string>& members){
+      members.clear();
+
+      // range and remove atomically.
+      static const std::string script =
+        "local members = redis.call('ZRANGEBYSCORE', KEYS[1], '-inf', ARGV[1], 'LIMIT', 0, ARGV[2]) "
+        "if #members > 0 then redis.call('ZREM', KEYS[1], unpack(members)) end "
+        "return members";
+
+      const redisclient::RedisValue& result = [&]{
+        std::lock_guard<std::mutex> lg(mtx_);
+        return redis_->get()->command("EVAL", {script, "1", index, std::to_string(max_score), std::to_string(count)});
+      }();
+
+      if(result.isOk() && result.isArray())
+      {
+        const std::vector<redisclient::RedisValue>& values = result.toArray();
+        for (auto it = values.begin(); it != values.end(); ++it){
+          members.push_back(it->toString());
+        }
+      }
+    }
+
+
+    long long RedisCacheDriver::TakeToken(const std::string& key, const long long& interval, const long long& burst){
+      const long long now = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+      const long long tolerance = interval * (burst > 1 ? burst - 1 : 0);
+
+      // generic cell rate algorithm, the key holds the time the bucket will be full.
+      static const std::string script =
+        "local now = tonumber(ARGV[1]) "
+        "local full = tonumber(redis.call('GET', KEYS[1]) or '0') "
+        "if full < now then full = now end "
+        "if full - now > tonumber(ARGV[3]) then return full - tonumber(ARGV[3]) - now end "
+        "full = full + tonumber(ARGV[2]) "
+        "redis.call('SET', KEYS[1], full, 'PX', math.max(full - now, 1)) "
+        "return 0";
+
+      const redisclient::RedisValue& result = [&]{
+        std::lock_guard<std::mutex> lg(mtx_);
+        return redis_->get()->command("EVAL", {script, "1", key, std::to_string(now), std::to_string(interval), std::to_string(tolerance)});
+      }();
+
+      if(result.isOk() && result.isInt())
+      {
+        return result.toInt();
+      }
+      return 0;
+    }
+
+
     redisclient::RedisValue RedisCacheDriver::Scan(const std::string& cursor, const std::string& expression_){
       std::lock_guard<std::mutex> lg(mtx_);
       return redis_->get()->command("SCAN", {cursor, "MATCH", expression_});
@@ -307,5 +488,61 @@ namespace granada{
       return redis_->get()->command("KEYS", {expression_});
     }
 
+
+    unsigned long long RedisCacheDriver::Subscribe(const std::string& pattern, granada::cache::function_void_cache_event callback){
+      RedisCacheDriver::subscribe_call_once_.call([this](){
+        this->SubscribeKeyEvents();
+      });
+      return RedisCacheDriver::subscriptions_.Add(pattern, std::move(callback));
+    }
+
+
+    void RedisCacheDriver::Unsubscribe(const unsigned long long& subscription_id){
+      RedisCacheDriver::subscriptions_.Remove(subscription_id);
+    }
+
+
+    void RedisCacheDriver::SubscribeKeyEvents(){
+      // enable keyspace notifications in the redis server.
+      std::string notify_keyspace_events = granada::util::application::GetProperty(entity_keys::redis_cache_driver_notify_keyspace_events);
+      if (notify_keyspace_events.empty()){
+        notify_keyspace_events = default_strings::redis_cache_notify_keyspace_events;
+      }
+      {
+        std::lock_guard<std::mutex> lg(mtx_);
+        redis_->get()->command("CONFIG", {"SET", "notify-keyspace-events", notify_keyspace_events});
+      }
+
+      // events published by redis and the corresponding changes,
+      // the message of a keyevent channel is the affected key.
+      //    event       type      field
+      const std::vector<std::tuple<std::string,CacheEvent::Type,std::string>> events = {
+        std::make_tuple("set",          CacheEvent::Type::WRITE,    ""),
+        std::make_tuple("hset",         CacheEvent::Type::WRITE,    "*"),
+        std::make_tuple("rename_to",    CacheEvent::Type::WRITE,    ""),
+        std::make_tuple("del",          CacheEvent::Type::DESTROY,  ""),
+        std::make_tuple("hdel",         CacheEvent::Type::DESTROY,  "*"),
+        std::make_tuple("rename_from",  CacheEvent::Type::DESTROY,  ""),
+        std::make_tuple("expired",      CacheEvent::Type::DESTROY,  "")
+      };
+
+      std::vector<std::pair<std::string,std::function<void(const std::vector<char>&)>>> channels;
+      for (auto it = events.begin(); it != events.end(); ++it){
+        const CacheEvent::Type type = std::get<1>(*it);
+        const std::string field = std::get<2>(*it);
+        channels.push_back(std::make_pair(default_strings::redis_cache_keyevent_channel + std::get<0>(*it), [type,field](const std::vector<char>& message){
+          if (!RedisCacheDriver::subscriptions_.empty()){
+            granada::cache::CacheEvent event;
+            event.type = type;
+            event.key.assign(message.begin(), message.end());
+            event.field = field;
+            RedisCacheDriver::subscriptions_.Notify(event);
+          }
+        }));
+      }
+
+      RedisCacheDriver::subscriber_.reset(new RedisAsyncClientWrapper(RedisSyncClientWrapper::address(), RedisSyncClientWrapper::port(), channels));
+    }
+
   }
 }
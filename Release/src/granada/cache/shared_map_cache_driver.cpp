@@ -62,6 +62,17 @@ namespace granada{
 
     SharedMapCacheDriver::SharedMapCacheDriver(){
       data_.reset(new std::unordered_map<std::string,std::map<std::string,std::string>>());
+      dispatching_ = true;
+    }
+
+
+    SharedMapCacheDriver::~SharedMapCacheDriver(){
+      // stop the dispatcher thread if it has been started.
+      dispatching_ = false;
+      dispatcher_cv_.notify_all();
+      if (dispatcher_.joinable()){
+        dispatcher_.join();
+      }
     }
 
 
@@ -116,6 +127,17 @@ namespace granada{
     }
 
 
+    const bool SharedMapCacheDriver::ReadAll(const std::string& hash, std::unordered_map<std::string,std::string>& values){
+      values.clear();
+      std::lock_guard<std::mutex> lg(mtx_);
+      auto it = data_->find(hash);
+      if (it != data_->end()){
+        values.insert(it->second.begin(), it->second.end());
+      }
+      return true;
+    }
+
+
     void SharedMapCacheDriver::Write(const std::string& key,const std::string& value){
       std::lock_guard<std::mutex> lg(mtx_);
       auto it = data_->find(key);
@@ -128,6 +150,7 @@ namespace granada{
         properties["__"] = value;
         (*data_)[key] = properties;
       }
+      Publish(CacheEvent::Type::WRITE, key, std::string());
     }
 
 
@@ -143,6 +166,7 @@ namespace granada{
         properties[key] = value;
         (*data_)[hash] = properties;
       }
+      Publish(CacheEvent::Type::WRITE, hash, key);
     }
     
 
@@ -153,11 +177,15 @@ namespace granada{
         Match(key,keys);
         for (auto it = keys.begin(); it != keys.end(); ++it){
           std::lock_guard<std::mutex> lg(mtx_);
-          data_->erase(*it);
+          if (data_->erase(*it) > 0){
+            Publish(CacheEvent::Type::DESTROY, *it, std::string());
+          }
         }
       }else{
         std::lock_guard<std::mutex> lg(mtx_);
-        data_->erase(key);
+        if (data_->erase(key) > 0){
+          Publish(CacheEvent::Type::DESTROY, key, std::string());
+        }
       }
     }
 
@@ -169,6 +197,7 @@ namespace granada{
         std::map<std::string,std::string> properties = it->second;
         properties.erase(key);
         (*data_)[hash] = properties;
+        Publish(CacheEvent::Type::DESTROY, hash, key);
       }
     }
 
@@ -186,12 +215,147 @@ namespace granada{
 
         // erase old entry
         data_->erase(it);
+
+        Publish(CacheEvent::Type::DESTROY, old_key, std::string());
+        Publish(CacheEvent::Type::WRITE, new_key, std::string());
         return true;
       }
       return false;
     }
 
 
+    bool SharedMapCacheDriver::Commit(const granada::cache::CacheBatch& batch, std::vector<long long>& replies){
+      const std::vector<granada::cache::CacheBatch::Operation>& operations = batch.operations();
+      replies.clear();
+      std::lock_guard<std::mutex> lg(mtx_);
+      for (auto it = operations.begin(); it != operations.end(); ++it){
+        long long reply = 1;
+        switch (it->type){
+          case granada::cache::CacheBatch::Operation::Type::WRITE:
+            if (it->hash.empty()){
+              (*data_)[it->key]["__"] = it->value;
+              Publish(CacheEvent::Type::WRITE, it->key, std::string());
+            }else{
+              (*data_)[it->hash][it->key] = it->value;
+              Publish(CacheEvent::Type::WRITE, it->hash, it->key);
+            }
+            break;
+          case granada::cache::CacheBatch::Operation::Type::DESTROY:
+            if (it->hash.empty()){
+              reply = (long long)data_->erase(it->key);
+              if (reply > 0){
+                Publish(CacheEvent::Type::DESTROY, it->key, std::string());
+              }
+            }else{
+              reply = 0;
+              auto it2 = data_->find(it->hash);
+              if (it2 != data_->end()){
+                reply = (long long)it2->second.erase(it->key);
+                Publish(CacheEvent::Type::DESTROY, it->hash, it->key);
+              }
+            }
+            break;
+          case granada::cache::CacheBatch::Operation::Type::RENAME:
+            {
+              reply = 0;
+              auto it2 = data_->find(it->key);
+              if (it2 != data_->end() && data_->find(it->value) == data_->end()){
+                reply = 1;
+                std::map<std::string,std::string> properties;
+                std::swap(properties, it2->second);
+                data_->erase(it2);
+                (*data_)[it->value] = std::move(properties);
+                Publish(CacheEvent::Type::DESTROY, it->key, std::string());
+                Publish(CacheEvent::Type::WRITE, it->value, std::string());
+              }
+            }
+            break;
+          case granada::cache::CacheBatch::Operation::Type::UPDATE:
+            {
+              reply = 0;
+              auto it2 = data_->find(it->hash);
+              if (it2 != data_->end()){
+                reply = 1;
+                it2->second[it->key] = it->value;
+                Publish(CacheEvent::Type::WRITE, it->hash, it->key);
+              }
+            }
+            break;
+          case granada::cache::CacheBatch::Operation::Type::INDEX:
+            IndexUnlocked(it->hash, it->key, std::stoll(it->value));
+            break;
+          case granada::cache::CacheBatch::Operation::Type::UNINDEX:
+            UnindexUnlocked(it->hash, it->key);
+            break;
+        }
+        replies.push_back(reply);
+      }
+      return true;
+    }
+
+
+    void SharedMapCacheDriver::Index(const std::string& index, const std::string& member, const long long& score){
+      std::lock_guard<std::mutex> lg(mtx_);
+      IndexUnlocked(index, member, score);
+    }
+
+
+    void SharedMapCacheDriver::Unindex(const std::string& index, const std::string& member){
+      std::lock_guard<std::mutex> lg(mtx_);
+      UnindexUnlocked(index, member);
+    }
+
+
+    void SharedMapCacheDriver::PopIndex(const std::string& index, const long long& max_score, const std::size_t& count, std::vector<std::string>& members){
+      members.clear();
+      std::lock_guard<std::mutex> lg(mtx_);
+      auto it = indexes_.find(index);
+      if (it != indexes_.end()){
+        OrderedIndex& ordered_index = it->second;
+        auto it2 = ordered_index.by_score.begin();
+        while (it2 != ordered_index.by_score.end() && it2->first <= max_score && members.size() < count){
+          members.push_back(it2->second);
+          ordered_index.by_member.erase(it2->second);
+          it2 = ordered_index.by_score.erase(it2);
+        }
+        if (ordered_index.by_score.empty()){
+          indexes_.erase(it);
+        }
+      }
+    }
+
+
+    void SharedMapCacheDriver::IndexUnlocked(const std::string& index, const std::string& member, const long long& score){
+      OrderedIndex& ordered_index = indexes_[index];
+      auto it = ordered_index.by_member.find(member);
+      if (it != ordered_index.by_member.end()){
+        if (it->second->first == score){
+          return;
+        }
+        ordered_index.by_score.erase(it->second);
+        it->second = ordered_index.by_score.insert(std::make_pair(score, member));
+      }else{
+        ordered_index.by_member[member] = ordered_index.by_score.insert(std::make_pair(score, member));
+      }
+    }
+
+
+    void SharedMapCacheDriver::UnindexUnlocked(const std::string& index, const std::string& member){
+      auto it = indexes_.find(index);
+      if (it != indexes_.end()){
+        OrderedIndex& ordered_index = it->second;
+        auto it2 = ordered_index.by_member.find(member);
+        if (it2 != ordered_index.by_member.end()){
+          ordered_index.by_score.erase(it2->second);
+          ordered_index.by_member.erase(it2);
+        }
+        if (ordered_index.by_score.empty()){
+          indexes_.erase(it);
+        }
+      }
+    }
+
+
     void SharedMapCacheDriver::Keys(const std::string& expression, std::vector<std::string>& keys){
       keys.clear();
       std::lock_guard<std::mutex> lg(mtx_);
@@ -203,5 +367,53 @@ namespace granada{
       }
     }
 
+
+    unsigned long long SharedMapCacheDriver::Subscribe(const std::string& pattern, granada::cache::function_void_cache_event callback){
+      const unsigned long long id = subscriptions_.Add(pattern, std::move(callback));
+
+      // start the thread that delivers the changes to the subscribers.
+      std::call_once(dispatcher_once_, [this]{
+        dispatcher_ = std::thread(&SharedMapCacheDriver::Dispatch, this);
+      });
+      return id;
+    }
+
+
+    void SharedMapCacheDriver::Unsubscribe(const unsigned long long& subscription_id){
+      subscriptions_.Remove(subscription_id);
+    }
+
+
+    void SharedMapCacheDriver::Publish(const granada::cache::CacheEvent::Type type, const std::string& key, const std::string& field){
+      if (!subscriptions_.empty()){
+        granada::cache::CacheEvent event;
+        event.type = type;
+        event.key = key;
+        event.field = field;
+        events_.push(std::move(event));
+        dispatcher_cv_.notify_one();
+      }
+    }
+
+
+    void SharedMapCacheDriver::Dispatch(){
+      std::deque<granada::cache::CacheEvent> events;
+      while (dispatching_){
+        {
+          // the timeout covers a notification sent between the check
+          // of the predicate and the wait, producers do not take the lock.
+          std::unique_lock<std::mutex> ul(dispatcher_mtx_);
+          dispatcher_cv_.wait_for(ul, std::chrono::milliseconds(100), [this]{
+            return !events_.empty() || !dispatching_;
+          });
+        }
+        events_.pop_all(events);
+        while (!events.empty()){
+          subscriptions_.Notify(events.front());
+          events.pop_front();
+        }
+      }
+    }
+
   }
 }
@@ -26,23 +26,63 @@
   */
 
 #include "granada/cache/web_resource_cache.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <iomanip>
+#include <iostream>
+#ifdef __linux__
+  #include <poll.h>
+  #include <unistd.h>
+  #include <sys/inotify.h>
+#endif
 
 namespace granada{
 
   namespace cache{
 
-    WebResourceCache::WebResourceCache(){
+    WebResourceCache::WebResourceCache() : lazy_frequency_(64 * 1024, 4){
+      files_.reset(new FileMap());
+      watching_ = false;
+      lazy_misses_ = 0;
       Start();
     }
 
-    granada::cache::Resource WebResourceCache::GetFile(std::string& file_path){
-      if ( !files_.empty() ){
-        auto it = files_.find(file_path);
-        if (it == files_.end()){
-          return granada::cache::Resource();
+
+    WebResourceCache::~WebResourceCache(){
+      if (watcher_.joinable()){
+        watching_ = false;
+        watcher_.join();
+      }
+      #ifdef __linux__
+        if (watch_fd_ != -1){
+          close(watch_fd_);
+        }
+      #endif
+    }
+
+
+    std::shared_ptr<const granada::cache::Resource> WebResourceCache::GetFile(std::string& file_path){
+      return GetFile(file_path, std::string());
+    }
+
+
+    std::shared_ptr<const granada::cache::Resource> WebResourceCache::GetFile(std::string& file_path, const std::string& accept_encoding){
+      std::shared_ptr<FileMap> files = std::atomic_load(&files_);
+      if ( !files->empty() ){
+        auto it = files->find(file_path);
+        if (it == files->end()){
+          return nullptr;
+        }
+        return it->second;
+      }
+
+      const std::string requested_path = file_path;
+      if (lazy_){
+        std::shared_ptr<const granada::cache::Resource> resource = LazyGet(requested_path);
+        if (resource){
+          return resource;
         }
-        granada::cache::Resource resource = it->second;
-        return resource;
       }
 
       // file is not cached so we get the content from the file stored in the hard drive.
@@ -62,11 +102,7 @@ namespace granada{
 			default_file_path = utility::conversions::to_utf8string(it->as_string());
             extension = granada::util::file::GetExtension(default_file_path);
 
-            if (GetExtensionContentEncoding(extension) == "gzip"){
-              default_file_path = root_path_ + "/" + file_path + utility::conversions::to_utf8string(it->as_string()) + ".gz";
-            }else{
-				default_file_path = root_path_ + "/" + file_path + utility::conversions::to_utf8string(it->as_string());
-            }
+            default_file_path = root_path_ + "/" + file_path + utility::conversions::to_utf8string(it->as_string());
 
             // if file exists, then take it as the one to get content from.
             if (boost::filesystem::exists(default_file_path)){
@@ -82,10 +118,10 @@ namespace granada{
               const web::json::value &error_404_file_path_json = error_paths_.at(U("404"));
 			  std::string error_404_file_path = utility::conversions::to_utf8string(error_404_file_path_json.as_string());
               if (file_path == error_404_file_path || file_path == error_404_file_path + "/"){
-                return granada::cache::Resource();
+                return nullptr;
               }
             }catch(const web::json::json_exception e){
-              return granada::cache::Resource();
+              return nullptr;
             }
           }else{
             if (default_file_path.empty()){
@@ -94,11 +130,7 @@ namespace granada{
           }
         }
       }else{
-        if (GetExtensionContentEncoding(extension) == "gzip"){
-          file_path = root_path_ + "/" + file_path + ".gz";
-        }else{
-          file_path = root_path_ + "/" + file_path;
-        }
+        file_path = root_path_ + "/" + file_path;
       }
 
       if (file_path.empty() || !boost::filesystem::exists(file_path)){
@@ -111,28 +143,53 @@ namespace granada{
           }catch(const web::json::json_exception e){}
         }
       }else{
-        // read the file and assign content to content string variable
-        boost::filesystem::path path(file_path);
-        std::ifstream ifs(path.string());
-        std::vector<unsigned char> content( (std::istreambuf_iterator<char>(ifs) ),
-                           (std::istreambuf_iterator<char>()) );
-
         std::string content_type = GetExtensionContentType(extension);
 
-        std::string content_encoding = "";
-        if (GetExtensionContentEncoding(extension) == "gzip"){
-          content_encoding = "gzip";
-        }
+        std::shared_ptr<granada::cache::Resource> resource(new granada::cache::Resource());
+        resource->content_type = content_type;
 
-        granada::cache::Resource resource;
-        resource.content_type = content_type;
-        resource.content_encoding = content_encoding;
-        resource.content = content;
+        boost::filesystem::path path(file_path);
+        resource->last_modified_time = boost::filesystem::last_write_time(path);
+        resource->last_modified = FormatLastModified(resource->last_modified_time);
+        // the file is cached if it is requested frequently,
+        // with all its compressed variants.
+        const bool admitted = lazy_ && LazyAdmit(requested_path);
+        if (boost::filesystem::file_size(path) >= stream_file_size_){
+          // large file, content will be streamed from the file.
+          resource->file_path = path.string();
+        }else{
+          // read the file and assign content to content string variable
+          std::ifstream ifs(path.string(), std::ios::binary);
+          resource->content.assign((std::istreambuf_iterator<char>(ifs)),(std::istreambuf_iterator<char>()));
 
+          if (admitted){
+            if (!resource->content.empty() && GetExtensionContentEncoding(extension) == "gzip"){
+              Compress(*resource, true, true, Z_DEFAULT_COMPRESSION, 5);
+            }
+          }else if (GetExtensionContentEncoding(extension) == "gzip"){
+            // compress only with the encoding the client prefers, with a fast
+            // compression level as it is done for every request.
+            if (granada::util::compression::brotli_available() && granada::util::compression::accepts(accept_encoding, "br")){
+              Compress(*resource, false, true, Z_DEFAULT_COMPRESSION, 5);
+            }else if (granada::util::compression::accepts(accept_encoding, "gzip")){
+              Compress(*resource, true, false, Z_DEFAULT_COMPRESSION, 5);
+            }
+          }
+        }
+
+        PrecomputeHeaders(*resource);
+        if (admitted){
+          LazyInsert(requested_path, resource);
+        }
         return resource;
       }
 
-      return granada::cache::Resource();
+      return nullptr;
+    }
+
+
+    const WebResourceCache::LoadStats& WebResourceCache::GetLoadStats(){
+      return load_stats_;
     }
 
 
@@ -145,7 +202,16 @@ namespace granada{
     }
 
     void WebResourceCache::CacheRecord(const std::string& resource_path, const granada::cache::Resource& resource){
-      files_.insert(std::make_pair(resource_path,resource));
+      std::shared_ptr<granada::cache::Resource> record(new granada::cache::Resource(resource));
+      PrecomputeHeaders(*record);
+      if (lazy_){
+        LazyInsert(resource_path, record);
+        return;
+      }
+      std::lock_guard<std::mutex> lock(files_mutex_);
+      std::shared_ptr<FileMap> files(new FileMap(*std::atomic_load(&files_)));
+      files->insert(std::make_pair(resource_path,record));
+      std::atomic_store(&files_, files);
     }
 
 
@@ -158,16 +224,25 @@ namespace granada{
       ////
       // gzip content encoding
       // get property that will tell if gzip content or not (on:gzip;off:do not zip).
-      // if gzip true then create a Gziped copy of the files.
+      // if gzip true then the cached files are compressed once loaded.
       std::string gzip_content_str = granada::util::application::GetProperty("gzip_content");
       if(!gzip_content_str.empty() && gzip_content_str=="on"){
         gzip_content_ = true;
-        GzipCopy();
       }
 
-      // get percentage of the files we want to cache (0:none;100:all).
+      // get the size in MB from which files are streamed from the hard drive
+      // instead of being loaded in memory.
+      std::string stream_file_size_str = granada::util::application::GetProperty("stream_file_size");
+      if (!stream_file_size_str.empty()){
+        try{
+          stream_file_size_ = std::stoull(stream_file_size_str) * 1024 * 1024;
+        }catch(const std::exception e){}
+      }
+
+      // get if we want to cache the files (on:load all files when starting;
+      // lazy:load the files when they are requested;off:do not cache).
       std::string cache_content = granada::util::application::GetProperty("cache_content");
-      if (!cache_content.empty() && cache_content == "on"){
+      if (cache_content == "on" || cache_content == "lazy"){
         // get the maximum cache memory property that is
         // the maximum amount of MB that we will load in the cache.
         std::string maximum_cache_memory_str = granada::util::application::GetProperty("maximum_cache_memory");
@@ -180,8 +255,57 @@ namespace granada{
           }catch(const std::exception e){}
         }
 
-        // load all files in memory.
-        RecursiveLoad("/",maximum_cache_memory);
+        // watch the root path to reload the files that change (on:reload;off:do not watch).
+        // the watches are added before loading so no change is missed.
+        std::string cache_watch = granada::util::application::GetProperty("cache_watch");
+        #ifdef __linux__
+          if (!cache_watch.empty() && cache_watch == "on"){
+            watch_fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+            if (watch_fd_ != -1){
+              AddWatch("/");
+            }
+          }
+        #endif
+
+        if (cache_content == "lazy"){
+          // files are loaded when they are requested, get the number of requests
+          // after which a file is cached.
+          lazy_ = true;
+          if (maximum_cache_memory > 0){
+            lazy_maximum_memory_ = maximum_cache_memory;
+          }else{
+            std::cout << "maximum_cache_memory is not set, lazily loaded web resources use " << lazy_maximum_memory_ / (1024 * 1024) << " MB." << std::endl;
+          }
+          std::string admission_hits_str = granada::util::application::GetProperty("cache_admission_hits");
+          if (!admission_hits_str.empty()){
+            try{
+              admission_hits_ = std::stoi(admission_hits_str);
+            }catch(const std::exception e){}
+          }
+        }else{
+          // load all files in memory.
+          std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+          std::shared_ptr<FileMap> files(new FileMap());
+          std::vector<LoadedResource> loaded;
+          maximum_cache_memory_ = maximum_cache_memory;
+          RecursiveLoad("/",maximum_cache_memory,*files,loaded);
+          PrepareResources(loaded);
+
+          cache_memory_ = maximum_cache_memory;
+          std::atomic_store(&files_, files);
+
+          load_stats_.files = loaded.size();
+          for (auto it = loaded.begin(); it != loaded.end(); ++it){
+            load_stats_.bytes += it->resource->content.size();
+          }
+          load_stats_.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+          std::cout << "Web resources loaded: " << load_stats_.files << " files, " << load_stats_.bytes << " bytes in memory, in " << load_stats_.seconds << " s." << std::endl;
+        }
+
+        if (watch_fd_ != -1){
+          watching_ = true;
+          watcher_ = std::thread(&WebResourceCache::Watch, this);
+        }
       }
     }
 
@@ -275,156 +399,472 @@ namespace granada{
     }
 
 
-    void WebResourceCache::GzipCopy(){
-      // make a copy of the files into another directory and gzip it.
-      std::string not_gziped_filepath(root_path_);
-      root_path_ += "_gzip";
-      std::string command;
+    void WebResourceCache::PrepareResources(std::vector<LoadedResource>& loaded){
+      // prepare the files in parallel, each thread takes the next
+      // file to prepare until there are no more files.
+      std::size_t threads_number = std::thread::hardware_concurrency();
+      if (threads_number == 0){
+        threads_number = 1;
+      }
+      if (threads_number > loaded.size()){
+        threads_number = loaded.size();
+      }
+      std::atomic<std::size_t> next(0);
+      std::vector<std::thread> threads;
+      for (std::size_t i = 0; i < threads_number; ++i){
+        threads.push_back(std::thread([this, &loaded, &next]{
+          std::size_t index;
+          while ((index = next++) < loaded.size()){
+            granada::cache::Resource& resource = *loaded[index].resource;
+            if (!loaded[index].read_path.empty()){
+              granada::util::file::ReadContent(loaded[index].read_path, loaded[index].size, resource.content);
+            }
+            if (loaded[index].compress){
+              Compress(resource, true, true, 9, 11);
+            }
+            PrecomputeHeaders(resource);
+          }
+        }));
+      }
+      for (auto it = threads.begin(); it != threads.end(); ++it){
+        it->join();
+      }
+    }
 
-      // gzip files in another directory.
-      #ifdef WINDOWS
-        if ( boost::filesystem::exists( root_path_ ) ){
-          command = "deltree " + root_path_;
-          system(command.c_str());
-        }
-        command = "xcopy " + not_gziped_filepath + " " + root_path_;
-        system(command.c_str());
 
-        // gzip only the files with extension indicated in the gzip_extensions property.
-        std::string extensions;
+    void WebResourceCache::PrecomputeHeaders(granada::cache::Resource& resource){
+      if (resource.ETag.empty()){
+        resource.ETag = GenerateETag(resource);
+      }
 
-        for(auto it = gzip_extensions_.as_array().cbegin(); it != gzip_extensions_.as_array().cend(); ++it){
-          if (!extensions.empty()){
-            extensions += "|";
-          }
-          extensions += "*." + it->as_string();
-        }
+      web::http::http_headers headers;
+      headers.add(web::http::header_names::etag, utility::conversions::to_string_t(resource.ETag));
+      headers.add(web::http::header_names::server, U("granada"));
+      headers.add(web::http::header_names::connection, U("keep-alive"));
+      headers.add(web::http::header_names::last_modified, utility::conversions::to_string_t(resource.last_modified));
+      headers.add(web::http::header_names::accept_ranges, U("bytes"));
+      headers.add(web::http::header_names::content_type, utility::conversions::to_string_t(resource.content_type));
+      if (!resource.gzip_content.empty() || !resource.brotli_content.empty()){
+        headers.add(web::http::header_names::vary, U("Accept-Encoding"));
+      }
+      resource.headers = headers;
+
+      // each variant is a different representation with its own strong ETag.
+      const std::string etag_prefix = resource.ETag.substr(0, resource.ETag.length() - 1);
+      if (!resource.gzip_content.empty()){
+        resource.gzip_headers = headers;
+        resource.gzip_headers[web::http::header_names::etag] = utility::conversions::to_string_t(etag_prefix + "-gzip\"");
+        resource.gzip_headers.add(web::http::header_names::content_encoding, U("gzip"));
+      }
+      if (!resource.brotli_content.empty()){
+        resource.brotli_headers = headers;
+        resource.brotli_headers[web::http::header_names::etag] = utility::conversions::to_string_t(etag_prefix + "-br\"");
+        resource.brotli_headers.add(web::http::header_names::content_encoding, U("br"));
+      }
+    }
 
-        // not tested
-        command = "For /R " + root_path_ + " %%G IN (" + extensions + ") do gzip \"%%G\"";
-        system(command.c_str());
-      #else
-        // remove gzip directory if it already exists.
-        if ( boost::filesystem::exists( root_path_ ) ){
-          std::string command = "rm -r " + root_path_;
-          system(command.c_str());
-        }
-        // copy all the directory into a gzip directory.
-        command = "cp -r " + not_gziped_filepath + " " + root_path_;
-        system(command.c_str());
 
-        // gzip only the files with extension indicated in the gzip_extensions property.
-        std::string extensions;
-        for(auto it = gzip_extensions_.as_array().cbegin(); it != gzip_extensions_.as_array().cend(); ++it){
-          if (!extensions.empty()){
-            extensions += "|";
-          }
-		  extensions += "\\." + utility::conversions::to_utf8string(it->as_string()) + "$";
+    void WebResourceCache::Compress(granada::cache::Resource& resource, bool gzip, bool brotli, int gzip_level, int brotli_quality){
+      if (gzip){
+        if (!granada::util::compression::gzip(resource.content, resource.gzip_content, gzip_level) || resource.gzip_content.size() >= resource.content.size()){
+          std::vector<unsigned char>().swap(resource.gzip_content);
         }
-
-        // gzip
-        if (!extensions.empty()){
-          command = "for i in `find " + root_path_ + " | grep -E \"" + extensions +"\"`; do gzip -9 \"$i\" ; done";
-          system(command.c_str());
+      }
+      if (brotli){
+        if (!granada::util::compression::brotli(resource.content, resource.brotli_content, brotli_quality) || resource.brotli_content.size() >= resource.content.size()){
+          std::vector<unsigned char>().swap(resource.brotli_content);
         }
-      #endif
+      }
     }
 
-    bool WebResourceCache::RecursiveLoad(const std::string &relative_path,int& maximum_cache_memory){
 
-      std::string application_and_relative_path = root_path_ + relative_path;
+    bool WebResourceCache::RecursiveLoad(const std::string &relative_path,int& maximum_cache_memory,FileMap& files,std::vector<LoadedResource>& loaded){
+
+      // list the files of the tree in parallel, then sort them so the
+      // same files are loaded in memory each time the cache starts.
+      std::vector<FileEntry> entries;
+      ListFiles(relative_path, entries);
+      std::sort(entries.begin(), entries.end(), [](const FileEntry& a, const FileEntry& b){
+        return a.relative_path == b.relative_path ? a.filename < b.filename : a.relative_path < b.relative_path;
+      });
 
-      if ( boost::filesystem::exists(application_and_relative_path) ){
+      loaded.reserve(loaded.size() + entries.size());
+      for (auto it = entries.begin(); it != entries.end(); ++it){
+        loaded.push_back(LoadResource(*it, maximum_cache_memory));
+        RecordResource(files, it->relative_path, it->filename, loaded.back().resource);
+      }
 
-        boost::filesystem::directory_iterator end_it;
-        boost::filesystem::path path;
-        std::string filename;
-        std::string extension;
-        std::string content_encoding;
+      if (files.empty()){
+        return false;
+      }
 
-        for ( boost::filesystem::directory_iterator it(application_and_relative_path); it != end_it; ++it ){
-          content_encoding = "";
-          path = it->path();
-          filename = path.filename().string();
-          if ( boost::filesystem::is_directory(it->status()) ){
-            // file is a directory, content cached must be from a file so call recursive load again
-            // to cache the files from the directory.
-            RecursiveLoad(relative_path + filename + "/", maximum_cache_memory);
-          }else{
-            // cache the file.
-            // but only if its inside the cache memory usage limits
-            int file_size = boost::filesystem::file_size(path);
-            maximum_cache_memory -= file_size;
-
-            if (maximum_cache_memory > 0){
-              if (gzip_content_){
-                // remove the .gz extension from the file name if file is compressed.
-                // The resultant name will be the identifier of the file
-                // client is going to request example.html not example.html.gz.
-                int filename_length = filename.length();
-                if (filename_length > 3){
-                  std::string extension = filename.substr(filename_length-3,filename_length);
-                  if (extension == ".gz"){
-                    std::string filename_copy(filename);
-                    filename_copy = filename_copy.substr(0,filename_copy.length()-3);
-                    filename.assign(filename_copy);
-                    content_encoding = "gzip";
+      return true;
+    }
+
+
+    void WebResourceCache::ListFiles(const std::string& relative_path, std::vector<FileEntry>& entries){
+      // each thread takes a directory to list, the subdirectories found
+      // are listed by the next available thread, until all threads
+      // are waiting and there are no directories left.
+      std::mutex mutex;
+      std::condition_variable condition;
+      std::vector<std::string> directories(1, relative_path);
+      std::size_t busy = 0;
+
+      std::size_t threads_number = std::thread::hardware_concurrency();
+      if (threads_number == 0){
+        threads_number = 1;
+      }
+      std::vector<std::thread> threads;
+      for (std::size_t i = 0; i < threads_number; ++i){
+        threads.push_back(std::thread([this, &mutex, &condition, &directories, &busy, &entries]{
+          while (true){
+            std::string directory;
+            {
+              std::unique_lock<std::mutex> lock(mutex);
+              condition.wait(lock, [&directories, &busy]{ return !directories.empty() || busy == 0; });
+              if (directories.empty()){
+                break;
+              }
+              directory = directories.back();
+              directories.pop_back();
+              ++busy;
+            }
+
+            std::vector<std::string> subdirectories;
+            std::vector<FileEntry> files;
+            try{
+              boost::filesystem::directory_iterator end_it;
+              for (boost::filesystem::directory_iterator it(root_path_ + directory); it != end_it; ++it){
+                const std::string filename = it->path().filename().string();
+                if (boost::filesystem::is_directory(it->status())){
+                  subdirectories.push_back(directory + filename + "/");
+                }else{
+                  try{
+                    FileEntry entry;
+                    entry.relative_path = directory;
+                    entry.filename = filename;
+                    entry.path = it->path();
+                    entry.size = boost::filesystem::file_size(entry.path);
+                    entry.last_modified_time = boost::filesystem::last_write_time(entry.path);
+                    files.push_back(entry);
+                  }catch(const boost::filesystem::filesystem_error e){
+                    // file removed while listing or broken link.
                   }
                 }
               }
+            }catch(const boost::filesystem::filesystem_error e){
+              // directory removed while listing or not readable.
+            }
 
-              extension = granada::util::file::GetExtension(filename);
+            {
+              std::lock_guard<std::mutex> lock(mutex);
+              directories.insert(directories.end(), subdirectories.begin(), subdirectories.end());
+              entries.insert(entries.end(), files.begin(), files.end());
+              --busy;
+            }
+            condition.notify_all();
+          }
+        }));
+      }
+      for (auto it = threads.begin(); it != threads.end(); ++it){
+        it->join();
+      }
+    }
 
-              // create a resource
-              granada::cache::Resource resource;
 
-              resource.content_type = GetExtensionContentType(extension);
+    WebResourceCache::LoadedResource WebResourceCache::LoadResource(const FileEntry& entry, int& maximum_cache_memory){
+      // only load its content if it is not too large and it is
+      // inside the cache memory usage limits, if not it will be streamed.
+      bool stream = entry.size >= stream_file_size_ || maximum_cache_memory <= 0 || entry.size >= (std::uintmax_t)maximum_cache_memory;
+      if (!stream){
+        maximum_cache_memory -= entry.size;
+      }
 
-              resource.content_encoding = content_encoding;
+      std::string extension = granada::util::file::GetExtension(entry.filename);
 
-              // get the content from the file in form of a vector of unsigned chars.
-              std::ifstream ifs(path.string());
-              std::vector<unsigned char> content((std::istreambuf_iterator<char>(ifs)),(std::istreambuf_iterator<char>()));
-              resource.content = content;
+      // create a resource, its content is read when it is prepared.
+      LoadedResource loaded;
+      loaded.resource.reset(new granada::cache::Resource());
+      loaded.resource->content_type = GetExtensionContentType(extension);
+      loaded.resource->last_modified = FormatLastModified(entry.last_modified_time);
+      loaded.resource->last_modified_time = entry.last_modified_time;
+      loaded.size = (std::size_t)entry.size;
+
+      if (stream){
+        loaded.resource->file_path = entry.path.string();
+        loaded.compress = false;
+      }else{
+        loaded.read_path = entry.path.string();
+        loaded.compress = gzip_content_ && entry.size > 0 && GetExtensionContentEncoding(extension) == "gzip";
+      }
+
+      return loaded;
+    }
 
-              std::time_t modification_date = boost::filesystem::last_write_time(path);
-              resource.last_modified = FormatLastModified(modification_date);
 
-              resource.ETag = GenerateETag(relative_path + filename, resource.last_modified);
+    void WebResourceCache::RecordResource(FileMap& files, const std::string& relative_path, const std::string& filename, const std::shared_ptr<const granada::cache::Resource>& resource){
+      // check if file is a default kind of file, if so
+      // we store two additional possible client requests for this file:
+      // these are path/to/file/, path/to/file.
+      for(auto it = default_files_.as_array().cbegin(); it != default_files_.as_array().cend(); ++it){
+        if (filename == utility::conversions::to_utf8string(it->as_string())){
+          // store path/to/file/
+          files.insert(std::make_pair(relative_path,resource));
 
-              // check if file is a default kind of file, if so
-              // we store two additional possible client requests for this file:
-              // these are path/to/file/, path/to/file.
-              for(auto it = default_files_.as_array().cbegin(); it != default_files_.as_array().cend(); ++it){
-				  if (filename == utility::conversions::to_utf8string(it->as_string())){
-                  // store path/to/file/
+          // store path/to/file
+          std::string reduced_relative_path(relative_path);
+          reduced_relative_path.erase(reduced_relative_path.end()-1);
 
-                  CacheRecord(relative_path,resource);
+          files.insert(std::make_pair(reduced_relative_path,resource));
+          break;
+        }
+      }
 
-                  // store path/to/file
-                  std::string reduced_relative_path(relative_path);
-                  reduced_relative_path.erase(reduced_relative_path.end()-1);
+      // store path/to/file/default.file
+      files.insert(std::make_pair(relative_path + filename,resource));
+    }
 
-                  CacheRecord(reduced_relative_path,resource);
-                  break;
+
+    void WebResourceCache::AddWatch(const std::string& relative_path){
+      #ifdef __linux__
+        const std::string path = root_path_ + relative_path;
+        int wd = inotify_add_watch(watch_fd_, path.c_str(), IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO);
+        if (wd != -1){
+          watches_[wd] = relative_path;
+        }
+        try{
+          boost::filesystem::directory_iterator end_it;
+          for ( boost::filesystem::directory_iterator it(path); it != end_it; ++it ){
+            if ( boost::filesystem::is_directory(it->status()) ){
+              AddWatch(relative_path + it->path().filename().string() + "/");
+            }
+          }
+        }catch(const boost::filesystem::filesystem_error e){}
+      #endif
+    }
+
+
+    void WebResourceCache::Watch(){
+      #ifdef __linux__
+        char buffer[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+        std::set<std::string> changed;
+        struct pollfd poll_fd;
+        poll_fd.fd = watch_fd_;
+        poll_fd.events = POLLIN;
+        while (watching_){
+          // a deployment changes many files at once, wait until
+          // there are no more changes to reload them together.
+          int ready = poll(&poll_fd, 1, changed.empty() ? 500 : 200);
+          if (ready > 0){
+            ssize_t length;
+            while ((length = read(watch_fd_, buffer, sizeof(buffer))) > 0){
+              const struct inotify_event* event;
+              for (char* ptr = buffer; ptr < buffer + length; ptr += sizeof(struct inotify_event) + event->len){
+                event = (const struct inotify_event*) ptr;
+                if (event->mask & IN_Q_OVERFLOW){
+                  // the kernel queue was full and events have been lost,
+                  // any file may have changed.
+                  changed.insert("/");
+                  continue;
+                }
+                auto it = watches_.find(event->wd);
+                if (it != watches_.end()){
+                  if (event->mask & IN_IGNORED){
+                    // directory has been removed.
+                    watches_.erase(it);
+                  }else if (event->len > 0){
+                    // file created but not written yet, it will be reloaded once closed.
+                    if ((event->mask & IN_CREATE) && !(event->mask & IN_ISDIR)){
+                      continue;
+                    }
+                    changed.insert(it->second + event->name);
+                  }
                 }
               }
+            }
+          }else if (ready == 0 && !changed.empty()){
+            Reload(changed);
+            changed.clear();
+          }
+        }
+      #endif
+    }
 
-              // store path/to/file/default.file
-              CacheRecord(relative_path + filename,resource);
 
-            }else{
-              break;
-            }
+    void WebResourceCache::Reload(const std::set<std::string>& relative_paths){
+      const bool all = relative_paths.find("/") != relative_paths.end();
+      if (all){
+        // directories created while the events were lost are not watched yet.
+        AddWatch("/");
+      }
+
+      if (lazy_ && all){
+        std::lock_guard<std::mutex> lock(lazy_mutex_);
+        lazy_files_.clear();
+        lazy_order_.clear();
+        lazy_memory_ = 0;
+        return;
+      }
+
+      if (lazy_){
+        // changed files are loaded again the next time they are requested.
+        for (auto it = relative_paths.begin(); it != relative_paths.end(); ++it){
+          LazyInvalidate(*it);
+          if (boost::filesystem::is_directory(root_path_ + *it)){
+            AddWatch(*it + "/");
           }
         }
+        return;
       }
 
-      if (files_.empty()){
-        return false;
+      std::lock_guard<std::mutex> lock(files_mutex_);
+
+      if (all){
+        // load all files again in a new map.
+        std::shared_ptr<FileMap> files(new FileMap());
+        std::vector<LoadedResource> loaded;
+        cache_memory_ = maximum_cache_memory_;
+        RecursiveLoad("/", cache_memory_, *files, loaded);
+        PrepareResources(loaded);
+        std::atomic_store(&files_, files);
+        return;
       }
 
-      return true;
+      // copy the current map, requests being served keep the current one.
+      std::shared_ptr<FileMap> files(new FileMap(*std::atomic_load(&files_)));
+
+      for (auto it = relative_paths.begin(); it != relative_paths.end(); ++it){
+        const std::string& relative_path = *it;
+        const std::size_t pos = relative_path.find_last_of('/');
+        const std::string directory = relative_path.substr(0, pos + 1);
+        const std::string filename = relative_path.substr(pos + 1);
+
+        // remove the previous version of the file, with all its paths,
+        // and the files of the directory if it was a directory.
+        std::set<const granada::cache::Resource*> removed;
+        const granada::cache::Resource* previous = nullptr;
+        auto previous_it = files->find(relative_path);
+        if (previous_it != files->end()){
+          previous = previous_it->second.get();
+        }
+        const std::string directory_prefix = relative_path + "/";
+        for (auto it2 = files->begin(); it2 != files->end();){
+          if (it2->second.get() == previous || it2->first.compare(0, directory_prefix.length(), directory_prefix) == 0){
+            removed.insert(it2->second.get());
+            it2 = files->erase(it2);
+          }else{
+            ++it2;
+          }
+        }
+        for (auto it2 = removed.begin(); it2 != removed.end(); ++it2){
+          cache_memory_ += (*it2)->content.size();
+        }
+
+        // load the new version.
+        try{
+          boost::filesystem::path path(root_path_ + relative_path);
+          if (boost::filesystem::is_directory(path)){
+            AddWatch(relative_path + "/");
+            FileMap directory_files;
+            std::vector<LoadedResource> loaded;
+            RecursiveLoad(relative_path + "/", cache_memory_, directory_files, loaded);
+            PrepareResources(loaded);
+            files->insert(directory_files.begin(), directory_files.end());
+          }else if (boost::filesystem::is_regular_file(path)){
+            FileEntry entry;
+            entry.relative_path = directory;
+            entry.filename = filename;
+            entry.path = path;
+            entry.size = boost::filesystem::file_size(path);
+            entry.last_modified_time = boost::filesystem::last_write_time(path);
+            std::vector<LoadedResource> loaded(1, LoadResource(entry, cache_memory_));
+            PrepareResources(loaded);
+            RecordResource(*files, directory, filename, loaded.front().resource);
+          }
+        }catch(const boost::filesystem::filesystem_error e){
+          // file removed while it was being loaded.
+        }
+      }
+
+      std::atomic_store(&files_, files);
+    }
+
+
+    std::shared_ptr<const granada::cache::Resource> WebResourceCache::LazyGet(const std::string& path){
+      std::lock_guard<std::mutex> lock(lazy_mutex_);
+      auto it = lazy_files_.find(path);
+      if (it == lazy_files_.end()){
+        return nullptr;
+      }
+      lazy_order_.splice(lazy_order_.begin(), lazy_order_, it->second.position);
+      return it->second.resource;
+    }
+
+
+    bool WebResourceCache::LazyAdmit(const std::string& path){
+      // forget the requests regularly, before the filter is too full
+      // to tell the frequent files from the others.
+      if (++lazy_misses_ % (64 * 1024 / 8) == 0){
+        lazy_frequency_.clear();
+      }
+      lazy_frequency_.add(path);
+      return lazy_frequency_.count(path) >= admission_hits_;
+    }
+
+
+    void WebResourceCache::LazyInsert(const std::string& path, const std::shared_ptr<const granada::cache::Resource>& resource){
+      const std::size_t size = sizeof(granada::cache::Resource) + path.length() + resource->file_path.length()
+        + resource->content.size() + resource->gzip_content.size() + resource->brotli_content.size();
+      if (size > lazy_maximum_memory_){
+        return;
+      }
+
+      std::lock_guard<std::mutex> lock(lazy_mutex_);
+      auto it = lazy_files_.find(path);
+      if (it != lazy_files_.end()){
+        // loaded by another request at the same time.
+        lazy_memory_ -= it->second.size;
+        lazy_order_.erase(it->second.position);
+        lazy_files_.erase(it);
+      }
+
+      // evict the least recently used files until the new one fits.
+      while (lazy_memory_ + size > lazy_maximum_memory_ && !lazy_order_.empty()){
+        auto evicted = lazy_files_.find(lazy_order_.back());
+        lazy_memory_ -= evicted->second.size;
+        lazy_files_.erase(evicted);
+        lazy_order_.pop_back();
+      }
+
+      lazy_order_.push_front(path);
+      LazyResource& lazy_resource = lazy_files_[path];
+      lazy_resource.resource = resource;
+      lazy_resource.size = size;
+      lazy_resource.position = lazy_order_.begin();
+      lazy_memory_ += size;
+    }
+
+
+    void WebResourceCache::LazyInvalidate(const std::string& relative_path){
+      const std::size_t pos = relative_path.find_last_of('/');
+      const std::string directory = relative_path.substr(0, pos + 1);
+      const std::string directory_prefix = relative_path + "/";
+
+      std::lock_guard<std::mutex> lock(lazy_mutex_);
+      for (auto it = lazy_files_.begin(); it != lazy_files_.end();){
+        const std::string& path = it->first;
+        if (path == relative_path
+            || path.compare(0, directory_prefix.length(), directory_prefix) == 0
+            || path == directory
+            || path + "/" == directory){
+          lazy_memory_ -= it->second.size;
+          lazy_order_.erase(it->second.position);
+          it = lazy_files_.erase(it);
+        }else{
+          ++it;
+        }
+      }
     }
 
 
@@ -451,29 +891,27 @@ namespace granada{
 
 
     std::string WebResourceCache::FormatLastModified(const std::time_t date){
-      #ifdef _WIN32
-        std::tm ptm;
-        localtime_s(&ptm,&date);
-        char buffer[32];
-        // Format: Tue, 15 Nov 1994 12:45:26 GMT
-        std::strftime(buffer, 32, "%a %d %b %Y %H:%M:%S %Z", &ptm);
-      #else
-	      std::tm* ptm = std::localtime(&date);
-        char buffer[32];
-        // Format: Tue, 15 Nov 1994 12:45:26 GMT
-        std::strftime(buffer, 32, "%a %d %b %Y %H:%M:%S %Z", ptm);
-        delete ptm;
-      #endif
-      
-      return buffer;
+      // Format: Tue, 15 Nov 1994 12:45:26 GMT
+      return granada::util::time::format_http_date(date);
     }
 
 
-    std::string WebResourceCache::GenerateETag(const std::string& resource_path, const std::string& last_modified){
-      boost::hash<std::string> string_hash;
-      std::size_t hash = string_hash(resource_path+last_modified);
+    std::string WebResourceCache::GenerateETag(const granada::cache::Resource& resource){
       std::stringstream ss;
-      ss << hash;
+      ss << '"' << std::hex;
+      if (resource.content.empty() && !resource.file_path.empty()){
+        // content is not in memory: modification date and size of the file.
+        ss << resource.last_modified_time << "-" << boost::filesystem::file_size(resource.file_path);
+      }else{
+        // FNV-1a hash of the content.
+        unsigned long long hash = 14695981039346656037ULL;
+        for (auto it = resource.content.begin(); it != resource.content.end(); ++it){
+          hash ^= *it;
+          hash *= 1099511628211ULL;
+        }
+        ss << std::setw(16) << std::setfill('0') << hash;
+      }
+      ss << '"';
       return ss.str();
     }
   }
@@ -1,7 +1,109 @@
 #include "granada/crypto/nonce_generator.h"
+#include <atomic>
+#include <stdexcept>
+#include <openssl/rand.h>
+#ifndef _WIN32
+#include <pthread.h>
+#endif
 
 namespace granada{
   namespace crypto{
     std::unique_ptr<utility::nonce_generator> CPPRESTNonceGenerator::n_generator_ = std::unique_ptr<utility::nonce_generator>(new utility::nonce_generator());
+
+
+    namespace{
+
+      /**
+       * Number of forks done by this process and its parents, a child
+       * process must not use the random bytes it has copied from its parent,
+       * the parent or another child would use the same bytes.
+       */
+      std::atomic<unsigned long> forks(0);
+
+
+      /**
+       * Counts the forks, called in the child process.
+       */
+      void count_fork(){
+        forks.fetch_add(1);
+      }
+
+
+      /**
+       * Registers count_fork once per process.
+       */
+      struct ForkHandler{
+        ForkHandler(){
+          #ifndef _WIN32
+            pthread_atfork(nullptr, nullptr, count_fork);
+          #endif
+        };
+      };
+
+      const ForkHandler fork_handler;
+
+
+      /**
+       * Random bytes of a thread not used yet.
+       */
+      struct RandomBuffer{
+        unsigned char bytes[BufferedNonceGenerator::BUFFER_SIZE];
+        std::size_t position = BufferedNonceGenerator::BUFFER_SIZE;
+
+        /**
+         * Number of forks when the bytes were taken.
+         */
+        unsigned long forks = 0;
+      };
+
+
+      /**
+       * Character of each random byte, 0 for the bytes that are discarded:
+       * only the 248 first values are used (4 x 62), so every character
+       * has the same probability.
+       */
+      struct Base62Table{
+        char chars[256];
+        Base62Table(){
+          const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789";
+          for (int i = 0; i < 256; ++i){
+            chars[i] = i < 248 ? alphabet[i % 62] : 0;
+          }
+        };
+      };
+
+      const Base62Table base62_table;
+    }
+
+
+    std::string BufferedNonceGenerator::generate(int& length){
+      static thread_local RandomBuffer buffer;
+      std::string nonce(length > 0 ? length : 0, '\0');
+      std::size_t i = 0;
+      const unsigned long current_forks = forks.load(std::memory_order_relaxed);
+      if (buffer.forks != current_forks){
+        // bytes copied from the parent process.
+        buffer.position = BUFFER_SIZE;
+        buffer.forks = current_forks;
+      }
+      while (i < nonce.length()){
+        if (buffer.position == BUFFER_SIZE){
+          if (RAND_bytes(buffer.bytes, BUFFER_SIZE) != 1){
+            throw std::runtime_error("random source failure");
+          }
+          buffer.position = 0;
+        }
+        // map bytes until the nonce or the buffer is complete.
+        std::size_t position = buffer.position;
+        while (i < nonce.length() && position < BUFFER_SIZE){
+          const char c = base62_table.chars[buffer.bytes[position++]];
+          if (c != 0){
+            nonce[i++] = c;
+          }
+        }
+        buffer.position = position;
+      }
+      return nonce;
+    }
   }
 }
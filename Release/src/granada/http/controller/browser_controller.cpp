@@ -33,16 +33,42 @@ namespace granada{
 
       BrowserController::BrowserController(utility::string_t url){
         m_listener_ = std::unique_ptr<http_listener>(new http_listener(url));
-        m_listener_->support(methods::GET, std::bind(&BrowserController::handle_get, this, std::placeholders::_1));
+        m_listener_->support(methods::GET, Instrument(methods::GET, Admit(std::bind(&BrowserController::handle_get, this, std::placeholders::_1))));
         cache_handler_.reset(new granada::cache::WebResourceCache());
         session_factory_.reset(new granada::http::session::SessionFactory());
+        LoadProperties();
       }
 
       BrowserController::BrowserController(utility::string_t url,std::shared_ptr<granada::http::session::SessionFactory>& session_factory){
         m_listener_ = std::unique_ptr<http_listener>(new http_listener(url));
-        m_listener_->support(methods::GET, std::bind(&BrowserController::handle_get, this, std::placeholders::_1));
+        m_listener_->support(methods::GET, Instrument(methods::GET, Admit(std::bind(&BrowserController::handle_get, this, std::placeholders::_1))));
         cache_handler_.reset(new granada::cache::WebResourceCache());
         session_factory_ = session_factory;
+        LoadProperties();
+      }
+
+
+      void BrowserController::AddNoSessionPath(const std::string& pattern){
+        no_session_paths_.push_back(pattern);
+      }
+
+
+      void BrowserController::LoadProperties(){
+        std::string no_session_paths = granada::util::application::GetProperty(entity_keys::browser_no_session_paths);
+        if (no_session_paths.empty()){
+          no_session_paths = default_strings::browser_no_session_paths;
+        }
+        granada::util::string::split(no_session_paths, ' ', no_session_paths_);
+      }
+
+
+      bool BrowserController::NeedsSession(const std::string& path){
+        for (auto it = no_session_paths_.begin(); it != no_session_paths_.end(); ++it){
+          if (!it->empty() && granada::util::string::wildcard_match(path, *it)){
+            return false;
+          }
+        }
+        return true;
       }
 
       //
@@ -52,39 +78,220 @@ namespace granada{
 
 		std::string relative_uri_path = utility::conversions::to_utf8string(request.relative_uri().path());
 
-        http_response response;
-        
-        session_factory_->Session_unique_ptr(request,response);
+        // static resources like styles, scripts or images do no session work,
+        // the other resources open a session if there is none.
+        const bool needs_session = NeedsSession(relative_uri_path);
 
         // retrieve a resource with this a given path from cache.
+        // cached resources are shared, not copied.
+        std::string accept_encoding = utility::conversions::to_utf8string(request.headers()[header_names::accept_encoding]);
+        std::shared_ptr<const granada::cache::Resource> resource = cache_handler_->GetFile(relative_uri_path, accept_encoding);
 
-        granada::cache::Resource resource = cache_handler_->GetFile(relative_uri_path);
+        http_response response(status_codes::OK);
 
-        // check if this resource version has already been used by the client,
-        // Tell the client if so using ETag.
-        std::string if_none_match = utility::conversions::to_utf8string(request.headers()[header_names::if_none_match]);
+        // bytes of the body, they are not copied into the response,
+        // owner keeps them alive until the response has been sent.
+        const unsigned char* data = nullptr;
+        std::size_t size = 0;
+        std::shared_ptr<const void> owner = resource;
 
-        response.headers().add(header_names::etag, utility::conversions::to_string_t(resource.ETag));
+        // large files are read from the hard drive while they are sent,
+        // from offset and with the given size.
+        concurrency::streams::streambuf<uint8_t> file_buffer;
+        std::size_t offset = 0;
 
-        if (!if_none_match.empty() && if_none_match==resource.ETag){
-          response.set_status_code(status_codes::NotModified);
+        if (!resource){
+          response.set_status_code(status_codes::NotFound);
         }else{
           try{
-            // resource has not already been delivered.
-			  response.headers().add(header_names::content_encoding, utility::conversions::to_string_t(resource.content_encoding));
-            response.headers().add(header_names::server, U("granada"));
-            response.headers().add(header_names::connection, U("keep-alive"));
-			response.headers().add(header_names::last_modified, utility::conversions::to_string_t(resource.last_modified));
-            response.set_status_code(status_codes::OK);
-
-			response.headers().add(header_names::content_type, utility::conversions::to_string_t(resource.content_type));
-            response.set_body(resource.content);
+            // check if this resource version has already been used by the client,
+            // Tell the client if so using ETag, or using the modification date
+            // if the client does not send an ETag.
+            std::string if_none_match = utility::conversions::to_utf8string(request.headers()[header_names::if_none_match]);
+            std::string if_modified_since = utility::conversions::to_utf8string(request.headers()[header_names::if_modified_since]);
+            const bool not_modified = IsNotModified(*resource, if_none_match, if_modified_since);
+
+            // ranges are slices of the content without compression and they
+            // are only sent if the resource has not changed since the client
+            // got the first slices (If-Range).
+            std::string range = utility::conversions::to_utf8string(request.headers()[header_names::range]);
+            const bool ranged = !not_modified && !range.empty() && RangeApplies(*resource, utility::conversions::to_utf8string(request.headers()[header_names::if_range]));
+
+            // choose the compressed variant preferred by the client,
+            // its headers are precomputed.
+            const std::vector<unsigned char>* content = &resource->content;
+            const web::http::http_headers* headers = &resource->headers;
+            if (!ranged && !resource->brotli_content.empty() && granada::util::compression::accepts(accept_encoding, "br")){
+              content = &resource->brotli_content;
+              headers = &resource->brotli_headers;
+            }else if (!ranged && !resource->gzip_content.empty() && granada::util::compression::accepts(accept_encoding, "gzip")){
+              content = &resource->gzip_content;
+              headers = &resource->gzip_headers;
+            }
+            response.headers() = *headers;
+
+            if (not_modified){
+              response.set_status_code(status_codes::NotModified);
+            }else{
+              data = content->data();
+              size = content->size();
+
+              // large file: read the file while it is sent, the file is
+              // closed once the response has been sent. It is not mapped in
+              // memory: a file truncated or rewritten while it is sent only
+              // makes the read come short and the response fail, a mapping
+              // would crash the process with SIGBUS.
+              if (!resource->file_path.empty()){
+                file_buffer = concurrency::streams::file_buffer<uint8_t>::open(utility::conversions::to_string_t(resource->file_path), std::ios::in).get();
+                if (!file_buffer.is_open()){
+                  throw std::runtime_error("file can not be opened");
+                }
+                size = (std::size_t)file_buffer.size();
+              }
+
+              std::vector<std::pair<std::size_t,std::size_t>> ranges;
+              if (ranged && granada::http::parser::ParseRange(range, size, ranges)){
+                if (ranges.empty()){
+                  response.set_status_code(status_codes::RangeNotSatisfiable);
+                  response.headers().add(header_names::content_range, utility::conversions::to_string_t("bytes */" + std::to_string(size)));
+                  data = nullptr;
+                  size = 0;
+                  if (file_buffer){
+                    file_buffer.close().wait();
+                    file_buffer = concurrency::streams::streambuf<uint8_t>();
+                  }
+                }else if (ranges.size() == 1){
+                  response.set_status_code(status_codes::PartialContent);
+                  response.headers().add(header_names::content_range, utility::conversions::to_string_t(ContentRange(ranges.front(), size)));
+                  if (file_buffer){
+                    offset = ranges.front().first;
+                  }else{
+                    data += ranges.front().first;
+                  }
+                  size = ranges.front().second - ranges.front().first + 1;
+                }else{
+                  // several ranges: multipart body with the slices.
+                  response.set_status_code(status_codes::PartialContent);
+                  int boundary_length = 32;
+                  const std::string boundary = granada::crypto::BufferedNonceGenerator().generate(boundary_length);
+                  std::shared_ptr<std::vector<unsigned char>> body(new std::vector<unsigned char>());
+                  for (auto it = ranges.begin(); it != ranges.end(); ++it){
+                    const std::string part_headers = "\r\n--" + boundary + "\r\nContent-Type: " + resource->content_type + "\r\nContent-Range: " + ContentRange(*it, size) + "\r\n\r\n";
+                    body->insert(body->end(), part_headers.begin(), part_headers.end());
+                    if (file_buffer){
+                      const std::size_t length = it->second - it->first + 1;
+                      const std::size_t start = body->size();
+                      body->resize(start + length);
+                      file_buffer.seekpos(it->first, std::ios::in);
+                      if (file_buffer.getn(body->data() + start, length).get() != length){
+                        throw std::runtime_error("file has changed");
+                      }
+                    }else{
+                      body->insert(body->end(), data + it->first, data + it->second + 1);
+                    }
+                  }
+                  if (file_buffer){
+                    file_buffer.close().wait();
+                    file_buffer = concurrency::streams::streambuf<uint8_t>();
+                  }
+                  const std::string end = "\r\n--" + boundary + "--\r\n";
+                  body->insert(body->end(), end.begin(), end.end());
+                  response.headers()[header_names::content_type] = utility::conversions::to_string_t("multipart/byteranges; boundary=" + boundary);
+                  data = body->data();
+                  size = body->size();
+                  owner = body;
+                }
+              }
+            }
           }catch(const std::exception e){
-            response.set_status_code(status_codes::NotFound);
+            response = http_response(status_codes::NotFound);
+            data = nullptr;
+            size = 0;
+            if (file_buffer){
+              file_buffer.close().wait();
+              file_buffer = concurrency::streams::streambuf<uint8_t>();
+            }
+          }
+        }
+
+        // open the session once the headers are set, it may set a cookie.
+        granada::http::session::LazySession session(session_factory_.get(), request, response);
+        if (needs_session){
+          session.get();
+        }
+
+        if (file_buffer){
+          file_buffer.seekpos(offset, std::ios::in);
+          response.set_body(concurrency::streams::istream(file_buffer), size, response.headers().content_type());
+        }else if (size > 0){
+          concurrency::streams::rawptr_buffer<uint8_t> buffer(data, size);
+          response.set_body(concurrency::streams::istream(buffer), size, response.headers().content_type());
+        }
+        request.reply(response).then([owner, file_buffer](pplx::task<void> t){
+          try{
+            t.get();
+          }catch(const std::exception e){}
+          if (file_buffer){
+            concurrency::streams::streambuf<uint8_t> buffer = file_buffer;
+            buffer.close();
           }
+        });
+
+      }
+
+
+      bool BrowserController::IsNotModified(const granada::cache::Resource& resource, const std::string& if_none_match, const std::string& if_modified_since){
+        if (!if_none_match.empty()){
+          // If-None-Match has precedence over If-Modified-Since,
+          // any of the compressed variants of the resource matches.
+          const std::string resource_etag = UnquoteETag(resource.ETag);
+          std::vector<std::string> etags;
+          granada::util::string::split(if_none_match, ',', etags);
+          for (auto it = etags.begin(); it != etags.end(); ++it){
+            std::string etag = *it;
+            granada::util::string::trim(etag);
+            etag = UnquoteETag(etag);
+            if (etag == "*" || (!resource_etag.empty() && (etag == resource_etag || etag == resource_etag + "-gzip" || etag == resource_etag + "-br"))){
+              return true;
+            }
+          }
+          return false;
+        }
+        if (!if_modified_since.empty() && resource.last_modified_time > 0){
+          std::time_t since = granada::util::time::parse_http_date(if_modified_since);
+          return since != -1 && resource.last_modified_time <= since;
         }
-        request.reply(response);
+        return false;
+      }
+
+
+      bool BrowserController::RangeApplies(const granada::cache::Resource& resource, const std::string& if_range){
+        if (if_range.empty()){
+          return true;
+        }
+        std::time_t date = granada::util::time::parse_http_date(if_range);
+        if (date != -1){
+          return resource.last_modified_time > 0 && date == resource.last_modified_time;
+        }
+        // weak ETags can not be used to combine ranges.
+        return if_range.compare(0, 2, "W/") != 0 && !resource.ETag.empty() && UnquoteETag(if_range) == UnquoteETag(resource.ETag);
+      }
+
+
+      std::string BrowserController::UnquoteETag(const std::string& etag){
+        std::string unquoted = etag;
+        if (unquoted.compare(0, 2, "W/") == 0){
+          unquoted = unquoted.substr(2);
+        }
+        if (unquoted.length() > 1 && unquoted.front() == '"' && unquoted.back() == '"'){
+          unquoted = unquoted.substr(1, unquoted.length() - 2);
+        }
+        return unquoted;
+      }
+
 
+      std::string BrowserController::ContentRange(const std::pair<std::size_t,std::size_t>& range, const std::size_t length){
+        return "bytes " + std::to_string(range.first) + "-" + std::to_string(range.second) + "/" + std::to_string(length);
       }
     }
   }
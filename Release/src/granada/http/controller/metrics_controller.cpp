@@ -0,0 +1,47 @@
+/**
+  * Copyright (c) <2016> Web App SDK granada <afernandez@cookinapps.io>
+  *
+  * This source code is licensed under the MIT license.
+  *
+  * Permission is hereby granted, free of charge, to any person obtaining a copy
+  * of this software and associated documentation files (the "Software"), to deal
+  * in the Software without restriction, including without limitation the rights
+  * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  * copies of the Software, and to permit persons to whom the Software is
+  * furnished to do so, subject to the following conditions:
+  *
+  * The above copyright notice and this permission notice shall be included in
+  * all copies or substantial portions of the Software.
+  *
+  * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  * SOFTWARE.
+  *
+  * Responds with the metrics of the HTTP requests
+  * handled by the controllers in Prometheus text format.
+  *
+  */
+#include "granada/http/controller/metrics_controller.h"
+
+namespace granada{
+  namespace http{
+    namespace controller{
+
+      MetricsController::MetricsController(utility::string_t url){
+        m_listener_ = std::unique_ptr<http_listener>(new http_listener(url));
+        m_listener_->support(methods::GET, std::bind(&MetricsController::handle_get, this, std::placeholders::_1));
+      }
+
+
+      void MetricsController::handle_get(web::http::http_request request){
+        http_response response(status_codes::OK);
+        response.set_body(granada::http::metrics::Registry::Instance().Prometheus(), "text/plain; version=0.0.4; charset=utf-8");
+        request.reply(response);
+      }
+    }
+  }
+}
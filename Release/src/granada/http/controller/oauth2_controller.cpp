@@ -46,12 +46,13 @@ namespace granada{
       OAuth2Controller::OAuth2Controller(
         utility::string_t url,
         std::shared_ptr<granada::http::session::SessionFactory>& session_factory,
-        std::shared_ptr<granada::http::oauth2::OAuth2Factory>& oauth2_factory)
+        std::shared_ptr<granada::http::oauth2::OAuth2Factory>& oauth2_factory) :
+        info_cache_(std::chrono::milliseconds(1000), {"client_id"})
       {
         m_listener_ = std::unique_ptr<http_listener>(new http_listener(url));
-        m_listener_->support(methods::GET, std::bind(&OAuth2Controller::handle_get, this, std::placeholders::_1));
-        m_listener_->support(methods::POST, std::bind(&OAuth2Controller::handle_post, this, std::placeholders::_1));
-        m_listener_->support(methods::DEL, std::bind(&OAuth2Controller::handle_delete, this, std::placeholders::_1));
+        m_listener_->support(methods::GET, Instrument(methods::GET, Admit(std::bind(&OAuth2Controller::handle_get, this, std::placeholders::_1))));
+        m_listener_->support(methods::POST, Instrument(methods::POST, Admit(std::bind(&OAuth2Controller::handle_post, this, std::placeholders::_1))));
+        m_listener_->support(methods::DEL, Instrument(methods::DEL, Admit(std::bind(&OAuth2Controller::handle_delete, this, std::placeholders::_1))));
         session_factory_ = session_factory;
         oauth2_factory_ = oauth2_factory;
         url_ = url;
@@ -125,24 +126,41 @@ namespace granada{
             response.set_body(oauth2_logout_template_);
             status_code = status_codes::OK;
           }else if(name == oauth2_info_uri_){
-            // oauth2 response parameters.
-            granada::http::oauth2::OAuth2Parameters oauth2_response;
-
-            web::json::value json;
             // only provide information if user is logged
             const std::unique_ptr<granada::http::session::Session>& authorization_server_session = session_factory_->Session_unique_ptr(request,response);
-            if (authorization_server_session->roles()->Is(entity_keys::oauth2_session_role)){
+            const bool logged = authorization_server_session->roles()->Is(entity_keys::oauth2_session_role);
+            if (logged){
               oauth2_parameters.username = authorization_server_session->roles()->GetProperty(entity_keys::oauth2_session_role,entity_keys::oauth2_session_role_username);
-              std::unique_ptr<granada::http::oauth2::OAuth2Authorization> oauth2_authorization = oauth2_factory_->OAuth2Authorization_unique_ptr(oauth2_parameters,session_factory_.get());
-              json = oauth2_authorization->Information();
+            }
+
+            // the function may run after this one has returned and once for
+            // each request that can not share the response, everything it
+            // uses is copied and it returns a new response.
+            const web::http::http_headers headers = response.headers();
+            std::function<web::http::http_response()> information = [this, logged, oauth2_parameters, headers]() mutable {
+              web::json::value json;
+              if (logged){
+                std::unique_ptr<granada::http::oauth2::OAuth2Authorization> oauth2_authorization = oauth2_factory_->OAuth2Authorization_unique_ptr(oauth2_parameters,session_factory_.get());
+                json = oauth2_authorization->Information();
+              }else{
+                // oauth2 response parameters.
+                granada::http::oauth2::OAuth2Parameters oauth2_response;
+                oauth2_response.error = oauth2_errors::access_denied;
+                oauth2_response.error_description = oauth2_errors_description::access_denied;
+                json = oauth2_response.to_json();
+              }
+              web::http::http_response information_response(status_codes::OK);
+              information_response.headers() = headers;
+              information_response.set_body(json);
+              return information_response;
+            };
+
+            if (response.headers().has(utility::conversions::to_string_t(entity_keys::session_set_cookie))){
+              // new session, its cookie is not shared.
+              request.reply(information());
             }else{
-              oauth2_response.error = oauth2_errors::access_denied;
-              oauth2_response.error_description = oauth2_errors_description::access_denied;
-              json = oauth2_response.to_json();
+              info_cache_.Reply(request, logged ? "user:" + oauth2_parameters.username : std::string(), information);
             }
-            response.set_status_code(status_codes::OK);
-            response.set_body(json);
-            request.reply(response);
             return;
           }else{
             status_code = status_codes::Forbidden;
@@ -185,6 +203,7 @@ namespace granada{
 
           std::unique_ptr<granada::http::oauth2::OAuth2Authorization> oauth2_authorization = oauth2_factory_->OAuth2Authorization_unique_ptr(oauth2_parameters,session_factory_.get());
           oauth2_response = oauth2_authorization->Grant(request,response);
+          info_cache_.Clear();
 
           if (oauth2_parameters.grant_type == utility::conversions::to_utf8string(oauth2_strings::authorization_code)){
             // reply with a json to the client.
@@ -235,6 +254,7 @@ namespace granada{
             oauth2_parameters.username = authorization_server_session->roles()->GetProperty(entity_keys::oauth2_session_role,entity_keys::oauth2_session_role_username);
             std::unique_ptr<granada::http::oauth2::OAuth2Authorization> oauth2_authorization = oauth2_factory_->OAuth2Authorization_unique_ptr(oauth2_parameters,session_factory_.get());
             json = oauth2_authorization->Delete();
+            info_cache_.Clear();
           }
         }
 
@@ -29,6 +29,9 @@ namespace granada{
     namespace controller{
 
       int PluginController::PLUGIN_HANDLER_USE_FREQUENCY_LIMIT_ = 0;
+      int PluginController::PLUGIN_HANDLER_USE_BURST_ = 1;
+      bool PluginController::PLUGIN_HANDLER_USE_LIMIT_SHARED_ = false;
+      std::unique_ptr<granada::util::rate::token_buckets> PluginController::plugin_handler_buckets_;
       bool PluginController::ALLOW_CLIENT_TO_FIRE_EVENTS_ = true;
       bool PluginController::ALLOW_CLIENT_TO_RUN_PLUGINS_ = true;
       bool PluginController::ALLOW_CLIENT_TO_SEND_MESSAGES_ = true;
@@ -40,7 +43,7 @@ namespace granada{
 
       PluginController::PluginController(utility::string_t url,std::shared_ptr<granada::http::session::SessionFactory> session_factory, std::shared_ptr<granada::plugin::PluginFactory> plugin_factory){
         m_listener_ = std::unique_ptr<http_listener>(new http_listener(url));
-        m_listener_->support(methods::POST, std::bind(&PluginController::handle_post, this, std::placeholders::_1));
+        m_listener_->support(methods::POST, Instrument(methods::POST, Admit(std::bind(&PluginController::handle_post, this, std::placeholders::_1))));
         session_factory_ = std::move(session_factory);
         plugin_factory_ = std::move(plugin_factory);
         PluginController::load_properties_call_once_.call([this](){
@@ -63,6 +66,23 @@ namespace granada{
           }
         }
 
+        // Number of uses in a row allowed before the limit applies.
+        PluginController::PLUGIN_HANDLER_USE_BURST_ = default_numbers::plugin_handler_use_burst;
+        const std::string& plugin_handler_use_burst_str = granada::util::application::GetProperty(entity_keys::plugin_handler_use_burst);
+        if (!plugin_handler_use_burst_str.empty()){
+          try{
+            PluginController::PLUGIN_HANDLER_USE_BURST_ = std::max(1,std::stoi(plugin_handler_use_burst_str));
+          }catch(const std::logic_error e){}
+        }
+
+        std::string plugin_handler_use_limit_shared = granada::util::application::GetProperty(entity_keys::plugin_handler_use_limit_shared);
+        granada::util::string::to_upper(plugin_handler_use_limit_shared);
+        PluginController::PLUGIN_HANDLER_USE_LIMIT_SHARED_ = (plugin_handler_use_limit_shared==default_strings::plugin_properties_true);
+
+        if (PluginController::PLUGIN_HANDLER_USE_FREQUENCY_LIMIT_>0){
+          PluginController::plugin_handler_buckets_.reset(new granada::util::rate::token_buckets(1000.0 / PluginController::PLUGIN_HANDLER_USE_FREQUENCY_LIMIT_, PluginController::PLUGIN_HANDLER_USE_BURST_, default_numbers::plugin_handler_use_buckets));
+        }
+
         LoadClientPermissionProperty(entity_keys::plugin_allow_client_to_fire_events,PluginController::ALLOW_CLIENT_TO_FIRE_EVENTS_);
         LoadClientPermissionProperty(entity_keys::plugin_allow_client_to_run_plugins,PluginController::ALLOW_CLIENT_TO_RUN_PLUGINS_);
         LoadClientPermissionProperty(entity_keys::plugin_allow_client_to_send_messages,PluginController::ALLOW_CLIENT_TO_SEND_MESSAGES_);
@@ -135,31 +155,17 @@ namespace granada{
       }
 
 
-      void PluginController::PluginHandlerLock(granada::plugin::PluginHandler* plugin_handler){
+      long long PluginController::PluginHandlerThrottle(granada::plugin::PluginHandler* plugin_handler){
         if (PluginController::PLUGIN_HANDLER_USE_FREQUENCY_LIMIT_>0){
-          std::string plugin_handler_value_hash_str = plugin_handler->plugin_handler_value_hash();
-          std::string t_str = plugin_handler->cache()->Read(plugin_handler_value_hash_str,entity_keys::plugin_handler_last_use);
-          bool cache_time = true;
-          if (!t_str.empty()){
-            try{
-              int t = std::stoi(t_str);
-              int milliseconds_to_limit = PluginController::PLUGIN_HANDLER_USE_FREQUENCY_LIMIT_ - granada::util::time::get_milliseconds_span(t);
-              if (milliseconds_to_limit > 0){
-                // not enough time has elapsed for using
-                // the runner, sleep. 
-                cache_time = false;
-                granada::util::time::sleep_milliseconds(milliseconds_to_limit+1);
-                PluginHandlerLock(plugin_handler);
-              }
-            }catch(const std::logic_error e){}
+          if (PluginController::PLUGIN_HANDLER_USE_LIMIT_SHARED_){
+            // bucket stored in the cache, shared by all the processes.
+            return plugin_handler->cache()->TakeToken(cache_namespaces::plugin_handler_rate_value + plugin_handler->GetId(), PluginController::PLUGIN_HANDLER_USE_FREQUENCY_LIMIT_, PluginController::PLUGIN_HANDLER_USE_BURST_);
           }
-
-          if (cache_time){
-            // save new value.
-            int now = granada::util::time::get_milliseconds();
-            plugin_handler->cache()->Write(plugin_handler_value_hash_str,entity_keys::plugin_handler_last_use,granada::util::time::stringify(now));
+          if (PluginController::plugin_handler_buckets_){
+            return PluginController::plugin_handler_buckets_->acquire(plugin_handler->GetId());
           }
         }
+        return 0;
       }
 
 
@@ -169,7 +175,6 @@ namespace granada{
 		const web::json::value& plugin_event = request_json.at(utility::conversions::to_string_t(entity_keys::plugin_event));
         if (plugin_event.is_string()){
           web::json::value parameters = granada::util::json::as_object(request_json,entity_keys::plugin_parameters);
-          PluginHandlerLock(plugin_handler);
 		  plugin_handler->Fire(utility::conversions::to_utf8string(plugin_event.as_string()), parameters, [&response_json](const web::json::value& data){
             // success
             response_json = std::move(data);;
@@ -194,7 +199,6 @@ namespace granada{
 
           web::json::value parameters = granada::util::json::as_object(request_json,entity_keys::plugin_parameters);
 
-          PluginHandlerLock(plugin_handler);
           plugin_handler->Run(plugin_id,parameters,[&response_json,&plugin_id](const web::json::value& data){
             web::json::value response_data = web::json::value::object();
 			response_data[utility::conversions::to_string_t(plugin_id)] = std::move(data);
@@ -221,7 +225,6 @@ namespace granada{
 
         if (from.is_string() && to_ids.is_array()){
           web::json::value parameters = granada::util::json::as_object(request_json,entity_keys::plugin_parameters);
-          PluginHandlerLock(plugin_handler);
 		  response_json = plugin_handler->SendMessage(utility::conversions::to_utf8string(from.as_string()), to_ids, parameters);
           
         }else{
@@ -241,10 +244,8 @@ namespace granada{
           std::string command = utility::conversions::to_utf8string(command_json.as_string());
           granada::util::string::to_upper(command);
           if (command==default_strings::plugin_command_reset){
-            PluginHandlerLock(plugin_handler);
             plugin_handler->Reset();
           }else if (command==default_strings::plugin_command_stop){
-            PluginHandlerLock(plugin_handler);
             plugin_handler->Stop();
           }else{
             response_json = web::json::value::object();
@@ -272,7 +273,7 @@ namespace granada{
         session->Update();
 
         // create a plug-in handler, linked to the session through the session token.
-        const std::unique_ptr<granada::plugin::PluginHandler>& plugin_handler = plugin_factory_->PluginHandler_unique_ptr(session->GetToken());
+        std::shared_ptr<granada::plugin::PluginHandler> plugin_handler = plugin_factory_->PluginHandler_unique_ptr(session->GetToken());
 
         // initialize Plug-in Handler only if it is not
         // already cached in the cache.
@@ -282,6 +283,71 @@ namespace granada{
         }
 
 
+        // the plug-in handler has been used too often, answer
+        // immediately instead of waiting for it.
+        const long long milliseconds_to_limit = PluginHandlerThrottle(plugin_handler.get());
+        if (milliseconds_to_limit > 0){
+          response_json = web::json::value::object();
+          response_json[utility::conversions::to_string_t(default_strings::plugin_error)] = web::json::value::string(utility::conversions::to_string_t(default_errors::plugin_too_many_requests));
+          response_json[utility::conversions::to_string_t(default_strings::plugin_error_description)] = web::json::value::string(utility::conversions::to_string_t(default_error_descriptions::plugin_too_many_requests));
+          response.headers().add(U("Retry-After"), utility::conversions::to_string_t(std::to_string((milliseconds_to_limit + 999) / 1000)));
+          response.set_body(response_json);
+          response.set_status_code(429);
+          request.reply(response);
+          return;
+        }
+
+        // wait for the runner without blocking the thread, the request
+        // is processed by the thread admitting the plug-in handler.
+        plugin_handler->RunAdmitted([this,request,response,plugin_handler]() mutable {
+          try{
+            response.set_body(ProcessRequest(request,plugin_handler.get()));
+            response.set_status_code(status_codes::OK);
+          }catch(...){
+            // the runner was admitted, the handler failed.
+            web::json::value response_json = web::json::value::object();
+            response_json[utility::conversions::to_string_t(default_strings::plugin_error)] = web::json::value::string(utility::conversions::to_string_t(default_errors::plugin_server_error));
+            response_json[utility::conversions::to_string_t(default_strings::plugin_error_description)] = web::json::value::string(utility::conversions::to_string_t(default_error_descriptions::plugin_server_error));
+            response.set_body(response_json);
+            response.set_status_code(status_codes::InternalError);
+          }
+          request.reply(response);
+        }).then([request,response](pplx::task<bool> admitted){
+          bool processed = false;
+          try{
+            processed = admitted.get();
+          }catch(...){
+            // the admission itself has failed, nothing has been replied.
+            web::http::http_response error_response = response;
+            web::json::value response_json = web::json::value::object();
+            response_json[utility::conversions::to_string_t(default_strings::plugin_error)] = web::json::value::string(utility::conversions::to_string_t(default_errors::plugin_server_error));
+            response_json[utility::conversions::to_string_t(default_strings::plugin_error_description)] = web::json::value::string(utility::conversions::to_string_t(default_error_descriptions::plugin_server_error));
+            error_response.set_body(response_json);
+            error_response.set_status_code(status_codes::InternalError);
+            request.reply(error_response);
+            return;
+          }
+          if (!processed){
+            // the runner could not be admitted in time, the server is too busy.
+            web::http::http_response busy_response = response;
+            web::json::value response_json = web::json::value::object();
+            response_json[utility::conversions::to_string_t(default_strings::plugin_error)] = web::json::value::string(utility::conversions::to_string_t(default_errors::runner_busy));
+            response_json[utility::conversions::to_string_t(default_strings::plugin_error_description)] = web::json::value::string(utility::conversions::to_string_t(default_error_descriptions::runner_busy));
+            busy_response.headers().add(U("Retry-After"), U("1"));
+            busy_response.set_body(response_json);
+            busy_response.set_status_code(status_codes::ServiceUnavailable);
+            request.reply(busy_response);
+          }
+        });
+
+      }
+
+
+      web::json::value PluginController::ProcessRequest(http_request& request, granada::plugin::PluginHandler* plugin_handler){
+
+        // response for the client.
+        web::json::value response_json;
+
         try{
           const web::json::value& request_json = request.extract_json().get();
 
@@ -292,7 +358,7 @@ namespace granada{
             ////
 
             if (PluginController::ALLOW_CLIENT_TO_FIRE_EVENTS_){
-              response_json = FireEvent(request_json, plugin_handler.get());
+              response_json = FireEvent(request_json, plugin_handler);
             }else{
               response_json = web::json::value::object();
 			  response_json[utility::conversions::to_string_t(default_strings::plugin_error)] = web::json::value::string(utility::conversions::to_string_t(default_errors::plugin_forbidden_command));
@@ -305,7 +371,7 @@ namespace granada{
             ////
 
             if (PluginController::ALLOW_CLIENT_TO_RUN_PLUGINS_){
-              response_json = RunPlugin(request_json, plugin_handler.get());
+              response_json = RunPlugin(request_json, plugin_handler);
             }else{
               response_json = web::json::value::object();
 			  response_json[utility::conversions::to_string_t(default_strings::plugin_error)] = web::json::value::string(utility::conversions::to_string_t(default_errors::plugin_forbidden_command));
@@ -320,7 +386,7 @@ namespace granada{
             ////
 
             if (PluginController::ALLOW_CLIENT_TO_SEND_MESSAGES_){
-              response_json = SendMessage(request_json, plugin_handler.get());
+              response_json = SendMessage(request_json, plugin_handler);
             }else{
               response_json = web::json::value::object();
 			  response_json[utility::conversions::to_string_t(default_strings::plugin_error)] = web::json::value::string(utility::conversions::to_string_t(default_errors::plugin_forbidden_command));
@@ -334,7 +400,7 @@ namespace granada{
             ///
 
             if (PluginController::ALLOW_CLIENT_TO_RUN_COMMANDS_){
-              response_json = RunCommand(request_json, plugin_handler.get());
+              response_json = RunCommand(request_json, plugin_handler);
             }else{
               response_json = web::json::value::object();
 			  response_json[utility::conversions::to_string_t(default_strings::plugin_error)] = web::json::value::string(utility::conversions::to_string_t(default_errors::plugin_forbidden_command));
@@ -350,10 +416,7 @@ namespace granada{
 		  response_json[utility::conversions::to_string_t(default_strings::plugin_error_description)] = web::json::value::string(utility::conversions::to_string_t(default_error_descriptions::plugin_server_error));
         }
 
-        response.set_body(response_json);
-        response.set_status_code(status_codes::OK);
-        request.reply(response);
-
+        return response_json;
       }
     }
   }
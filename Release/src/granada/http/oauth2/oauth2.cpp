@@ -119,25 +119,32 @@ namespace granada{
         }else{
 
           // client with that id does not already exist,
-          // save it.
-          cache()->Write(hash, entity_keys::oauth2_client_id, id_);
-
-          oauth2_client_creation_mtx_.unlock();
-
-          // save the client's properties.
+          // save it with all its properties at once, so the id
+          // is never seen without the rest of the client.
           key_.assign(cryptograph()->Encrypt(id_,secret));
           type_.assign(type);
           redirect_uris_ = redirect_uris;
           roles_ = roles;
           application_name_ = application_name;
 
-          cache()->Write(hash, entity_keys::oauth2_client_key, key_);
-          cache()->Write(hash, entity_keys::oauth2_client_client_type, type_);
-          cache()->Write(hash, entity_keys::oauth2_client_application_name, application_name_);
-          cache()->Write(hash, entity_keys::oauth2_client_redirect_uris, granada::util::vector::stringify(redirect_uris,","));
-          cache()->Write(hash, entity_keys::oauth2_client_roles, granada::util::vector::stringify(roles,","));
-          cache()->Write(hash, entity_keys::oauth2_client_creation_time, granada::util::time::stringify(std::time(nullptr)));
+          granada::cache::CacheBatch batch;
+          batch.Write(hash, entity_keys::oauth2_client_id, id_);
+          batch.Write(hash, entity_keys::oauth2_client_key, key_);
+          batch.Write(hash, entity_keys::oauth2_client_client_type, type_);
+          batch.Write(hash, entity_keys::oauth2_client_application_name, application_name_);
+          batch.Write(hash, entity_keys::oauth2_client_redirect_uris, granada::util::vector::stringify(redirect_uris,","));
+          batch.Write(hash, entity_keys::oauth2_client_roles, granada::util::vector::stringify(roles,","));
+          batch.Write(hash, entity_keys::oauth2_client_creation_time, granada::util::time::stringify(std::time(nullptr)));
+          const bool committed = cache()->Commit(batch);
 
+          oauth2_client_creation_mtx_.unlock();
+
+          if (!committed){
+            // nothing has been stored, the client does not exist.
+            id_.clear();
+            key_.clear();
+            throw std::runtime_error("client could not be stored");
+          }
         }
       }
 
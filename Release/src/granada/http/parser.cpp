@@ -23,32 +23,65 @@
   *
   */
 #include "granada/http/parser.h"
+#include <cstring>
+#include <limits>
+#include <algorithm>
+#include "boost/filesystem.hpp"
 
 namespace granada{
   namespace http{
     namespace parser{
 
+      /**
+       * Removes the spaces and tabs at both ends of a string reference.
+       */
+      static boost::string_ref TrimRef(boost::string_ref value){
+        while (!value.empty() && (value.front() == ' ' || value.front() == '\t')){
+          value.remove_prefix(1);
+        }
+        while (!value.empty() && (value.back() == ' ' || value.back() == '\t')){
+          value.remove_suffix(1);
+        }
+        return value;
+      }
+
+
+      /**
+       * Scans a string of key=value pairs separated by a delimiter in place,
+       * calling on_pair with the key and value of each pair until it returns false.
+       * The delimiters are searched with memchr, vectorized by the C library.
+       */
+      template<typename OnPair>
+      static void ScanPairs(boost::string_ref input, const char delimiter, const bool trim, OnPair on_pair){
+        while (!input.empty()){
+          const char* end = static_cast<const char*>(memchr(input.data(), delimiter, input.size()));
+          const std::size_t length = end ? end - input.data() : input.size();
+          boost::string_ref pair = input.substr(0, length);
+          input.remove_prefix(end ? length + 1 : length);
+          if (trim){
+            pair = TrimRef(pair);
+          }
+          const std::size_t equal = pair.find('=');
+          if (equal != boost::string_ref::npos && !on_pair(pair.substr(0, equal), pair.substr(equal + 1))){
+            return;
+          }
+        }
+      }
+
+
       std::unordered_map<std::string, std::string> ParseCookies(const web::http::http_request &request){
         std::unordered_map<std::string, std::string> cookies;
-        web::http::http_headers headers = request.headers();
-
-        if( headers.has(utility::conversions::to_string_t(entity_keys::http_parser_cookie)) ){
-			    const std::string cookies_str = utility::conversions::to_utf8string(headers[utility::conversions::to_string_t(entity_keys::http_parser_cookie)]);
-
-          // separate different cookies.
-          std::stringstream ss(cookies_str);
-          std::string cookie_name_and_content;
-          while (std::getline(ss, cookie_name_and_content, ';')) {
-            granada::util::string::trim(cookie_name_and_content);
-            // get cookie name and content.
-            const std::string delimiter("=");
-            const size_t delimiter_length(delimiter.length());
-            auto it = std::search(cookie_name_and_content.begin(), cookie_name_and_content.end(), delimiter.c_str(), delimiter.c_str() + delimiter_length);
-
-            if (it!=cookie_name_and_content.end()){
-              // insert cookie name and content in cookies map.
-              cookies.insert(std::make_pair(std::string(cookie_name_and_content.begin(),it), std::string(it+delimiter_length,cookie_name_and_content.end())));
-            }
+        const web::http::http_headers& headers = request.headers();
+
+        auto header = headers.find(utility::conversions::to_string_t(entity_keys::http_parser_cookie));
+        if (header != headers.end()){
+          const std::string cookies_str = utility::conversions::to_utf8string(header->second);
+          StringRefPairs parsed;
+          ParseCookies(cookies_str, parsed);
+          cookies.reserve(parsed.size());
+          for (auto it = parsed.begin(); it != parsed.end(); ++it){
+            // insert cookie name and content in cookies map.
+            cookies.insert(std::make_pair(it->first.to_string(), it->second.to_string()));
           }
         }
         return cookies;
@@ -57,52 +90,384 @@ namespace granada{
 
       std::unordered_map<std::string, std::string> ParseQueryString(const std::string& query_string){
         std::unordered_map<std::string, std::string> parsed_query;
-        if (!query_string.empty()){
-          std::vector<std::string> keys_and_values;
-          granada::util::string::split(query_string,'&',keys_and_values);
-          int len = keys_and_values.size();
-          while (len--) {
-            std::vector<std::string> key_and_value;
-            granada::util::string::split(keys_and_values[len],'=',key_and_value);
-            if (key_and_value.size() > 1){
-              parsed_query.insert(std::make_pair(key_and_value[0],utility::conversions::to_utf8string(web::uri::decode(utility::conversions::to_string_t(key_and_value[1])))));
+        StringRefPairs parsed;
+        ParseQueryString(query_string, parsed);
+        for (auto it = parsed.begin(); it != parsed.end(); ++it){
+          if (!it->second.empty()){
+            // only decode the values that have encoded characters,
+            // the last value of a key is kept.
+            std::string value = it->second.to_string();
+            if (it->second.find('%') != boost::string_ref::npos){
+              value = utility::conversions::to_utf8string(web::uri::decode(utility::conversions::to_string_t(value)));
             }
+            parsed_query[it->first.to_string()] = value;
           }
         }
         return parsed_query;
       }
 
 
+      void ParseCookies(const boost::string_ref& cookies, StringRefPairs& parsed){
+        ScanPairs(cookies, ';', true, [&parsed](const boost::string_ref& name, const boost::string_ref& content){
+          parsed.push_back(std::make_pair(name, content));
+          return true;
+        });
+      }
+
+
+      boost::string_ref FindCookie(const boost::string_ref& cookies, const boost::string_ref& name){
+        boost::string_ref found;
+        ScanPairs(cookies, ';', true, [&name, &found](const boost::string_ref& cookie_name, const boost::string_ref& content){
+          if (cookie_name == name){
+            found = content;
+            return false;
+          }
+          return true;
+        });
+        return found;
+      }
+
+
+      void ParseQueryString(const boost::string_ref& query_string, StringRefPairs& parsed){
+        ScanPairs(query_string, '&', false, [&parsed](const boost::string_ref& key, const boost::string_ref& value){
+          parsed.push_back(std::make_pair(key, value));
+          return true;
+        });
+      }
+
+
+      boost::string_ref FindQueryParameter(const boost::string_ref& query_string, const boost::string_ref& key){
+        boost::string_ref found;
+        ScanPairs(query_string, '&', false, [&key, &found](const boost::string_ref& parameter_key, const boost::string_ref& value){
+          // empty values are skipped, as ParseQueryString does.
+          if (parameter_key == key && !value.empty()){
+            found = value;
+          }
+          return true;
+        });
+        return found;
+      }
+
+
       std::unordered_map<std::string, std::unordered_map<std::string, std::vector<unsigned char>>> ParseMultipartFormData(const web::http::http_request &request){
 
         std::unordered_map<std::string, std::unordered_map<std::string, std::vector<unsigned char>>> multipart_form_data;
 
-        web::http::http_headers headers = request.headers();
-
         // get boundary value from headers
-        std::string boundary;
-        try {
-          boundary = ExtractBoundaryMDF(headers);
-        }catch(const std::exception e){
+        std::string boundary = ExtractMultipartBoundary(request.headers());
+        if (boundary.empty()){
           return multipart_form_data;
         }
 
-        // remove headers
-        headers.clear();
+        // parse all the parts in memory.
+        MultipartParser parser(boundary, std::numeric_limits<std::size_t>::max());
+        ParseMultipartFormData(request, parser);
 
-        // extract body from http_access as a vector of unsigned char
-        auto body = request.extract_vector().get();
-
-        if (!body.empty()){
-          try{
-            while(ParseFieldsAndPropertiesMDF(body,boundary,multipart_form_data));
-          }catch(const std::exception e){}
+        std::vector<MultipartPart>& parts = parser.GetParts();
+        for (auto it = parts.begin(); it != parts.end(); ++it){
+          std::unordered_map<std::string, std::vector<unsigned char>> parsed_properties;
+          parsed_properties.insert(std::make_pair(utility::conversions::to_utf8string(entity_keys::http_parser_property_name_label), std::vector<unsigned char>(it->name.begin(), it->name.end())));
+          if (!it->filename.empty()){
+            parsed_properties.insert(std::make_pair("filename", std::vector<unsigned char>(it->filename.begin(), it->filename.end())));
+          }
+          if (!it->content_type.empty()){
+            parsed_properties.insert(std::make_pair("Content-Type", std::vector<unsigned char>(it->content_type.begin(), it->content_type.end())));
+          }
+          parsed_properties.insert(std::make_pair(utility::conversions::to_utf8string(entity_keys::http_parser_property_value_label), std::move(it->value)));
+          multipart_form_data.insert(std::make_pair(it->name, std::move(parsed_properties)));
         }
 
         return multipart_form_data;
       }
 
 
+      bool ParseMultipartFormData(const web::http::http_request& request, MultipartParser& parser){
+        try{
+          // read the body chunk by chunk.
+          concurrency::streams::istream body = request.body();
+          auto streambuf = body.streambuf();
+          std::vector<unsigned char> chunk(64 * 1024);
+          std::size_t length;
+          while ((length = streambuf.getn(chunk.data(), chunk.size()).get()) > 0){
+            if (!parser.Consume(chunk.data(), length)){
+              return false;
+            }
+          }
+        }catch(const std::exception e){
+          return false;
+        }
+        return parser.IsComplete();
+      }
+
+
+      std::string ExtractMultipartBoundary(const web::http::http_headers& headers){
+        const std::string content_type = utility::conversions::to_utf8string(headers.content_type());
+        const std::string parameter = "boundary=";
+        auto pos = content_type.find(parameter);
+        if (pos == std::string::npos){
+          return std::string();
+        }
+        std::string boundary = content_type.substr(pos + parameter.length());
+        if (!boundary.empty() && boundary[0] == '"'){
+          // quoted boundary.
+          auto end = boundary.find('"', 1);
+          return end == std::string::npos ? std::string() : boundary.substr(1, end - 1);
+        }
+        boundary = boundary.substr(0, boundary.find(';'));
+        granada::util::string::trim(boundary);
+        return boundary;
+      }
+
+
+      MultipartParser::MultipartParser(const std::string& boundary, const std::size_t spill_size){
+        delimiter_ = "\r\n--" + boundary;
+        spill_size_ = spill_size;
+        state_ = State::PREAMBLE;
+
+        // the body starts with the delimiter without its CRLF, it is
+        // added so the first delimiter is found like the others.
+        buffer_.push_back('\r');
+        buffer_.push_back('\n');
+
+        // shift of each byte value when the last byte compared does not match.
+        const std::size_t length = delimiter_.length();
+        for (std::size_t i = 0; i < 256; ++i){
+          shift_[i] = length;
+        }
+        for (std::size_t i = 0; i + 1 < length; ++i){
+          shift_[(unsigned char)delimiter_[i]] = length - 1 - i;
+        }
+      }
+
+
+      MultipartParser::~MultipartParser(){
+        if (file_.is_open()){
+          file_.close();
+        }
+        for (auto it = parts_.begin(); it != parts_.end(); ++it){
+          if (!it->file_path.empty()){
+            boost::system::error_code error;
+            boost::filesystem::remove(it->file_path, error);
+          }
+        }
+      }
+
+
+      bool MultipartParser::Consume(const unsigned char* data, const std::size_t length){
+        if (state_ == State::FAILED){
+          return false;
+        }
+        if (state_ == State::END){
+          // epilogue is ignored.
+          return true;
+        }
+
+        buffer_.insert(buffer_.end(), data, data + length);
+
+        // position of the first byte not parsed yet.
+        std::size_t position = 0;
+        bool parsed = true;
+        while (parsed && state_ != State::END && state_ != State::FAILED){
+          parsed = false;
+          const unsigned char* begin = buffer_.data() + position;
+          const std::size_t available = buffer_.size() - position;
+
+          if (state_ == State::PREAMBLE || state_ == State::BODY){
+            const std::size_t found = Find(begin, available);
+            if (found != available){
+              if (state_ == State::BODY){
+                if (!Write(begin, found)){
+                  state_ = State::FAILED;
+                  break;
+                }
+                if (file_.is_open()){
+                  file_.close();
+                }
+              }
+              position += found + delimiter_.length();
+              state_ = State::DELIMITER;
+              parsed = true;
+            }else if (available >= delimiter_.length()){
+              // keep the last bytes, they may be the beginning of a delimiter.
+              const std::size_t safe = available - delimiter_.length() + 1;
+              if (state_ == State::BODY && !Write(begin, safe)){
+                state_ = State::FAILED;
+                break;
+              }
+              position += safe;
+            }
+          }else if (state_ == State::DELIMITER){
+            // skip transport padding, then "--" closes the body
+            // and CRLF starts the headers of a part.
+            std::size_t i = 0;
+            while (i < available && (begin[i] == ' ' || begin[i] == '\t')){
+              ++i;
+            }
+            position += i;
+            if (available - i >= 2){
+              if (begin[i] == '-' && begin[i + 1] == '-'){
+                state_ = State::END;
+              }else if (begin[i] == '\r' && begin[i + 1] == '\n'){
+                position += 2;
+                state_ = State::HEADERS;
+                parsed = true;
+              }else{
+                state_ = State::FAILED;
+              }
+            }
+          }else if (state_ == State::HEADERS){
+            static const std::string headers_end = "\r\n\r\n";
+            std::size_t headers_length = std::string::npos;
+            if (available >= 2 && begin[0] == '\r' && begin[1] == '\n'){
+              // part without headers.
+              headers_length = 0;
+            }else{
+              const unsigned char* end = std::search(begin, begin + available, headers_end.begin(), headers_end.end());
+              if (end != begin + available){
+                headers_length = end - begin + 2;
+              }else if (available > 16 * 1024){
+                // headers too large.
+                state_ = State::FAILED;
+              }
+            }
+            if (headers_length != std::string::npos){
+              parts_.push_back(MultipartPart());
+              ParseHeaders(begin, begin + headers_length);
+              position += headers_length + 2;
+              state_ = State::BODY;
+              parsed = true;
+            }
+          }
+        }
+
+        buffer_.erase(buffer_.begin(), buffer_.begin() + position);
+        return state_ != State::FAILED;
+      }
+
+
+      bool MultipartParser::IsComplete(){
+        return state_ == State::END;
+      }
+
+
+      std::vector<MultipartPart>& MultipartParser::GetParts(){
+        return parts_;
+      }
+
+
+      void MultipartParser::ParseHeaders(const unsigned char* begin, const unsigned char* end){
+        MultipartPart& part = parts_.back();
+        const std::string headers(begin, end);
+        std::size_t line_begin = 0;
+        std::size_t line_end;
+        while ((line_end = headers.find("\r\n", line_begin)) != std::string::npos){
+          const std::string line = headers.substr(line_begin, line_end - line_begin);
+          line_begin = line_end + 2;
+
+          const std::size_t colon = line.find(':');
+          if (colon == std::string::npos){
+            continue;
+          }
+          std::string name = line.substr(0, colon);
+          std::string value = line.substr(colon + 1);
+          granada::util::string::trim(name);
+          granada::util::string::trim(value);
+          granada::util::string::to_lower(name);
+
+          if (name == "content-type"){
+            part.content_type = value;
+          }else if (name == "content-disposition"){
+            // parameters with this format: form-data; name="file"; filename="a.png"
+            std::size_t i = value.find(';');
+            while (i != std::string::npos && i < value.length()){
+              ++i;
+              while (i < value.length() && value[i] == ' '){
+                ++i;
+              }
+              const std::size_t equal = value.find('=', i);
+              if (equal == std::string::npos){
+                break;
+              }
+              std::string parameter = value.substr(i, equal - i);
+              granada::util::string::trim(parameter);
+              granada::util::string::to_lower(parameter);
+              std::string parameter_value;
+              i = equal + 1;
+              if (i < value.length() && value[i] == '"'){
+                // quoted value, it can contain semicolons and escaped quotes.
+                for (++i; i < value.length() && value[i] != '"'; ++i){
+                  if (value[i] == '\\' && i + 1 < value.length()){
+                    ++i;
+                  }
+                  parameter_value += value[i];
+                }
+                i = value.find(';', i);
+              }else{
+                const std::size_t semicolon = value.find(';', i);
+                parameter_value = value.substr(i, semicolon == std::string::npos ? std::string::npos : semicolon - i);
+                granada::util::string::trim(parameter_value);
+                i = semicolon;
+              }
+              if (parameter == "name"){
+                part.name = parameter_value;
+              }else if (parameter == "filename"){
+                part.filename = parameter_value;
+              }
+            }
+          }
+        }
+      }
+
+
+      bool MultipartParser::Write(const unsigned char* data, const std::size_t length){
+        if (length == 0){
+          return true;
+        }
+        MultipartPart& part = parts_.back();
+        part.size += length;
+
+        if (part.file_path.empty() && part.size > spill_size_){
+          // part too large to be kept in memory, move it to a temporary file.
+          part.file_path = (boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("granada-%%%%-%%%%-%%%%-%%%%")).string();
+          file_.open(part.file_path, std::ios::binary | std::ios::trunc);
+          if (!file_.is_open()){
+            return false;
+          }
+          file_.write(reinterpret_cast<const char*>(part.value.data()), part.value.size());
+          std::vector<unsigned char>().swap(part.value);
+        }
+
+        if (file_.is_open()){
+          file_.write(reinterpret_cast<const char*>(data), length);
+          return file_.good();
+        }
+        part.value.insert(part.value.end(), data, data + length);
+        return true;
+      }
+
+
+      std::size_t MultipartParser::Find(const unsigned char* data, const std::size_t length){
+        const std::size_t delimiter_length = delimiter_.length();
+        const unsigned char* delimiter = reinterpret_cast<const unsigned char*>(delimiter_.data());
+        if (length < delimiter_length){
+          return length;
+        }
+        std::size_t i = 0;
+        while (i <= length - delimiter_length){
+          // compare from the last byte of the delimiter.
+          std::size_t j = delimiter_length - 1;
+          while (data[i + j] == delimiter[j]){
+            if (j == 0){
+              return i;
+            }
+            --j;
+          }
+          i += shift_[data[i + delimiter_length - 1]];
+        }
+        return length;
+      }
+
+
       std::string ExtractBoundaryMDF(const web::http::http_headers &headers){
         std::string content_type = utility::conversions::to_utf8string(headers.content_type());
         if (!content_type.empty()){
@@ -214,6 +579,84 @@ namespace granada{
         return std::string();
       }
 
+
+      bool ParseRange(const std::string& range, const std::size_t length, std::vector<std::pair<std::size_t,std::size_t>>& ranges){
+        const std::string unit = "bytes=";
+        if (range.compare(0, unit.length(), unit) != 0){
+          return false;
+        }
+        std::vector<std::string> specs;
+        granada::util::string::split(range.substr(unit.length()), ',', specs);
+        if (specs.size() > 16){
+          return false;
+        }
+        bool parsed = false;
+        for (auto it = specs.begin(); it != specs.end(); ++it){
+          std::string spec = *it;
+          granada::util::string::trim(spec);
+          if (spec.empty()){
+            continue;
+          }
+          const std::size_t dash = spec.find('-');
+          if (dash == std::string::npos || spec.find_first_not_of("0123456789-") != std::string::npos || spec.find('-', dash + 1) != std::string::npos){
+            return false;
+          }
+          const std::string first = spec.substr(0, dash);
+          const std::string last = spec.substr(dash + 1);
+          parsed = true;
+          try{
+            if (first.empty()){
+              // suffix range: last n bytes.
+              if (last.empty()){
+                return false;
+              }
+              unsigned long long suffix = std::stoull(last);
+              if (suffix > 0 && length > 0){
+                ranges.push_back(std::make_pair(suffix >= length ? 0 : length - (std::size_t)suffix, length - 1));
+              }
+            }else{
+              unsigned long long first_pos = std::stoull(first);
+              unsigned long long last_pos = last.empty() ? length - 1 : std::stoull(last);
+              if (!last.empty() && last_pos < first_pos){
+                return false;
+              }
+              if (first_pos < length){
+                if (last_pos >= length){
+                  last_pos = length - 1;
+                }
+                ranges.push_back(std::make_pair((std::size_t)first_pos, (std::size_t)last_pos));
+              }
+            }
+          }catch(const std::exception e){
+            // number out of range.
+            return false;
+          }
+        }
+
+        // merge the overlapping and adjacent ranges.
+        std::sort(ranges.begin(), ranges.end());
+        int overlapping = 0;
+        std::size_t merged = 0;
+        for (std::size_t i = 1; i < ranges.size(); ++i){
+          if (ranges[i].first <= ranges[merged].second){
+            ++overlapping;
+          }
+          if (ranges[i].first <= ranges[merged].second + 1){
+            ranges[merged].second = std::max(ranges[merged].second, ranges[i].second);
+          }else{
+            ranges[++merged] = ranges[i];
+          }
+        }
+        if (!ranges.empty()){
+          ranges.resize(merged + 1);
+        }
+        if (overlapping > 2){
+          ranges.clear();
+          return false;
+        }
+        return parsed;
+      }
+
     }
   }
 }
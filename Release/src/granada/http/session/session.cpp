@@ -37,6 +37,8 @@ namespace granada{
       std::string Session::application_session_token_support_;
       long Session::application_session_timeout_ = -1;
       long Session::session_garbage_extra_timeout_ = 0;
+      long Session::touch_frequency_ = 0;
+      bool Session::unit_of_work_ = false;
       std::mutex Session::session_exists_mtx_;
 //
 ////
@@ -49,6 +51,7 @@ namespace granada{
 
         // generate token
         token_.assign(session_handler()->GenerateToken());
+        stored_update_time_ = 0;
         Session::session_exists_mtx_.lock();
         // check if session do not already exist.
         if (session_handler()->SessionExists(token_)){
@@ -83,8 +86,16 @@ namespace granada{
         // set the update time to now.
         update_time_ = std::time(nullptr);
 
-        // save the session wherever all the sessions are stored.
-        session_handler()->SaveSession(this);
+        if (stored_update_time_ == 0){
+          // first save, save the session wherever all the sessions are stored.
+          session_handler()->SaveSession(this);
+          stored_update_time_ = update_time_;
+        }else if (update_time_ - stored_update_time_ >= touch_frequency()){
+          // only store the update time once in a while, the
+          // updates in between are coalesced.
+          session_handler()->TouchSession(this);
+          stored_update_time_ = update_time_;
+        }
       }
 
 
@@ -95,6 +106,7 @@ namespace granada{
           web::json::value session_json = to_json();
           close_callbacks()->CallAll(session_json);
           roles()->RemoveAll();
+          ClearData();
           session_handler()->DeleteSession(this);
         }
       }
@@ -134,9 +146,24 @@ namespace granada{
       }
 
 
+      const std::time_t Session::GetGarbageTime(){
+        if (application_session_timeout() < 0){
+          return 0;
+        }
+        return update_time_ + application_session_timeout() + session_garbage_extra_timeout();
+      }
+
+
       const std::string Session::Read(const std::string& key){
         if (!key.empty() && !token_.empty()){
           Update();
+          if (unit_of_work() && LoadData()){
+            auto it = data_.find(key);
+            if (it != data_.end()){
+              return it->second;
+            }
+            return std::string();
+          }
           return session_handler()->cache()->Read(session_data_hash(),key);
         }
         return std::string();
@@ -144,19 +171,71 @@ namespace granada{
 
       void Session::Write(const std::string& key, const std::string& value){
         if (!key.empty() && !token_.empty()){
-          session_handler()->cache()->Write(session_data_hash(),key, value);
+          if (unit_of_work() && LoadData()){
+            data_[key] = value;
+            dirty_keys_.insert(key);
+          }else{
+            session_handler()->cache()->Write(session_data_hash(),key, value);
+          }
           Update();
         }
       }
 
       void Session::Destroy(const std::string& key){
         if (!key.empty() && !token_.empty()){
-          session_handler()->cache()->Destroy(session_data_hash(),key);
+          if (unit_of_work() && LoadData()){
+            data_.erase(key);
+            dirty_keys_.insert(key);
+          }else{
+            session_handler()->cache()->Destroy(session_data_hash(),key);
+          }
           Update();
         }
       }
 
 
+      void Session::Flush(){
+        if (!dirty_keys_.empty() && data_cache_ != nullptr){
+          granada::cache::CacheBatch batch;
+          for (auto it = dirty_keys_.begin(); it != dirty_keys_.end(); ++it){
+            auto it2 = data_.find(*it);
+            if (it2 == data_.end()){
+              batch.Destroy(data_hash_, *it);
+            }else{
+              batch.Write(data_hash_, *it, it2->second);
+            }
+          }
+          dirty_keys_.clear();
+          data_cache_->Commit(batch);
+        }
+      }
+
+
+      const bool Session::LoadData(){
+        if (!data_loaded_){
+          data_cache_ = session_handler()->cache();
+          data_hash_.assign(session_data_hash());
+          if (!data_cache_->ReadAll(data_hash_, data_)){
+            // the driver can't read a whole set, this session
+            // reads and writes on each call instead.
+            unit_of_work_unsupported_ = true;
+            data_cache_ = nullptr;
+            return false;
+          }
+          data_loaded_ = true;
+        }
+        return true;
+      }
+
+
+      void Session::ClearData(){
+        data_.clear();
+        dirty_keys_.clear();
+        data_loaded_ = false;
+        data_cache_ = nullptr;
+      }
+
+
       web::json::value Session::to_json(){
         web::json::value json = web::json::value::object();
     		json[utility::conversions::to_string_t(entity_keys::session_token)] = web::json::value::string(utility::conversions::to_string_t(token_));
@@ -195,6 +274,27 @@ namespace granada{
             Session::application_session_timeout_ = default_numbers::session_timeout;
           }
         }
+
+        const std::string& touch_frequency_str = granada::util::application::GetProperty(entity_keys::session_touch_frequency);
+        if (touch_frequency_str.empty()){
+          Session::touch_frequency_ = default_numbers::session_touch_frequency;
+        }else{
+          try{
+            Session::touch_frequency_ = std::stol(touch_frequency_str);
+          }catch(const std::logic_error e){
+            Session::touch_frequency_ = default_numbers::session_touch_frequency;
+          }
+        }
+        // a session must not time out because its update time was not written.
+        if (Session::application_session_timeout_ > -1 && Session::touch_frequency_ > Session::application_session_timeout_ / 2){
+          Session::touch_frequency_ = Session::application_session_timeout_ / 2;
+        }
+
+        std::string unit_of_work_str = granada::util::application::GetProperty(entity_keys::session_unit_of_work);
+        if (unit_of_work_str.empty()){
+          unit_of_work_str = default_strings::session_unit_of_work;
+        }
+        Session::unit_of_work_ = (unit_of_work_str == entity_keys::_true);
       }
 
 
@@ -211,11 +311,15 @@ namespace granada{
         // search and retrieve token from cookies.
         if (session_token_support_ == entity_keys::session_cookie){
           bool session_exists = false;
-          const std::unordered_map<std::string, std::string>& cookies = granada::http::parser::ParseCookies(request);
-          auto it = cookies.find(token_label());
-          if (it != cookies.end()){
-            std::string token = it->second;
-            session_exists = LoadSession(token);
+          const web::http::http_headers& headers = request.headers();
+          auto header = headers.find(utility::conversions::to_string_t(entity_keys::http_parser_cookie));
+          if (header != headers.end()){
+            // only the token cookie is needed, find it without parsing all the cookies.
+            const std::string cookies = utility::conversions::to_utf8string(header->second);
+            const boost::string_ref token = granada::http::parser::FindCookie(cookies, token_label());
+            if (!token.empty()){
+              session_exists = LoadSession(token.to_string());
+            }
           }
           if(!session_exists){
             Open(response);
@@ -248,9 +352,11 @@ namespace granada{
           if (session_token_support_ == entity_keys::session_query){
 			const std::string& query_string = utility::conversions::to_utf8string(request.request_uri().query());
             try{
-              std::unordered_map<std::string, std::string> parsed_query = granada::http::parser::ParseQueryString(query_string);
-              const std::string& token = parsed_query[token_label()];
-              return LoadSession(token);
+              const boost::string_ref token = granada::http::parser::FindQueryParameter(query_string, token_label());
+              if (token.find('%') != boost::string_ref::npos){
+                return LoadSession(utility::conversions::to_utf8string(web::uri::decode(utility::conversions::to_string_t(token.to_string()))));
+              }
+              return LoadSession(token.to_string());
             }catch(const std::exception e){
               return false;
             }
@@ -281,14 +387,32 @@ namespace granada{
 
 
       const bool SessionRoles::Is(const std::string& role_name){
-        return session_->session_handler()->cache()->Exists(session_roles_hash(role_name));
+        // loading the roles registers their names.
+        LoadRoles();
+        const int id = RoleRegistry::Id(role_name);
+        if (id > -1){
+          return (roles_ & (1ULL << id)) != 0;
+        }
+        return named_roles_.find(role_name) != named_roles_.end();
       }
 
 
       const bool SessionRoles::Add(const std::string& role_name){
+        // role names are stored comma separated.
+        if (role_name.find(',') != std::string::npos){
+          return false;
+        }
+        const int id = RoleRegistry::Register(role_name);
         // add only if role is not already added.
         if (!Is(role_name)){
-          session_->session_handler()->cache()->Write(session_roles_hash(role_name), "0", "0");
+          if (id > -1){
+            roles_ |= (1ULL << id);
+          }else{
+            named_roles_.insert(role_name);
+          }
+          granada::cache::CacheBatch batch;
+          WriteRoles(batch);
+          session_->session_handler()->cache()->Commit(batch);
           session_->Update();
           return true;
         }
@@ -297,56 +421,320 @@ namespace granada{
 
 
       void SessionRoles::Remove(const std::string& role_name){
-        session_->session_handler()->cache()->Destroy(session_roles_hash(role_name));
+        if (role_name == "*"){
+          RemoveAll();
+          return;
+        }
+        LoadRoles();
+        granada::cache::CacheBatch batch;
+        const int id = RoleRegistry::Id(role_name);
+        if (id > -1 && (roles_ & (1ULL << id)) != 0){
+          roles_ &= ~(1ULL << id);
+          WriteRoles(batch);
+        }else if (named_roles_.erase(role_name) > 0){
+          WriteRoles(batch);
+        }
+
+        // remove the role properties.
+        const std::string& prefix = property_key(role_name, "");
+        for (auto it = properties_.begin(); it != properties_.end();){
+          if (it->first.compare(0, prefix.length(), prefix) == 0){
+            batch.Destroy(session_value_hash(), it->first);
+            it = properties_.erase(it);
+          }else{
+            ++it;
+          }
+        }
+        if (!batch.empty()){
+          session_->session_handler()->cache()->Commit(batch);
+        }
         session_->Update();
       }
 
 
       void SessionRoles::RemoveAll(){
-        Remove("*");
+        LoadRoles();
+        granada::cache::CacheBatch batch;
+        if (roles_ != 0 || !named_roles_.empty()){
+          roles_ = 0;
+          named_roles_.clear();
+          WriteRoles(batch);
+        }
+        for (auto it = properties_.begin(); it != properties_.end(); ++it){
+          batch.Destroy(session_value_hash(), it->first);
+        }
+        properties_.clear();
+        if (!batch.empty()){
+          session_->session_handler()->cache()->Commit(batch);
+        }
         session_->Update();
       }
 
 
       void SessionRoles::SetProperty(const std::string& role_name, const std::string& key, const std::string& value){
-        session_->session_handler()->cache()->Write(session_roles_hash(role_name), key, value);
+        LoadRoles();
+        const std::string& property = property_key(role_name, key);
+        session_->session_handler()->cache()->Write(session_value_hash(), property, value);
+        if (properties_loaded_){
+          properties_[property] = value;
+        }
         session_->Update();
       }
 
 
       const std::string SessionRoles::GetProperty(const std::string& role_name, const std::string& key){
-        return session_->session_handler()->cache()->Read(session_roles_hash(role_name), key);
+        LoadRoles();
+        const std::string& property = property_key(role_name, key);
+        if (properties_loaded_){
+          auto it = properties_.find(property);
+          if (it != properties_.end()){
+            return it->second;
+          }
+          return std::string();
+        }
+        return session_->session_handler()->cache()->Read(session_value_hash(), property);
       }
 
 
       void SessionRoles::DestroyProperty(const std::string& role_name, const std::string& key){
-        session_->session_handler()->cache()->Destroy(session_roles_hash(role_name), key);
+        LoadRoles();
+        const std::string& property = property_key(role_name, key);
+        session_->session_handler()->cache()->Destroy(session_value_hash(), property);
+        properties_.erase(property);
         session_->Update();
       }
 
 
+      void SessionRoles::LoadRoles(){
+        const std::string& token = session_->GetToken();
+        if (loaded_token_ != token || token.empty()){
+          roles_ = 0;
+          named_roles_.clear();
+          properties_.clear();
+          properties_loaded_ = false;
+          loaded_token_.assign(token);
+          if (token.empty()){
+            return;
+          }
+
+          std::unordered_map<std::string,std::string> values;
+          std::string roles_str;
+          if (session_->session_handler()->cache()->ReadAll(session_value_hash(), values)){
+            // keep only the role properties.
+            for (auto it = values.begin(); it != values.end(); ++it){
+              if (it->first.compare(0, entity_keys::session_role_property.length(), entity_keys::session_role_property) == 0){
+                properties_.insert(*it);
+              }
+            }
+            roles_str = values[entity_keys::session_roles];
+            properties_loaded_ = true;
+          }else{
+            roles_str = session_->session_handler()->cache()->Read(session_value_hash(), entity_keys::session_roles);
+          }
+          std::vector<std::string> role_names;
+          granada::util::string::split(roles_str, ',', role_names);
+          for (auto it = role_names.begin(); it != role_names.end(); ++it){
+            const int id = RoleRegistry::Register(*it);
+            if (id > -1){
+              roles_ |= (1ULL << id);
+            }else{
+              named_roles_.insert(*it);
+            }
+          }
+        }
+      }
+
+
+      void SessionRoles::WriteRoles(granada::cache::CacheBatch& batch){
+        if (roles_ == 0 && named_roles_.empty()){
+          batch.Destroy(session_value_hash(), entity_keys::session_roles);
+        }else{
+          std::vector<std::string> role_names;
+          for (int id = 0; id < RoleRegistry::MAX_ROLES; ++id){
+            if ((roles_ & (1ULL << id)) != 0){
+              role_names.push_back(RoleRegistry::Name(id));
+            }
+          }
+          role_names.insert(role_names.end(), named_roles_.begin(), named_roles_.end());
+          batch.Write(session_value_hash(), entity_keys::session_roles, granada::util::vector::stringify(role_names, ","));
+        }
+      }
+
+
+
+
+      std::vector<std::string> RoleRegistry::names_;
+      std::unordered_map<std::string,int> RoleRegistry::ids_;
+      int RoleRegistry::configured_ = 0;
+      std::string RoleRegistry::fingerprint_;
+      std::mutex RoleRegistry::mtx_;
+      granada::util::mutex::call_once RoleRegistry::load_properties_call_once_;
+
+
+      const int RoleRegistry::Id(const std::string& role_name){
+        RoleRegistry::load_properties_call_once_.call([](){
+          RoleRegistry::LoadProperties();
+        });
+        std::lock_guard<std::mutex> lg(mtx_);
+        auto it = ids_.find(role_name);
+        if (it != ids_.end()){
+          return it->second;
+        }
+        return -1;
+      }
+
+
+      const int RoleRegistry::Register(const std::string& role_name){
+        RoleRegistry::load_properties_call_once_.call([](){
+          RoleRegistry::LoadProperties();
+        });
+        std::lock_guard<std::mutex> lg(mtx_);
+        return RegisterUnlocked(role_name);
+      }
+
+
+      const int RoleRegistry::ConfiguredId(const std::string& role_name){
+        const int id = RoleRegistry::Id(role_name);
+        if (id < configured_){
+          return id;
+        }
+        return -1;
+      }
+
+
+      const std::string RoleRegistry::Fingerprint(){
+        RoleRegistry::load_properties_call_once_.call([](){
+          RoleRegistry::LoadProperties();
+        });
+        return fingerprint_;
+      }
+
+
+      const std::string RoleRegistry::Name(const int& id){
+        RoleRegistry::load_properties_call_once_.call([](){
+          RoleRegistry::LoadProperties();
+        });
+        std::lock_guard<std::mutex> lg(mtx_);
+        if (id > -1 && id < (int)names_.size()){
+          return names_[id];
+        }
+        return std::string();
+      }
+
+
+      void RoleRegistry::LoadProperties(){
+        std::vector<std::string> role_names;
+        granada::util::string::split(granada::util::application::GetProperty(entity_keys::session_role_registry), ',', role_names);
+        std::lock_guard<std::mutex> lg(mtx_);
+        for (auto it = role_names.begin(); it != role_names.end(); ++it){
+          std::string role_name = *it;
+          granada::util::string::trim(role_name);
+          if (!role_name.empty()){
+            RegisterUnlocked(role_name);
+          }
+        }
+        configured_ = (int)names_.size();
+
+        // FNV-1a of the configured role names, in order.
+        unsigned long long hash = 14695981039346656037ULL;
+        for (auto it = names_.begin(); it != names_.end(); ++it){
+          const std::string& role_name = *it + ",";
+          for (auto c = role_name.begin(); c != role_name.end(); ++c){
+            hash ^= (unsigned char)*c;
+            hash *= 1099511628211ULL;
+          }
+        }
+        std::stringstream ss;
+        ss << std::hex << std::setw(16) << std::setfill('0') << hash;
+        fingerprint_ = ss.str();
+      }
+
+
+      const int RoleRegistry::RegisterUnlocked(const std::string& role_name){
+        auto it = ids_.find(role_name);
+        if (it != ids_.end()){
+          return it->second;
+        }
+        if ((int)names_.size() >= MAX_ROLES){
+          return -1;
+        }
+        const int id = (int)names_.size();
+        names_.push_back(role_name);
+        ids_[role_name] = id;
+        return id;
+      }
+
+
 
 
       int SessionHandler::token_length_ = 32;
       double SessionHandler::clean_sessions_frequency_ = -1;
+      long SessionHandler::touch_flush_frequency_ = -1;
+      long SessionHandler::clean_batch_ = 0;
+      bool SessionHandler::token_filter_enabled_ = false;
+      long SessionHandler::token_filter_size_ = 0;
+      std::unordered_set<granada::http::session::SessionHandler*> SessionHandler::touching_handlers_;
+      std::mutex SessionHandler::touching_handlers_mtx_;
+      std::once_flag SessionHandler::flush_at_exit_once_;
+
+
+      SessionHandler::~SessionHandler(){
+        StopFlushingTouches();
+      }
 
 
       const bool SessionHandler::SessionExists(const std::string& token){
-        if (!token.empty()){
-          return cache()->Exists(session_value_hash(token));
+        if (!token.empty() && MayExist(token)){
+          // a hash without token is not a session.
+          return cache()->Exists(session_value_hash(token), entity_keys::session_token);
         }
         return false;
       }
 
 
+      const bool SessionHandler::MayExist(const std::string& token){
+        if (!SessionHandler::token_filter_enabled_){
+          return true;
+        }
+        std::call_once(token_filter_once_, [this](){
+          this->LoadTokenFilter();
+        });
+        return token_filter_->may_contain(token);
+      }
+
+
+      void SessionHandler::LoadTokenFilter(){
+        token_filter_.reset(new granada::util::bloom::counting_filter(SessionHandler::token_filter_size_, 4));
+        const std::unique_ptr<granada::cache::CacheHandlerIterator>& cache_iterator = cache()->make_iterator(session_value_hash("*"));
+        while(cache_iterator->has_next()){
+          const std::string& token = cache()->Read(cache_iterator->next(), entity_keys::session_token);
+          if (!token.empty()){
+            token_filter_->add(token);
+          }
+        }
+      }
+
+
       const std::string SessionHandler::GenerateToken(){
         return nonce_generator()->generate(token_length());
       }
 
 
       void SessionHandler::LoadSession(const std::string& token, granada::http::session::Session* virgin){
-        if (!token.empty()){
-          const time_t& update_time = granada::util::time::parse(cache()->Read(session_value_hash(token), entity_keys::session_update_time));
+        if (!token.empty() && MayExist(token)){
+          const std::string& hash = session_value_hash(token);
+          std::unordered_map<std::string,std::string> values;
+          if (!cache()->ReadAll(hash, values)){
+            values[entity_keys::session_token] = cache()->Read(hash, entity_keys::session_token);
+            values[entity_keys::session_update_time] = cache()->Read(hash, entity_keys::session_update_time);
+          }
+
+          // a hash without token is not a session, for example the
+          // update time of a closed session written late by another process.
+          if (values[entity_keys::session_token] != token){
+            return;
+          }
+          const time_t& update_time = granada::util::time::parse(values[entity_keys::session_update_time]);
           virgin->set(token,update_time);
           if (!virgin->IsValid()){
             virgin->set("",0);
@@ -359,8 +747,104 @@ namespace granada{
         const std::string& token = session->GetToken();
         if (!token.empty()){
           const std::string& hash = session_value_hash(token);
-          cache()->Write(hash, entity_keys::session_token, token);
-          cache()->Write(hash, entity_keys::session_update_time, granada::util::time::stringify(session->GetUpdateTime()));
+          granada::cache::CacheBatch batch;
+          batch.Write(hash, entity_keys::session_token, token);
+          batch.Write(hash, entity_keys::session_update_time, granada::util::time::stringify(session->GetUpdateTime()));
+          IndexSession(session, batch);
+          cache()->Commit(batch);
+          if (SessionHandler::token_filter_enabled_){
+            // only called for new sessions.
+            MayExist(token);
+            token_filter_->add(token);
+          }
+        }
+      }
+
+
+      void SessionHandler::TouchSession(granada::http::session::Session* session){
+        const std::string& token = session->GetToken();
+        if (!token.empty()){
+          if (SessionHandler::touch_flush_frequency_ < 0){
+            // the session may have been deleted by a concurrent request.
+            granada::cache::CacheBatch batch;
+            batch.Update(session_value_hash(token), entity_keys::session_update_time, granada::util::time::stringify(session->GetUpdateTime()));
+            IndexSession(session, batch);
+            cache()->Commit(batch);
+          }else{
+            std::call_once(touches_timer_once_, [this](){
+              this->StartFlushingTouches();
+            });
+            bool flush = false;
+            {
+              std::lock_guard<std::mutex> lg(touches_mtx_);
+              touches_[token] = std::make_pair(session->GetUpdateTime(), session->GetGarbageTime());
+              flush = session->GetUpdateTime() - touches_flush_time_ >= SessionHandler::touch_flush_frequency_;
+            }
+            if (flush){
+              FlushTouches();
+            }
+          }
+        }
+      }
+
+
+      void SessionHandler::FlushTouches(){
+        std::unordered_map<std::string,std::pair<std::time_t,std::time_t>> touches;
+        {
+          std::lock_guard<std::mutex> lg(touches_mtx_);
+          touches.swap(touches_);
+          touches_flush_time_ = std::time(nullptr);
+        }
+        if (!touches.empty()){
+          granada::cache::CacheBatch batch;
+          for (auto it = touches.begin(); it != touches.end(); ++it){
+            // only the sessions still stored, a session deleted while
+            // its touch was waiting, here or in another process, stays deleted.
+            batch.Update(session_value_hash(it->first), entity_keys::session_update_time, granada::util::time::stringify(it->second.first));
+            if (it->second.second > 0){
+              batch.Index(session_expiry_index(), it->first, it->second.second);
+            }
+          }
+          cache()->Commit(batch);
+        }
+      }
+
+
+      void SessionHandler::StartFlushingTouches(){
+        if (SessionHandler::touch_flush_frequency_ > 0){
+          touches_timer_.set([this]{
+            FlushTouches();
+          }, (int)SessionHandler::touch_flush_frequency_);
+        }
+
+        // registered after the caches have been created,
+        // so it is called before they are destroyed.
+        std::call_once(SessionHandler::flush_at_exit_once_, [](){
+          std::atexit(SessionHandler::FlushAllTouches);
+        });
+        std::lock_guard<std::mutex> lg(SessionHandler::touching_handlers_mtx_);
+        SessionHandler::touching_handlers_.insert(this);
+      }
+
+
+      void SessionHandler::StopFlushingTouches(){
+        {
+          std::lock_guard<std::mutex> lg(SessionHandler::touching_handlers_mtx_);
+          SessionHandler::touching_handlers_.erase(this);
+        }
+        touches_timer_.join();
+      }
+
+
+      void SessionHandler::FlushAllTouches(){
+        std::vector<granada::http::session::SessionHandler*> handlers;
+        {
+          std::lock_guard<std::mutex> lg(SessionHandler::touching_handlers_mtx_);
+          handlers.assign(SessionHandler::touching_handlers_.begin(), SessionHandler::touching_handlers_.end());
+        }
+        for (auto it = handlers.begin(); it != handlers.end(); ++it){
+          (*it)->touches_timer_.stop();
+          (*it)->FlushTouches();
         }
       }
 
@@ -368,23 +852,152 @@ namespace granada{
       void SessionHandler::DeleteSession(granada::http::session::Session* session){
         const std::string& token = session->GetToken();
         if (!token.empty()){
-          cache()->Destroy(session_value_hash(token));
+          {
+            std::lock_guard<std::mutex> lg(touches_mtx_);
+            touches_.erase(token);
+          }
+          if (SessionHandler::token_filter_enabled_){
+            // the filter is filled before the session is destroyed.
+            MayExist(token);
+          }
+          granada::cache::CacheBatch batch;
+          batch.Destroy(session_value_hash(token));
+          batch.Unindex(session_expiry_index(), token);
+          std::vector<long long> replies;
+          if (cache()->Commit(batch, replies) && SessionHandler::token_filter_enabled_ && !replies.empty() && replies[0] > 0){
+            // only the delete that has removed the session forgets its token,
+            // a concurrent delete of the same session removes nothing.
+            token_filter_->remove(token);
+          }
         }
       }
 
 
       void SessionHandler::CleanSessions(){
+        // write the pending update times first, so
+        // sessions in use are not taken as garbage.
+        FlushTouches();
+
+        std::call_once(index_sessions_once_, [this](){
+          this->IndexSessions();
+        });
+
+        // scans all the keys, so it is done here and not when a request
+        // loads the roles of a session.
+        MigrateRoles();
+
+        const std::size_t clean_batch = SessionHandler::clean_batch_ > 0 ? SessionHandler::clean_batch_ : default_numbers::session_clean_batch;
+        std::vector<std::string> tokens;
+        do{
+          // take only the sessions whose garbage time has passed.
+          cache()->PopIndex(session_expiry_index(), std::time(nullptr), clean_batch, tokens);
+          granada::cache::CacheBatch batch;
+          for (auto it = tokens.begin(); it != tokens.end(); ++it){
+            const std::string& key = session_value_hash(*it);
+            const std::string& token = cache()->Read(key, entity_keys::session_token);
+            if (token.empty()){
+              // only the update time of a closed session, written behind.
+              batch.Destroy(key);
+              continue;
+            }
+            const std::unique_ptr<granada::http::session::Session>& session = factory()->Session_unique_ptr();
+            const time_t& update_time = granada::util::time::parse(cache()->Read(key, entity_keys::session_update_time));
+            session->set(token,update_time);
+            if (session->IsGarbage()){
+              session->Close();
+            }else{
+              // used since it was indexed, for example by another process.
+              IndexSession(session.get(), batch);
+            }
+          }
+          if (!batch.empty()){
+            cache()->Commit(batch);
+          }
+        }while(tokens.size() == clean_batch);
+      }
+
+
+      void SessionHandler::MigrateRoles(){
+        std::call_once(migrate_roles_once_, [this](){
+          if (cache()->Exists(cache_namespaces::session_roles_migrated)){
+            return;
+          }
+          const std::unique_ptr<granada::cache::CacheHandlerIterator>& cache_iterator = cache()->make_iterator(cache_namespaces::session_roles + "*");
+          while(cache_iterator->has_next()){
+            // session:roles:<token>:<role name>
+            const std::string& key = cache_iterator->next();
+            const std::string& token_role = key.substr(cache_namespaces::session_roles.length());
+            const std::size_t colon = token_role.find(':');
+            if (colon == std::string::npos){
+              continue;
+            }
+            const std::string& token = token_role.substr(0, colon);
+            const std::string& role_name = token_role.substr(colon + 1);
+            const std::string& hash = session_value_hash(token);
+            if (role_name.empty() || role_name.find(',') != std::string::npos || !cache()->Exists(hash)){
+              continue;
+            }
+
+            granada::cache::CacheBatch batch;
+            std::vector<std::string> role_names;
+            granada::util::string::split(cache()->Read(hash, entity_keys::session_roles), ',', role_names);
+            if (std::find(role_names.begin(), role_names.end(), role_name) == role_names.end()){
+              role_names.push_back(role_name);
+              batch.Write(hash, entity_keys::session_roles, granada::util::vector::stringify(role_names, ","));
+            }
+            std::unordered_map<std::string,std::string> properties;
+            if (cache()->ReadAll(key, properties)){
+              for (auto it = properties.begin(); it != properties.end(); ++it){
+                // "0" only marked the role as added.
+                if (it->first != "0"){
+                  batch.Write(hash, entity_keys::session_role_property + role_name + ":" + it->first, it->second);
+                }
+              }
+            }
+            batch.Destroy(key);
+            cache()->Commit(batch);
+          }
+          cache()->Write(cache_namespaces::session_roles_migrated, granada::util::time::stringify(std::time(nullptr)));
+        });
+      }
+
+
+      void SessionHandler::IndexSession(granada::http::session::Session* session, granada::cache::CacheBatch& batch){
+        const std::time_t garbage_time = session->GetGarbageTime();
+        if (garbage_time > 0){
+          batch.Index(session_expiry_index(), session->GetToken(), garbage_time);
+        }
+      }
+
+
+      void SessionHandler::IndexSessions(){
+        // the sessions stored before the index existed are indexed only
+        // once, by the first process, the sessions saved since are
+        // indexed when they are saved or touched.
+        if (cache()->Exists(cache_namespaces::session_expiry_indexed)){
+          return;
+        }
+        granada::cache::CacheBatch batch;
         const std::unique_ptr<granada::cache::CacheHandlerIterator>& cache_iterator = cache()->make_iterator(session_value_hash("*"));
         while(cache_iterator->has_next()){
           const std::string& key = cache_iterator->next();
           const std::string& token = cache()->Read(key, entity_keys::session_token);
-          const std::unique_ptr<granada::http::session::Session>& session = factory()->Session_unique_ptr();
-          const time_t& update_time = granada::util::time::parse(cache()->Read(key, entity_keys::session_update_time));
-          session->set(token,update_time);
-          if (session->IsGarbage()){
-            session->Close();
+          if (token.empty()){
+            // only the update time of a closed session, written behind.
+            batch.Destroy(key);
+          }else{
+            const std::unique_ptr<granada::http::session::Session>& session = factory()->Session_unique_ptr();
+            const time_t& update_time = granada::util::time::parse(cache()->Read(key, entity_keys::session_update_time));
+            session->set(token,update_time);
+            IndexSession(session.get(), batch);
+          }
+          if (batch.operations().size() >= (std::size_t)default_numbers::session_clean_batch){
+            cache()->Commit(batch);
+            batch.clear();
           }
         }
+        batch.Write(cache_namespaces::session_expiry_indexed, granada::util::time::stringify(std::time(nullptr)));
+        cache()->Commit(batch);
       }
 
 
@@ -399,6 +1012,41 @@ namespace granada{
             SessionHandler::clean_sessions_frequency_ = default_numbers::session_clean_sessions_frequency;
           }
         }
+        const std::string& touch_flush_frequency_str(granada::util::application::GetProperty(entity_keys::session_touch_flush_frequency));
+        if (touch_flush_frequency_str.empty()){
+          SessionHandler::touch_flush_frequency_ = default_numbers::session_touch_flush_frequency;
+        }else{
+          try{
+            SessionHandler::touch_flush_frequency_ = std::stol(touch_flush_frequency_str);
+          }catch(const std::exception e){
+            SessionHandler::touch_flush_frequency_ = default_numbers::session_touch_flush_frequency;
+          }
+        }
+        const std::string& clean_batch_str(granada::util::application::GetProperty(entity_keys::session_clean_batch));
+        if (clean_batch_str.empty()){
+          SessionHandler::clean_batch_ = default_numbers::session_clean_batch;
+        }else{
+          try{
+            SessionHandler::clean_batch_ = std::stol(clean_batch_str);
+          }catch(const std::exception e){
+            SessionHandler::clean_batch_ = default_numbers::session_clean_batch;
+          }
+        }
+        std::string token_filter_str = granada::util::application::GetProperty(entity_keys::session_token_filter);
+        if (token_filter_str.empty()){
+          token_filter_str = default_strings::session_token_filter;
+        }
+        SessionHandler::token_filter_enabled_ = (token_filter_str == entity_keys::_true);
+        const std::string& token_filter_size_str(granada::util::application::GetProperty(entity_keys::session_token_filter_size));
+        if (token_filter_size_str.empty()){
+          SessionHandler::token_filter_size_ = default_numbers::session_token_filter_size;
+        }else{
+          try{
+            SessionHandler::token_filter_size_ = std::stol(token_filter_size_str);
+          }catch(const std::exception e){
+            SessionHandler::token_filter_size_ = default_numbers::session_token_filter_size;
+          }
+        }
         const std::string& token_length_str(granada::util::application::GetProperty(entity_keys::session_token_length));
         if (token_length_str.empty()){
           SessionHandler::token_length_ = nonce_lengths::session_token;
@@ -0,0 +1,380 @@
+/**
+  * Copyright (c) <2016> granada <afernandez@cookinapps.io>
+  *
+  * This source code is licensed under the MIT license.
+  *
+  * Permission is hereby granted, free of charge, to any person obtaining a copy
+  * of this software and associated documentation files (the "Software"), to deal
+  * in the Software without restriction, including without limitation the rights
+  * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  * copies of the Software, and to permit persons to whom the Software is
+  * furnished to do so, subject to the following conditions:
+  *
+  * The above copyright notice and this permission notice shall be included in
+  * all copies or substantial portions of the Software.
+  *
+  * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  * SOFTWARE.
+  */
+
+#include "granada/http/session/signed_session.h"
+
+namespace granada{
+  namespace http{
+    namespace session{
+
+      long SignedSession::token_refresh_ = 0;
+
+
+      void SignedSession::set(const std::string& token, const std::time_t& issue_time, const std::time_t& update_time, const unsigned long long& roles, const std::string& signed_token){
+        Session::set(token, update_time);
+        issue_time_ = issue_time;
+        signed_update_time_ = update_time;
+        roles_ = roles;
+        dirty_ = false;
+        signed_token_.assign(signed_token);
+      }
+
+
+      void SignedSession::Open(){
+        // if token already exist, revoke the "old" session
+        // so its token is not used again.
+        Close();
+
+        roles_ = 0;
+        signed_token_.clear();
+        issue_time_ = std::time(nullptr);
+
+        // generate an id that has never been used.
+        do{
+          token_.assign(session_handler()->GenerateToken());
+        }while(session_handler()->SessionExists(token_));
+
+        // sign the token.
+        Update();
+      }
+
+
+      void SignedSession::Open(web::http::http_response &response){
+        response_ = &response;
+        Open();
+      }
+
+
+      void SignedSession::Update(){
+        const std::time_t now = std::time(nullptr);
+        if (dirty_ || signed_token_.empty() || now - signed_update_time_ >= SignedSession::token_refresh_){
+          update_time_ = now;
+          session_handler()->SaveSession(this);
+          dirty_ = false;
+          SetCookie();
+        }
+      }
+
+
+      void SignedSession::Write(const std::string& key, const std::string& value){
+        if (unit_of_work()){
+          // the update time is flushed with the data.
+          Session::Write(key, value);
+          Session::Write(entity_keys::session_update_time, granada::util::time::stringify(std::time(nullptr)));
+        }else if (!key.empty() && !token_.empty()){
+          granada::cache::CacheBatch batch;
+          batch.Write(session_data_hash(), key, value);
+          batch.Write(session_data_hash(), entity_keys::session_update_time, granada::util::time::stringify(std::time(nullptr)));
+          session_handler()->cache()->Commit(batch);
+          Update();
+        }
+      }
+
+
+      web::json::value SignedSession::to_json(){
+        web::json::value json = Session::to_json();
+        json[utility::conversions::to_string_t(entity_keys::session_token)] = web::json::value::string(utility::conversions::to_string_t(signed_token_));
+        return json;
+      }
+
+
+      void SignedSession::LoadProperties(){
+        Session::LoadProperties();
+        const std::string& token_refresh_str = granada::util::application::GetProperty(entity_keys::session_token_refresh);
+        if (token_refresh_str.empty()){
+          SignedSession::token_refresh_ = default_numbers::session_token_refresh;
+        }else{
+          try{
+            SignedSession::token_refresh_ = std::stol(token_refresh_str);
+          }catch(const std::logic_error e){
+            SignedSession::token_refresh_ = default_numbers::session_token_refresh;
+          }
+        }
+      }
+
+
+      const bool SignedSession::LoadSession(const web::http::http_request &request,web::http::http_response &response){
+        response_ = &response;
+        return Session::LoadSession(request,response);
+      }
+
+
+      void SignedSession::SetCookie(){
+        if (response_ != nullptr && session_token_support_ == entity_keys::session_cookie && !signed_token_.empty()){
+          const std::string cookie = token_label() + "=" + signed_token_ + "; path=/";
+          const utility::string_t& header_name = utility::conversions::to_string_t(entity_keys::session_set_cookie);
+          web::http::http_headers& headers = response_->headers();
+          auto it = headers.find(header_name);
+          if (!cookie_.empty() && it != headers.end()){
+            // the token has been signed again during the request,
+            // replace the cookie instead of adding a second one.
+            std::string value = utility::conversions::to_utf8string(it->second);
+            granada::util::string::replace(value, cookie_, cookie);
+            headers[header_name] = utility::conversions::to_string_t(value);
+          }else{
+            headers.add(header_name, utility::conversions::to_string_t(cookie));
+          }
+          cookie_ = cookie;
+        }
+      }
+
+
+
+
+      const bool SignedSessionRoles::Is(const std::string& role_name){
+        const int id = RoleRegistry::ConfiguredId(role_name);
+        if (id > -1){
+          return (signed_session_->GetRoles() & (1ULL << id)) != 0;
+        }
+        return false;
+      }
+
+
+      const bool SignedSessionRoles::Add(const std::string& role_name){
+        // the bitmap is read by other processes and after restarts,
+        // only the roles with a configured id can be added.
+        const int id = RoleRegistry::ConfiguredId(role_name);
+        if (id > -1 && !Is(role_name)){
+          signed_session_->SetRoles(signed_session_->GetRoles() | (1ULL << id));
+          signed_session_->Update();
+          return true;
+        }
+        return false;
+      }
+
+
+      void SignedSessionRoles::Remove(const std::string& role_name){
+        const int id = RoleRegistry::ConfiguredId(role_name);
+        if (id > -1 && Is(role_name)){
+          signed_session_->session_handler()->cache()->Destroy(session_roles_hash(role_name));
+          signed_session_->SetRoles(signed_session_->GetRoles() & ~(1ULL << id));
+          signed_session_->Update();
+        }
+      }
+
+
+      void SignedSessionRoles::RemoveAll(){
+        if (signed_session_->GetRoles() != 0){
+          signed_session_->session_handler()->cache()->Destroy(session_roles_hash("*"));
+          signed_session_->SetRoles(0);
+          signed_session_->Update();
+        }
+      }
+
+
+      void SignedSessionRoles::SetProperty(const std::string& role_name, const std::string& key, const std::string& value){
+        signed_session_->session_handler()->cache()->Write(session_roles_hash(role_name), key, value);
+      }
+
+
+      const std::string SignedSessionRoles::GetProperty(const std::string& role_name, const std::string& key){
+        return signed_session_->session_handler()->cache()->Read(session_roles_hash(role_name), key);
+      }
+
+
+      void SignedSessionRoles::DestroyProperty(const std::string& role_name, const std::string& key){
+        signed_session_->session_handler()->cache()->Destroy(session_roles_hash(role_name), key);
+      }
+
+
+
+
+      std::unique_ptr<granada::crypto::TokenSigner> SignedSessionHandler::signer_;
+      std::once_flag SignedSessionHandler::signer_once_;
+
+
+      const bool SignedSessionHandler::SessionExists(const std::string& token){
+        if (!token.empty()){
+          return IsRevoked(token) || cache()->Exists(session_data_hash(token));
+        }
+        return false;
+      }
+
+
+      void SignedSessionHandler::LoadSession(const std::string& token, granada::http::session::Session* virgin){
+        granada::http::session::SignedSession* session = dynamic_cast<granada::http::session::SignedSession*>(virgin);
+        std::string payload;
+        if (session == nullptr || token.empty() || !signer()->Verify(token, payload)){
+          return;
+        }
+
+        // payload: id|issue time|update time|expiry time|roles|role registry fingerprint
+        // a token whose roles bitmap has been written with other
+        // role ids is refused, its bits could name other roles.
+        std::vector<std::string> values;
+        granada::util::string::split(payload, '|', values);
+        if (values.size() != 6 || values[0].empty() || values[5] != RoleRegistry::Fingerprint()){
+          return;
+        }
+        try{
+          const std::time_t issue_time = granada::util::time::parse(values[1]);
+          const std::time_t update_time = granada::util::time::parse(values[2]);
+          const std::time_t expiry_time = granada::util::time::parse(values[3]);
+          const unsigned long long roles = std::stoull(values[4], nullptr, 16);
+          if (expiry_time > 0 && expiry_time < std::time(nullptr)){
+            return;
+          }
+          if (IsRevoked(values[0])){
+            return;
+          }
+          session->set(values[0], issue_time, update_time, roles, token);
+          if (!session->IsValid()){
+            session->set("", 0, 0, 0, "");
+          }
+        }catch(const std::exception e){}
+      }
+
+
+      void SignedSessionHandler::SaveSession(granada::http::session::Session* session){
+        granada::http::session::SignedSession* signed_session = dynamic_cast<granada::http::session::SignedSession*>(session);
+        if (signed_session != nullptr && !signed_session->GetToken().empty()){
+          std::stringstream payload;
+          payload << signed_session->GetToken() << "|"
+                  << granada::util::time::stringify(signed_session->GetIssueTime()) << "|"
+                  << granada::util::time::stringify(signed_session->GetUpdateTime()) << "|"
+                  << granada::util::time::stringify(signed_session->GetExpiryTime()) << "|"
+                  << std::hex << signed_session->GetRoles() << "|"
+                  << RoleRegistry::Fingerprint();
+          signed_session->SetSignedToken(signer()->Sign(payload.str()));
+
+          // CleanSessions takes the garbage time of the data from its update
+          // time: keep it in step with the token, for the sessions that only
+          // read their data. Sessions without data do not get a data hash.
+          granada::cache::CacheBatch batch;
+          batch.Update(session_data_hash(signed_session->GetToken()), entity_keys::session_update_time, granada::util::time::stringify(signed_session->GetUpdateTime()));
+          cache()->Commit(batch);
+        }
+      }
+
+
+      void SignedSessionHandler::DeleteSession(granada::http::session::Session* session){
+        granada::http::session::SignedSession* signed_session = dynamic_cast<granada::http::session::SignedSession*>(session);
+        if (signed_session != nullptr && !signed_session->GetToken().empty()){
+          const std::string& id = signed_session->GetToken();
+
+          // the signed token stays valid until it expires,
+          // keep it revoked until then.
+          std::time_t expiry_time = signed_session->GetExpiryTime();
+          if (expiry_time == 0){
+            expiry_time = std::numeric_limits<std::time_t>::max();
+          }
+          {
+            std::lock_guard<std::mutex> lg(revoked_mtx_);
+            revoked_[id] = expiry_time;
+          }
+          granada::cache::CacheBatch batch;
+          batch.Write(session_revoked_hash(id), granada::util::time::stringify(expiry_time));
+          batch.Destroy(session_data_hash(id));
+          cache()->Commit(batch);
+        }
+      }
+
+
+      void SignedSessionHandler::CleanSessions(){
+        const std::time_t now = std::time(nullptr);
+
+        // revoked sessions whose token has expired.
+        {
+          const std::unique_ptr<granada::cache::CacheHandlerIterator>& cache_iterator = cache()->make_iterator(session_revoked_hash("*"));
+          while(cache_iterator->has_next()){
+            const std::string& key = cache_iterator->next();
+            const std::time_t expiry_time = granada::util::time::parse(cache()->Read(key));
+            if (expiry_time < now){
+              cache()->Destroy(key);
+              std::lock_guard<std::mutex> lg(revoked_mtx_);
+              revoked_.erase(key.substr(cache_namespaces::session_revoked.length()));
+            }
+          }
+        }
+
+        // data of the sessions that have timed out without being closed.
+        {
+          const std::unique_ptr<granada::cache::CacheHandlerIterator>& cache_iterator = cache()->make_iterator(session_data_hash("*"));
+          while(cache_iterator->has_next()){
+            const std::string& key = cache_iterator->next();
+            const std::unique_ptr<granada::http::session::Session>& session = factory()->Session_unique_ptr();
+            const time_t& update_time = granada::util::time::parse(cache()->Read(key, entity_keys::session_update_time));
+            session->set(key.substr(cache_namespaces::session_data.length()), update_time);
+            if (session->IsGarbage()){
+              session->Close();
+            }
+          }
+        }
+      }
+
+
+      const bool SignedSessionHandler::IsRevoked(const std::string& id){
+        std::call_once(watch_revoked_once_, [this]{
+          WatchRevoked();
+        });
+        if (revoked_subscription_ == 0){
+          return cache()->Exists(session_revoked_hash(id));
+        }
+        std::lock_guard<std::mutex> lg(revoked_mtx_);
+        return revoked_.find(id) != revoked_.end();
+      }
+
+
+      granada::crypto::TokenSigner* SignedSessionHandler::signer(){
+        std::call_once(SignedSessionHandler::signer_once_, [this]{
+          std::string signing_secret = granada::util::application::GetProperty(entity_keys::session_signing_secret);
+          if (signing_secret.empty()){
+            std::cout << "No session_signing_secret property, signed session tokens will only be valid in this process." << std::endl;
+            int length = 64;
+            signing_secret = nonce_generator()->generate(length);
+          }
+          const std::string& encryption_secret = granada::util::application::GetProperty(entity_keys::session_encryption_secret);
+          SignedSessionHandler::signer_.reset(new granada::crypto::OpensslTokenSigner(signing_secret, encryption_secret));
+        });
+        return SignedSessionHandler::signer_.get();
+      }
+
+
+      void SignedSessionHandler::WatchRevoked(){
+        // subscribe before loading so no revocation is lost in between.
+        revoked_subscription_ = cache()->Subscribe(session_revoked_hash("*"), [this](const granada::cache::CacheEvent& event){
+          const std::string& id = event.key.substr(cache_namespaces::session_revoked.length());
+          if (event.type == granada::cache::CacheEvent::Type::WRITE){
+            const std::time_t expiry_time = granada::util::time::parse(cache()->Read(event.key));
+            std::lock_guard<std::mutex> lg(revoked_mtx_);
+            revoked_[id] = expiry_time;
+          }else{
+            std::lock_guard<std::mutex> lg(revoked_mtx_);
+            revoked_.erase(id);
+          }
+        });
+        if (revoked_subscription_ != 0){
+          const std::unique_ptr<granada::cache::CacheHandlerIterator>& cache_iterator = cache()->make_iterator(session_revoked_hash("*"));
+          while(cache_iterator->has_next()){
+            const std::string& key = cache_iterator->next();
+            const std::time_t expiry_time = granada::util::time::parse(cache()->Read(key));
+            std::lock_guard<std::mutex> lg(revoked_mtx_);
+            revoked_[key.substr(cache_namespaces::session_revoked.length())] = expiry_time;
+          }
+        }
+      }
+
+    }
+  }
+}
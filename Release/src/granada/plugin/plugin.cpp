@@ -36,6 +36,7 @@ namespace granada{
     int PluginHandler::PLUGIN_BYTES_LIMIT_ = 0;
     int PluginHandler::SEND_MESSAGE_PLUGIN_GROUP_SIZE_ = 100;
     int PluginHandler::RUNNER_USE_FREQUENCY_LIMIT_ = 0;
+    std::unique_ptr<granada::runner::Scheduler> PluginHandler::runner_scheduler_;
     unsigned long long PluginHandler::uid_ = 0;
     std::mutex PluginHandler::uid_mtx_;
     granada::util::mutex::call_once PluginHandler::load_properties_call_once_;
@@ -141,10 +142,14 @@ namespace granada{
         // store plug-in loader values in the cache.
         {
           const std::string& plugin_loader_hash = plugin_loader_value_hash(plugin_id);
-          cache()->Write(plugin_loader_hash,entity_keys::plugin_header_id,plugin_id);
-		  cache()->Write(plugin_loader_hash, entity_keys::plugin_header, utility::conversions::to_utf8string(header.serialize()));
-          cache()->Write(plugin_loader_hash,entity_keys::plugin_configuration,configuration);
-          cache()->Write(plugin_loader_hash,entity_keys::plugin_script,script);
+          granada::cache::CacheBatch batch;
+          batch.Write(plugin_loader_hash,entity_keys::plugin_header_id,plugin_id);
+          batch.Write(plugin_loader_hash, entity_keys::plugin_header, utility::conversions::to_utf8string(header.serialize()));
+          batch.Write(plugin_loader_hash,entity_keys::plugin_configuration,configuration);
+          batch.Write(plugin_loader_hash,entity_keys::plugin_script,script);
+          if (!cache()->Commit(batch)){
+            return false;
+          }
         }
 
         // add event loaders so the plug-in
@@ -434,6 +439,20 @@ namespace granada{
             header = plugin->GetHeader();
           }
           
+          // store plug-in values in the cache, before the plug-in
+          // listens to events, so it is never run without its values.
+          {
+            const std::string& plugin_hash = plugin_value_hash(plugin_id);
+            granada::cache::CacheBatch batch;
+            batch.Write(plugin_hash,entity_keys::plugin_header_id,plugin_id);
+            batch.Write(plugin_hash,entity_keys::plugin_script,plugin->GetScript());
+            batch.Write(plugin_hash, entity_keys::plugin_header, utility::conversions::to_utf8string(header.serialize()));
+            batch.Write(plugin_hash, entity_keys::plugin_configuration, utility::conversions::to_utf8string(plugin->GetConfiguration().serialize()));
+            if (!cache()->Commit(batch)){
+              return false;
+            }
+          }
+
 		  if (header.has_field(utility::conversions::to_string_t(entity_keys::plugin_header_events))){
 
 			const web::json::value& events = header.at(utility::conversions::to_string_t(entity_keys::plugin_header_events));
@@ -462,15 +481,6 @@ namespace granada{
             }
           }
 
-          // store plug-in values in the cache.
-          {
-            const std::string& plugin_hash = plugin_value_hash(plugin_id);
-            cache()->Write(plugin_hash,entity_keys::plugin_header_id,plugin_id);
-            cache()->Write(plugin_hash,entity_keys::plugin_script,plugin->GetScript());
-			cache()->Write(plugin_hash, entity_keys::plugin_header, utility::conversions::to_utf8string(header.serialize()));
-			cache()->Write(plugin_hash, entity_keys::plugin_configuration, utility::conversions::to_utf8string(plugin->GetConfiguration().serialize()));
-          }
-
           // fire plug-in add after event.
           Fire(plugin_add_after_event,event_parameters);
           Fire(plugin_id + "-" + plugin_add_after_event,event_parameters);
@@ -1537,39 +1547,61 @@ namespace granada{
     }
 
 
-    void PluginHandler::RunnerLock(){
-
-      if (PluginHandler::RUNNER_USE_FREQUENCY_LIMIT_>0){
+    pplx::task<bool> PluginHandler::RunAdmitted(std::function<void()> function){
 
-        // retrieve the runner last use from the cache.
-        const std::string& plugin_handler_value_hash_str = plugin_handler_value_hash();
-        const std::string& t_str = cache()->Read(plugin_handler_value_hash_str,entity_keys::plugin_handler_runner_last_use);
+      granada::runner::Scheduler* scheduler = PluginHandler::runner_scheduler_.get();
+      if (scheduler == nullptr || granada::runner::Scheduler::Admitted()){
 
-        bool cache_time = true;
+        // runner not limited or already admitted in this thread.
+        function();
+        return pplx::task_from_result(true);
+      }
 
-        if (!t_str.empty()){
+      // the function runs in a continuation scheduled on the pplx thread
+      // pool once the admission completes, no thread waits while the
+      // Plug-in Handler is queued.
+      return scheduler->Admit(id_).then([scheduler,function](bool admitted){
+        if (admitted){
+          granada::runner::Scheduler::Scope scope;
           try{
-            const int& milliseconds_to_limit = PluginHandler::RUNNER_USE_FREQUENCY_LIMIT_ - granada::util::time::get_milliseconds_span(std::stoi(t_str));
-            if (milliseconds_to_limit > 0){
+            function();
+          }catch(...){
+            scheduler->Release();
+            throw;
+          }
+          scheduler->Release();
+        }
+        return admitted;
+      });
+    }
 
-              // not enough time has elapsed for using
-              // the runner, sleep. 
-              cache_time = false;
-              granada::util::time::sleep_milliseconds(milliseconds_to_limit+1);
 
-              // verify again.
-              RunnerLock();
+    std::string PluginHandler::RunScript(const std::string& script){
 
-            }
-          }catch(const std::logic_error e){}
-        }
+      granada::runner::Scheduler* scheduler = PluginHandler::runner_scheduler_.get();
+      if (scheduler == nullptr || granada::runner::Scheduler::Admitted()){
+        return runner()->Run(script);
+      }
 
-        if (cache_time){
+      // not admitted in this thread, wait for the admission. The admission
+      // is completed by the scheduler thread, not by a thread of the pool.
+      if (!scheduler->Admit(id_).get()){
+        web::json::value response = web::json::value::object();
+        response[utility::conversions::to_string_t(default_strings::runner_error)] = web::json::value::string(utility::conversions::to_string_t(default_errors::runner_busy));
+        response[utility::conversions::to_string_t(default_strings::runner_error_description)] = web::json::value::string(utility::conversions::to_string_t(default_error_descriptions::runner_busy));
+        return utility::conversions::to_utf8string(response.serialize());
+      }
 
-          // save last use as the time now.
-          cache()->Write(plugin_handler_value_hash_str,entity_keys::plugin_handler_runner_last_use,granada::util::time::stringify(granada::util::time::get_milliseconds()));
-        }
+      std::string response;
+      try{
+        granada::runner::Scheduler::Scope scope;
+        response = runner()->Run(script);
+      }catch(...){
+        scheduler->Release();
+        throw;
       }
+      scheduler->Release();
+      return response;
     }
 
 
@@ -1601,6 +1633,24 @@ namespace granada{
           PluginHandler::RUNNER_USE_FREQUENCY_LIMIT_ = default_numbers::plugin_runner_use_frequency_limit;
         }
       }
+
+      // Maximum number of Plug-in Handlers using the runner at once
+      // and maximum time they wait for it.
+      int runner_concurrency = default_numbers::plugin_runner_concurrency;
+      const std::string& runner_concurrency_str = granada::util::application::GetProperty(entity_keys::plugin_runner_concurrency);
+      if (!runner_concurrency_str.empty()){
+        try{
+          runner_concurrency = std::stoi(runner_concurrency_str);
+        }catch(const std::logic_error e){}
+      }
+      int runner_admission_timeout = default_numbers::plugin_runner_admission_timeout;
+      const std::string& runner_admission_timeout_str = granada::util::application::GetProperty(entity_keys::plugin_runner_admission_timeout);
+      if (!runner_admission_timeout_str.empty()){
+        try{
+          runner_admission_timeout = std::stoi(runner_admission_timeout_str);
+        }catch(const std::logic_error e){}
+      }
+      PluginHandler::runner_scheduler_.reset(new granada::runner::Scheduler(runner_concurrency > 0 ? runner_concurrency : 0, PluginHandler::RUNNER_USE_FREQUENCY_LIMIT_, runner_admission_timeout));
     }
 
 
@@ -102,9 +102,7 @@ namespace granada{
           // wait until runner is usable, it is recommended to 
           // limit the use of the runner so it does not harm
           // other users performance.
-          RunnerLock();
-
-          const std::string& response = runner()->Run(script);
+          const std::string& response = RunScript(script);
           plugin->SetScript(response);
 
           if (!plugin_extends.is_null()){
@@ -151,10 +149,7 @@ namespace granada{
         // wait until runner is usable, it is recommended to 
         // limit the use of the runner so it does not harm
         // other users performance.
-        RunnerLock();
-
-        // run the script and parse response to json.
-        web::json::value response_data = granada::util::string::to_json(runner()->Run(script));
+        web::json::value response_data = granada::util::string::to_json(RunScript(script));
 
         if (response_data.has_field(default_strings::plugin_error)){
 
@@ -276,10 +271,7 @@ namespace granada{
         // wait until runner is usable, it is recommended to 
         // limit the use of the runner so it does not harm
         // other users performance.
-        RunnerLock();
-
-        // run script and parse response to JSON.
-        response_data = granada::util::string::to_json(runner()->Run(script));
+        response_data = granada::util::string::to_json(RunScript(script));
 
       }
 
@@ -472,10 +464,7 @@ namespace granada{
         // wait until runner is usable, it is recommended to 
         // limit the use of the runner so it does not harm
         // other users performance.
-        RunnerLock();
-
-        // run the script and parse response to JSON.
-        return granada::util::string::to_json(runner()->Run(script));
+        return granada::util::string::to_json(RunScript(script));
       }
     }
 
@@ -31,6 +31,13 @@
 namespace granada{
   namespace runner{
 
+    int SpiderMonkeyJavascriptRunner::RUNTIME_MAXBYTES_;
+    int SpiderMonkeyJavascriptRunner::CONTEXT_STACKCHUNKSIZE_;
+    int SpiderMonkeyJavascriptRunner::GC_FREQUENCY_;
+    int SpiderMonkeyJavascriptRunner::RUNTIME_RUNS_;
+    granada::util::mutex::call_once SpiderMonkeyJavascriptRunner::load_properties_call_once_;
+    std::atomic<bool> SpiderMonkeyJavascriptRunner::shut_down_(false);
+
     std::shared_ptr<granada::Functions> SpiderMonkeyJavascriptRunner::functions_ = std::shared_ptr<granada::Functions>(new granada::FunctionsMap());
 
     // the files containing scripts used in this runner may have the js extensions.
@@ -52,17 +59,117 @@ namespace granada{
     };
 
 
+    bool SpiderMonkeyJavascriptRunner::Runtime::Open(){
+      if (context){
+        return true;
+      }
+      runtime = JS_NewRuntime(RUNTIME_MAXBYTES_);
+      if (!runtime){
+        return false;
+      }
+      context = JS_NewContext(runtime, CONTEXT_STACKCHUNKSIZE_);
+      if (!context){
+        JS_DestroyRuntime(runtime);
+        runtime = nullptr;
+        return false;
+      }
+      runs = 0;
+      return true;
+    }
+
+
+    void SpiderMonkeyJavascriptRunner::Runtime::Close(){
+      // after JS_ShutDown the runtimes of the threads
+      // that are still alive can't be destroyed.
+      if (context && !shut_down_.load()){
+        JS_DestroyContext(context);
+        JS_DestroyRuntime(runtime);
+      }
+      context = nullptr;
+      runtime = nullptr;
+      runs = 0;
+    }
+
+
+    void SpiderMonkeyJavascriptRunner::Runtime::Recycle(){
+      ++runs;
+      if (RUNTIME_RUNS_ > 0 && runs >= (unsigned long long) RUNTIME_RUNS_){
+        Close();
+      }else if (GC_FREQUENCY_ > 0 && runs % GC_FREQUENCY_ == 0){
+        JS_GC(runtime);
+      }else{
+        JS_MaybeGC(context);
+      }
+    }
+
+
+    SpiderMonkeyJavascriptRunner::Runtime& SpiderMonkeyJavascriptRunner::ThreadRuntime(){
+      static thread_local Runtime runtime;
+      return runtime;
+    }
+
+
+    void SpiderMonkeyJavascriptRunner::LoadProperties(){
+      std::string property;
+
+      property = granada::util::application::GetProperty(entity_keys::runner_spidermonkey_runtime_maxbytes);
+      try{
+        RUNTIME_MAXBYTES_ = std::stoi(property);
+      }catch(const std::logic_error e){
+        RUNTIME_MAXBYTES_ = default_numbers::runner_spidermonkey_runtime_maxbytes;
+      }
+
+      property = granada::util::application::GetProperty(entity_keys::runner_spidermonkey_context_stackchunksize);
+      try{
+        CONTEXT_STACKCHUNKSIZE_ = std::stoi(property);
+      }catch(const std::logic_error e){
+        CONTEXT_STACKCHUNKSIZE_ = default_numbers::runner_spidermonkey_context_stackchunksize;
+      }
+
+      property = granada::util::application::GetProperty(entity_keys::runner_spidermonkey_gc_frequency);
+      try{
+        GC_FREQUENCY_ = std::stoi(property);
+      }catch(const std::logic_error e){
+        GC_FREQUENCY_ = default_numbers::runner_spidermonkey_gc_frequency;
+      }
+
+      property = granada::util::application::GetProperty(entity_keys::runner_spidermonkey_runtime_runs);
+      try{
+        RUNTIME_RUNS_ = std::stoi(property);
+      }catch(const std::logic_error e){
+        RUNTIME_RUNS_ = default_numbers::runner_spidermonkey_runtime_runs;
+      }
+    }
+
+
     std::string SpiderMonkeyJavascriptRunner::Run(const std::string& _script){
-      JSRuntime* rt = JS_NewRuntime(default_numbers::runner_spidermonkey_runtime_maxbytes);
-      if (!rt){
-        return runner_initialization_error_;
+      // runners are created before the application properties
+      // are available, load them with the first run.
+      load_properties_call_once_.call([](){
+        LoadProperties();
+      });
+
+      Runtime& runtime = ThreadRuntime();
+      if (!runtime.busy){
+        if (!runtime.Open()){
+          return runner_initialization_error_;
+        }
+        Runtime::Lease lease(runtime);
+        return Run(runtime, _script);
       }
 
-      JSContext* cx = JS_NewContext(rt, default_numbers::runner_spidermonkey_context_stackchunksize);
-      if (!cx){
-        JS_DestroyRuntime(rt);
+      // a script is already running in the runtime of this thread,
+      // run this one in a runtime of its own.
+      Runtime own_runtime;
+      if (!own_runtime.Open()){
         return runner_initialization_error_;
       }
+      return Run(own_runtime, _script);
+    }
+
+
+    std::string SpiderMonkeyJavascriptRunner::Run(Runtime& runtime, const std::string& _script){
+      JSContext* cx = runtime.context;
 
       std::string response = "";
       
@@ -70,7 +177,8 @@ namespace granada{
 
       {
         // Scope for our various stack objects (JSAutoRequest, RootedObject), so they all go
-        // out of scope before we JS_DestroyContext.
+        // out of scope before the context is reused or destroyed.
+        // Each run has a new global object, so nothing is shared between runs.
 
         JS::RootedObject global(cx, JS_NewGlobalObject(cx, &global_class_, nullptr, JS::FireOnNewGlobalHook));
         if (!global){
@@ -106,9 +214,6 @@ namespace granada{
       }
 
       JS_EndRequest(cx);
-      
-      JS_DestroyContext(cx);
-      JS_DestroyRuntime(rt);
 
       return response;
     }
@@ -165,8 +270,13 @@ namespace granada{
 
         // recursive javascript eval is not allowed,
         // a thread is created to bypass this problem.
+        // The scripts run by the function are part of this run,
+        // they do not wait for an admission again.
         granada::function_json_json fn = SpiderMonkeyJavascriptRunner::functions_->Get(function_name);
-        pplx::create_task([&fn,&params,&response_str]{
+        const bool admitted = granada::runner::Scheduler::Admitted();
+        pplx::create_task([&fn,&params,&response_str,admitted]{
+          granada::runner::Scheduler::Scope scope(admitted);
+
           // call the function.
           try{
             response_str = fn(params).serialize();
@@ -196,10 +306,12 @@ namespace granada{
 
 
     void SpiderMonkeyJavascriptRunner::Init(){
+      shut_down_.store(false);
       JS_Init();
     }
 
     void SpiderMonkeyJavascriptRunner::Destroy(){
+      shut_down_.store(true);
       JS_ShutDown();
     }
   }
@@ -27,6 +27,7 @@
  * =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
  **/
 #include "stdafx.h"
+#include <atomic>
 #include <vector>
 #include "granada/util/time.h"
 #include "granada/cache/shared_map_cache_driver.h"
@@ -205,6 +206,149 @@ SUITE(shared_map_cache_driver)
 		VERIFY_IS_TRUE(i==2);
 	}
 
+
+	TEST(subscribe)
+	{
+		granada::cache::SharedMapCacheDriver cache_driver;
+		std::atomic_int writes(0);
+		std::atomic_int destroys(0);
+
+		const unsigned long long subscription_id = cache_driver.Subscribe("session:*",[&writes,&destroys](const granada::cache::CacheEvent& event){
+			if (event.type == granada::cache::CacheEvent::Type::WRITE){
+				writes++;
+			}else{
+				destroys++;
+			}
+		});
+		VERIFY_IS_TRUE(subscription_id > 0);
+
+		cache_driver.Write("hello","world");
+		cache_driver.Write("session:6464","token","6464");
+		cache_driver.Write("session:6464","update.time","123456789");
+		cache_driver.Destroy("session:6464","update.time");
+		cache_driver.Rename("session:6464","session:777");
+		cache_driver.Destroy("session:*");
+
+		// changes are delivered asynchronously.
+		for (int i = 0; i < 100 && (writes < 3 || destroys < 3); i++){
+			granada::util::time::sleep_milliseconds(10);
+		}
+		VERIFY_ARE_EQUAL(writes,3);
+		VERIFY_ARE_EQUAL(destroys,3);
+
+		cache_driver.Unsubscribe(subscription_id);
+		cache_driver.Write("session:6464","token","6464");
+		granada::util::time::sleep_milliseconds(200);
+		VERIFY_ARE_EQUAL(writes,3);
+	}
+
+
+	TEST(commit)
+	{
+		granada::cache::SharedMapCacheDriver cache_driver;
+		cache_driver.Write("hello","world");
+		cache_driver.Write("session:6464","update.time","123456789");
+
+		granada::cache::CacheBatch batch;
+		batch.Write("oauth2.client:6464","id","6464");
+		batch.Write("oauth2.client:6464","type","confidential");
+		batch.Write("hi","there");
+		batch.Destroy("hello");
+		batch.Destroy("session:6464","update.time");
+		batch.Rename("hi","hey");
+		batch.Rename("oauth2.client:6464","session:6464");
+		VERIFY_IS_FALSE(batch.empty());
+		VERIFY_IS_TRUE(cache_driver.Commit(batch));
+
+		VERIFY_ARE_EQUAL(cache_driver.Read("oauth2.client:6464","id"),"6464");
+		VERIFY_ARE_EQUAL(cache_driver.Read("oauth2.client:6464","type"),"confidential");
+		VERIFY_IS_FALSE(cache_driver.Exists("hello"));
+		VERIFY_IS_FALSE(cache_driver.Exists("hi"));
+		VERIFY_ARE_EQUAL(cache_driver.Read("hey"),"there");
+		VERIFY_IS_TRUE(cache_driver.Exists("session:6464"));
+		VERIFY_IS_FALSE(cache_driver.Exists("session:6464","update.time"));
+
+		batch.clear();
+		VERIFY_IS_TRUE(batch.empty());
+	}
+
+
+	TEST(commit_replies)
+	{
+		granada::cache::SharedMapCacheDriver cache_driver;
+		cache_driver.Write("session:6464","token","6464");
+
+		granada::cache::CacheBatch batch;
+		batch.Destroy("session:6464");
+		batch.Unindex("session:expiry","6464");
+		std::vector<long long> replies;
+		VERIFY_IS_TRUE(cache_driver.Commit(batch,replies));
+		VERIFY_ARE_EQUAL(replies.size(),2);
+		VERIFY_ARE_EQUAL(replies[0],1);
+
+		// a second destroy of the same session removes nothing.
+		VERIFY_IS_TRUE(cache_driver.Commit(batch,replies));
+		VERIFY_ARE_EQUAL(replies.size(),2);
+		VERIFY_ARE_EQUAL(replies[0],0);
+
+		// renaming a missing key does not fail the batch.
+		granada::cache::CacheBatch rename_batch;
+		rename_batch.Rename("session:6464","session:777");
+		rename_batch.Write("session:777","token","777");
+		VERIFY_IS_TRUE(cache_driver.Commit(rename_batch,replies));
+		VERIFY_ARE_EQUAL(replies.size(),2);
+		VERIFY_ARE_EQUAL(replies[0],0);
+		VERIFY_ARE_EQUAL(cache_driver.Read("session:777","token"),"777");
+	}
+
+
+	TEST(commit_update)
+	{
+		granada::cache::SharedMapCacheDriver cache_driver;
+		cache_driver.Write("session:value:6464","token","6464");
+
+		granada::cache::CacheBatch batch;
+		batch.Update("session:value:6464","update.time","1");
+		batch.Update("session:value:777","update.time","1");
+		std::vector<long long> replies;
+		VERIFY_IS_TRUE(cache_driver.Commit(batch,replies));
+		VERIFY_ARE_EQUAL(replies.size(),2);
+		VERIFY_ARE_EQUAL(replies[0],1);
+		VERIFY_ARE_EQUAL(replies[1],0);
+		VERIFY_ARE_EQUAL(cache_driver.Read("session:value:6464","update.time"),"1");
+
+		// an update does not bring back a destroyed set.
+		VERIFY_IS_FALSE(cache_driver.Exists("session:value:777"));
+	}
+
+
+	TEST(pop_index)
+	{
+		granada::cache::SharedMapCacheDriver cache_driver;
+		cache_driver.Index("session:expiry","a",30);
+		cache_driver.Index("session:expiry","b",10);
+		cache_driver.Index("session:expiry","c",20);
+		cache_driver.Index("session:expiry","d",50);
+		cache_driver.Index("session:expiry","a",15);
+		cache_driver.Unindex("session:expiry","c");
+
+		std::vector<std::string> members;
+		cache_driver.PopIndex("session:expiry",40,1,members);
+		VERIFY_ARE_EQUAL(members.size(),1);
+		VERIFY_ARE_EQUAL(members[0],"b");
+
+		cache_driver.PopIndex("session:expiry",40,10,members);
+		VERIFY_ARE_EQUAL(members.size(),1);
+		VERIFY_ARE_EQUAL(members[0],"a");
+
+		cache_driver.PopIndex("session:expiry",40,10,members);
+		VERIFY_IS_TRUE(members.empty());
+
+		cache_driver.PopIndex("session:expiry",50,10,members);
+		VERIFY_ARE_EQUAL(members.size(),1);
+		VERIFY_ARE_EQUAL(members[0],"d");
+	}
+
 }
     
 }}} //namespaces
@@ -0,0 +1,106 @@
+/**
+ * Copyright (c) <2016> Web App SDK granada <afernandez@cookinapps.io>
+ *
+ * This source code is licensed under the MIT license.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * =+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+
+ *
+ * Tests for granada::crypto::BufferedNonceGenerator
+ *
+ * =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+ **/
+#include "stdafx.h"
+#include <string>
+#include <unordered_set>
+#include "granada/crypto/nonce_generator.h"
+#ifndef _WIN32
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+
+namespace granada { namespace test { namespace crypto {
+    
+SUITE(nonce_generator)
+{
+
+	TEST(length_and_alphabet)
+	{
+		granada::crypto::BufferedNonceGenerator generator;
+		const std::string alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789";
+		for (int length = 0; length < 100; ++length){
+			const std::string nonce = generator.generate(length);
+			VERIFY_ARE_EQUAL((std::size_t)length, nonce.length());
+			VERIFY_IS_TRUE(nonce.find_first_not_of(alphabet) == std::string::npos);
+		}
+
+		// nonces longer than the buffer of random bytes.
+		int length = (int)granada::crypto::BufferedNonceGenerator::BUFFER_SIZE * 3;
+		const std::string nonce = generator.generate(length);
+		VERIFY_ARE_EQUAL((std::size_t)length, nonce.length());
+		VERIFY_IS_TRUE(nonce.find_first_not_of(alphabet) == std::string::npos);
+
+		int negative_length = -1;
+		VERIFY_IS_TRUE(generator.generate(negative_length).empty());
+	}
+
+	TEST(unique)
+	{
+		granada::crypto::BufferedNonceGenerator generator;
+		std::unordered_set<std::string> nonces;
+		int length = 32;
+		for (int i = 0; i < 10000; ++i){
+			VERIFY_IS_TRUE(nonces.insert(generator.generate(length)).second);
+		}
+	}
+
+#ifndef _WIN32
+	TEST(fork)
+	{
+		granada::crypto::BufferedNonceGenerator generator;
+		int length = 32;
+
+		// fill the buffer of this thread.
+		generator.generate(length);
+
+		int fds[2];
+		VERIFY_ARE_EQUAL(0, pipe(fds));
+		const pid_t pid = ::fork();
+		if (pid == 0){
+			// the child must not use the bytes left by the parent.
+			const std::string child_nonce = generator.generate(length);
+			ssize_t written = write(fds[1], child_nonce.data(), child_nonce.length());
+			_exit(written == (ssize_t)child_nonce.length() ? 0 : 1);
+		}
+		const std::string parent_nonce = generator.generate(length);
+		std::string child_nonce(length, '\0');
+		ssize_t read_bytes = read(fds[0], &child_nonce[0], child_nonce.length());
+		int status = 0;
+		waitpid(pid, &status, 0);
+		close(fds[0]);
+		close(fds[1]);
+		VERIFY_ARE_EQUAL((ssize_t)length, read_bytes);
+		VERIFY_ARE_NOT_EQUAL(parent_nonce, child_nonce);
+	}
+#endif
+
+}
+    
+}}} //namespaces
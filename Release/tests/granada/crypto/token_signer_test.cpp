@@ -0,0 +1,137 @@
+/**
+ * Copyright (c) <2016> Web App SDK granada <afernandez@cookinapps.io>
+ *
+ * This source code is licensed under the MIT license.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * =+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+
+ *
+ * Tests for granada::crypto::OpensslTokenSigner
+ *
+ * =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+ **/
+#include "stdafx.h"
+#include "granada/crypto/openssl_token_signer.h"
+
+
+namespace granada { namespace test { namespace crypto {
+    
+SUITE(token_signer)
+{
+
+	TEST(sign_verify)
+	{
+		granada::crypto::OpensslTokenSigner signer("signing secret", "");
+		const std::string payload = "6464|1500000000|1500000000|0|3";
+		const std::string token = signer.Sign(payload);
+		VERIFY_IS_FALSE(token.empty());
+
+		// the payload is only signed, it can be read.
+		VERIFY_IS_TRUE(token.find('.') != std::string::npos);
+		VERIFY_IS_TRUE(token.find_first_not_of("ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_.") == std::string::npos);
+
+		std::string verified;
+		VERIFY_IS_TRUE(signer.Verify(token, verified));
+		VERIFY_ARE_EQUAL(payload, verified);
+	}
+
+	TEST(sign_verify_encrypted)
+	{
+		granada::crypto::OpensslTokenSigner signer("signing secret", "encryption secret");
+		const std::string payload = "6464|1500000000|1500000000|0|3";
+		const std::string token = signer.Sign(payload);
+
+		// a random iv is used, the same payload gives two tokens.
+		VERIFY_ARE_NOT_EQUAL(token, signer.Sign(payload));
+
+		std::string verified;
+		VERIFY_IS_TRUE(signer.Verify(token, verified));
+		VERIFY_ARE_EQUAL(payload, verified);
+	}
+
+	TEST(base64url_lengths)
+	{
+		// every length modulo 3, binary bytes included.
+		granada::crypto::OpensslTokenSigner signer("signing secret", "");
+		std::string payload;
+		for (int i = 0; i < 8; ++i){
+			const std::string token = signer.Sign(payload);
+			std::string verified;
+			VERIFY_IS_TRUE(signer.Verify(token, verified));
+			VERIFY_ARE_EQUAL(payload, verified);
+			payload.push_back((char)(0xF8 + i));
+		}
+	}
+
+	TEST(tampered_token)
+	{
+		granada::crypto::OpensslTokenSigner signer("signing secret", "");
+		const std::string token = signer.Sign("6464|1500000000|1500000000|0|1");
+		std::string verified;
+
+		// payload changed.
+		std::string tampered = token;
+		tampered[0] = tampered[0] == 'A' ? 'B' : 'A';
+		VERIFY_IS_FALSE(signer.Verify(tampered, verified));
+
+		// signature changed.
+		tampered = token;
+		tampered[tampered.length() - 2] = tampered[tampered.length() - 2] == 'A' ? 'B' : 'A';
+		VERIFY_IS_FALSE(signer.Verify(tampered, verified));
+
+		// signature truncated, removed or malformed.
+		VERIFY_IS_FALSE(signer.Verify(token.substr(0, token.length() - 1), verified));
+		VERIFY_IS_FALSE(signer.Verify(token.substr(0, token.rfind('.')), verified));
+		VERIFY_IS_FALSE(signer.Verify(token + "=", verified));
+		VERIFY_IS_FALSE(signer.Verify("", verified));
+	}
+
+	TEST(tampered_encrypted_token)
+	{
+		granada::crypto::OpensslTokenSigner signer("signing secret", "encryption secret");
+		const std::string token = signer.Sign("6464|1500000000|1500000000|0|1");
+		std::string verified;
+		std::string tampered = token;
+		tampered[4] = tampered[4] == 'A' ? 'B' : 'A';
+		VERIFY_IS_FALSE(signer.Verify(tampered, verified));
+	}
+
+	TEST(wrong_key)
+	{
+		const std::string payload = "6464|1500000000|1500000000|0|1";
+		std::string verified;
+
+		granada::crypto::OpensslTokenSigner signer("signing secret", "");
+		granada::crypto::OpensslTokenSigner other_signer("other signing secret", "");
+		VERIFY_IS_FALSE(other_signer.Verify(signer.Sign(payload), verified));
+
+		// same signing key, other encryption key: the signature is
+		// right but the payload can not be decrypted.
+		granada::crypto::OpensslTokenSigner encrypting_signer("signing secret", "encryption secret");
+		granada::crypto::OpensslTokenSigner other_encrypting_signer("signing secret", "other encryption secret");
+		VERIFY_IS_FALSE(other_encrypting_signer.Verify(encrypting_signer.Sign(payload), verified));
+
+		// an encrypted token is not a readable payload.
+		VERIFY_IS_TRUE(signer.Verify(encrypting_signer.Sign(payload), verified));
+		VERIFY_ARE_NOT_EQUAL(payload, verified);
+	}
+
+}
+    
+}}} //namespaces
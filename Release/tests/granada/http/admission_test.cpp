@@ -0,0 +1,130 @@
+/**
+ * Copyright (c) <2016> Web App SDK granada <afernandez@cookinapps.io>
+ *
+ * This source code is licensed under the MIT license.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * =+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+
+ *
+ * Tests for granada::http::admission::Limiter
+ *
+ * =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+ **/
+#include "stdafx.h"
+#include "granada/util/time.h"
+#include "granada/http/admission.h"
+
+
+namespace granada { namespace test { namespace http {
+
+// handles requests at once for an interval of 1 millisecond,
+// all of them taking latency microseconds.
+static void interval(granada::http::admission::Limiter& limiter, const int requests, const std::uint64_t latency)
+{
+	int acquired = 0;
+	for (int i = 0; i < requests; ++i){
+		if (limiter.TryAcquire()){
+			++acquired;
+		}
+	}
+	granada::util::time::sleep_milliseconds(2);
+	for (int i = 0; i < acquired; ++i){
+		limiter.Release(latency);
+	}
+}
+
+SUITE(admission)
+{
+
+	TEST(try_acquire)
+	{
+		granada::http::admission::Limiter limiter(100, 100, 2, 1, 4);
+		VERIFY_IS_TRUE(limiter.TryAcquire());
+		VERIFY_IS_TRUE(limiter.TryAcquire());
+		VERIFY_IS_FALSE(limiter.TryAcquire());
+		VERIFY_ARE_EQUAL(limiter.in_flight(), 2);
+		limiter.Release(10);
+		VERIFY_IS_TRUE(limiter.TryAcquire());
+	}
+
+	TEST(decrease)
+	{
+		granada::http::admission::Limiter limiter(1, 1, 64, 4, 128);
+		for (int i = 0; i < 5; ++i){
+			interval(limiter, 1, 500);
+		}
+		VERIFY_ARE_EQUAL(limiter.baseline(), 500);
+		VERIFY_ARE_EQUAL(limiter.limit(), 64);
+
+		// even the fastest request waits: decreased by the gradient, at most by half.
+		interval(limiter, 1, 1500);
+		VERIFY_ARE_EQUAL(limiter.limit(), 43);
+		interval(limiter, 1, 100000);
+		VERIFY_ARE_EQUAL(limiter.limit(), 21);
+	}
+
+	TEST(slow_controller)
+	{
+		// requests of half a second with a target of 100 milliseconds:
+		// the baseline is the usual latency, not the target.
+		granada::http::admission::Limiter limiter(100, 1, 64, 4, 128);
+		for (int i = 0; i < 20; ++i){
+			interval(limiter, 1, 500000);
+		}
+		VERIFY_ARE_EQUAL(limiter.baseline(), 500000);
+		VERIFY_ARE_EQUAL(limiter.limit(), 64);
+
+		// latencies under the target never decrease the limit.
+		granada::http::admission::Limiter fast(100, 1, 64, 4, 128);
+		interval(fast, 1, 100);
+		interval(fast, 1, 50000);
+		VERIFY_ARE_EQUAL(fast.limit(), 64);
+	}
+
+	TEST(increase)
+	{
+		granada::http::admission::Limiter limiter(1, 1, 8, 4, 128);
+
+		// the limit is increased only if it has been used.
+		interval(limiter, 1, 500);
+		VERIFY_ARE_EQUAL(limiter.limit(), 8);
+		interval(limiter, 4, 500);
+		VERIFY_ARE_EQUAL(limiter.limit(), 9);
+		interval(limiter, 9, 500);
+		VERIFY_ARE_EQUAL(limiter.limit(), 10);
+	}
+
+	TEST(floor_and_ceiling)
+	{
+		granada::http::admission::Limiter limiter(1, 1, 8, 4, 10);
+		interval(limiter, 1, 500);
+		for (int i = 0; i < 10; ++i){
+			interval(limiter, 1, 100000);
+		}
+		VERIFY_ARE_EQUAL(limiter.limit(), 4);
+
+		for (int i = 0; i < 20; ++i){
+			interval(limiter, limiter.limit(), 200);
+		}
+		VERIFY_ARE_EQUAL(limiter.limit(), 10);
+	}
+
+}
+
+} } }
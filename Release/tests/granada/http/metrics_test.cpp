@@ -0,0 +1,113 @@
+/**
+ * Copyright (c) <2016> Web App SDK granada <afernandez@cookinapps.io>
+ *
+ * This source code is licensed under the MIT license.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * =+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+
+ *
+ * Tests for granada::http::metrics::RouteMetrics
+ *
+ * =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+ **/
+#include "stdafx.h"
+#include "granada/http/metrics.h"
+
+
+namespace granada { namespace test { namespace http {
+
+static bool has_line(const std::string& text, const std::string& line)
+{
+	return ("\n" + text).find("\n" + line + "\n") != std::string::npos;
+}
+
+SUITE(metrics)
+{
+
+	TEST(buckets_under_eight)
+	{
+		for (std::uint64_t latency = 0; latency < 8; ++latency){
+			VERIFY_ARE_EQUAL(granada::http::metrics::RouteMetrics::BucketIndex(latency), latency);
+			VERIFY_ARE_EQUAL(granada::http::metrics::RouteMetrics::BucketUpperBound(latency), latency);
+		}
+	}
+
+	TEST(buckets_powers_of_two)
+	{
+		// each power of two starts the first of its 8 buckets.
+		for (int power = 3; power < 40; ++power){
+			const std::uint64_t latency = (std::uint64_t)1 << power;
+			const std::size_t index = granada::http::metrics::RouteMetrics::BucketIndex(latency);
+			VERIFY_ARE_EQUAL(index, (std::size_t)(power - 2) * 8);
+			VERIFY_ARE_EQUAL(granada::http::metrics::RouteMetrics::BucketUpperBound(index - 1), latency - 1);
+			VERIFY_ARE_EQUAL(granada::http::metrics::RouteMetrics::BucketIndex(latency - 1), index - 1);
+			VERIFY_IS_TRUE(granada::http::metrics::RouteMetrics::BucketUpperBound(index) >= latency);
+		}
+
+		// buckets are contiguous: the next latency after the upper bound
+		// of a bucket is in the next bucket.
+		for (std::size_t index = 0; index + 1 < granada::http::metrics::RouteMetrics::BUCKETS; ++index){
+			const std::uint64_t upper_bound = granada::http::metrics::RouteMetrics::BucketUpperBound(index);
+			VERIFY_ARE_EQUAL(granada::http::metrics::RouteMetrics::BucketIndex(upper_bound), index);
+			VERIFY_ARE_EQUAL(granada::http::metrics::RouteMetrics::BucketIndex(upper_bound + 1), index + 1);
+		}
+
+		// latencies beyond the last bucket are in the last bucket.
+		VERIFY_ARE_EQUAL(granada::http::metrics::RouteMetrics::BucketIndex((std::uint64_t)1 << 62), granada::http::metrics::RouteMetrics::BUCKETS - 1);
+	}
+
+	TEST(cumulative_le)
+	{
+		granada::http::metrics::RouteMetrics route_metrics("/plugin", "POST");
+		route_metrics.Record(200, 10, 100, 100);
+		route_metrics.Record(200, 10, 100, 900);
+		route_metrics.Record(201, 10, 100, 20000);
+		route_metrics.Record(404, 10, 100, 3000000);
+		route_metrics.Record(500, 10, 100, 20000000);
+
+		std::ostringstream requests, bytes, histogram, quantiles;
+		route_metrics.Write(requests, bytes, histogram, quantiles);
+
+		const std::string labels = "route=\"/plugin\",method=\"POST\"";
+		VERIFY_IS_TRUE(has_line(requests.str(), "granada_http_requests_total{" + labels + ",status=\"2xx\"} 3"));
+		VERIFY_IS_TRUE(has_line(requests.str(), "granada_http_requests_total{" + labels + ",status=\"4xx\"} 1"));
+		VERIFY_IS_TRUE(has_line(requests.str(), "granada_http_requests_total{" + labels + ",status=\"5xx\"} 1"));
+		VERIFY_IS_TRUE(has_line(bytes.str(), "granada_http_request_bytes_total{" + labels + "} 50"));
+		VERIFY_IS_TRUE(has_line(bytes.str(), "granada_http_response_bytes_total{" + labels + "} 500"));
+
+		const std::string bucket = "granada_http_request_duration_seconds_bucket{" + labels + ",le=";
+		VERIFY_IS_TRUE(has_line(histogram.str(), bucket + "\"0.0005\"} 1"));
+		VERIFY_IS_TRUE(has_line(histogram.str(), bucket + "\"0.001\"} 2"));
+		VERIFY_IS_TRUE(has_line(histogram.str(), bucket + "\"0.01\"} 2"));
+		VERIFY_IS_TRUE(has_line(histogram.str(), bucket + "\"0.025\"} 3"));
+		VERIFY_IS_TRUE(has_line(histogram.str(), bucket + "\"2.5\"} 3"));
+		VERIFY_IS_TRUE(has_line(histogram.str(), bucket + "\"5\"} 4"));
+		VERIFY_IS_TRUE(has_line(histogram.str(), bucket + "\"10\"} 4"));
+		VERIFY_IS_TRUE(has_line(histogram.str(), bucket + "\"+Inf\"} 5"));
+		VERIFY_IS_TRUE(has_line(histogram.str(), "granada_http_request_duration_seconds_count{" + labels + "} 5"));
+
+		// the median is in the bucket of 20 milliseconds.
+		std::ostringstream median;
+		median << "granada_http_request_duration_quantile_seconds{" << labels << ",quantile=\"0.5\"} " << granada::http::metrics::RouteMetrics::BucketUpperBound(granada::http::metrics::RouteMetrics::BucketIndex(20000)) / 1000000.0;
+		VERIFY_IS_TRUE(has_line(quantiles.str(), median.str()));
+	}
+
+}
+
+} } }
@@ -0,0 +1,163 @@
+/**
+ * Copyright (c) <2016> Web App SDK granada <afernandez@cookinapps.io>
+ *
+ * This source code is licensed under the MIT license.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * =+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+
+ *
+ * Tests for granada::http::parser::MultipartParser
+ *
+ * =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+ **/
+#include "stdafx.h"
+#include <algorithm>
+#include "granada/http/parser.h"
+
+
+namespace granada { namespace test { namespace http {
+
+static const std::string boundary = "----WebKitFormBoundarymBItcSVphgAjmbJC";
+
+static const std::string body =
+	"------WebKitFormBoundarymBItcSVphgAjmbJC\r\n"
+	"Content-Disposition: form-data; name=\"test-text-field\"\r\n"
+	"\r\n"
+	"hello\r\n"
+	"------WebKitFormBoundarymBItcSVphgAjmbJC\r\n"
+	"Content-Disposition: form-data; name=\"file\"; filename=\"a;b.png\"\r\n"
+	"Content-Type: image/png\r\n"
+	"\r\n"
+	"\x89PNG\r\n--not-the-boundary\r\n------WebKitFormBoundary\r\n"
+	"------WebKitFormBoundarymBItcSVphgAjmbJC--\r\n";
+
+static const std::string file_content = "\x89PNG\r\n--not-the-boundary\r\n------WebKitFormBoundary";
+
+static bool consume(granada::http::parser::MultipartParser& parser, const std::string& data, const std::size_t chunk_size)
+{
+	for (std::size_t i = 0; i < data.length(); i += chunk_size){
+		const std::size_t length = std::min(chunk_size, data.length() - i);
+		if (!parser.Consume(reinterpret_cast<const unsigned char*>(data.data()) + i, length)){
+			return false;
+		}
+	}
+	return true;
+}
+
+SUITE(multipart_parser)
+{
+
+	TEST(chunk_sizes)
+	{
+		// the same body cut at every position gives the same parts.
+		for (std::size_t chunk_size = 1; chunk_size <= body.length(); ++chunk_size){
+			granada::http::parser::MultipartParser parser(boundary, 1024 * 1024);
+			VERIFY_IS_TRUE(consume(parser, body, chunk_size));
+			VERIFY_IS_TRUE(parser.IsComplete());
+
+			std::vector<granada::http::parser::MultipartPart>& parts = parser.GetParts();
+			VERIFY_ARE_EQUAL(parts.size(), 2);
+			VERIFY_ARE_EQUAL(parts[0].name, "test-text-field");
+			VERIFY_IS_TRUE(parts[0].filename.empty());
+			VERIFY_ARE_EQUAL(std::string(parts[0].value.begin(), parts[0].value.end()), "hello");
+			VERIFY_ARE_EQUAL(parts[1].name, "file");
+			VERIFY_ARE_EQUAL(parts[1].filename, "a;b.png");
+			VERIFY_ARE_EQUAL(parts[1].content_type, "image/png");
+			VERIFY_ARE_EQUAL(std::string(parts[1].value.begin(), parts[1].value.end()), file_content);
+			VERIFY_ARE_EQUAL(parts[1].size, file_content.length());
+			VERIFY_IS_TRUE(parts[1].file_path.empty());
+		}
+	}
+
+	TEST(quoted_boundary)
+	{
+		web::http::http_headers headers;
+		headers.add(web::http::header_names::content_type, U("multipart/form-data; boundary=\"simple boundary\"; charset=utf-8"));
+		const std::string quoted = granada::http::parser::ExtractMultipartBoundary(headers);
+		VERIFY_ARE_EQUAL(quoted, "simple boundary");
+
+		granada::http::parser::MultipartParser parser(quoted, 1024 * 1024);
+		const std::string data =
+			"--simple boundary\r\n"
+			"Content-Disposition: form-data; name=\"field\"\r\n"
+			"\r\n"
+			"value\r\n"
+			"--simple boundary--";
+		VERIFY_IS_TRUE(consume(parser, data, data.length()));
+		VERIFY_IS_TRUE(parser.IsComplete());
+		VERIFY_ARE_EQUAL(parser.GetParts().size(), 1);
+		VERIFY_ARE_EQUAL(parser.GetParts()[0].name, "field");
+	}
+
+	TEST(part_without_headers)
+	{
+		granada::http::parser::MultipartParser parser("b", 1024 * 1024);
+		const std::string data = "preamble\r\n--b\r\n\r\nvalue\r\n--b--\r\nepilogue";
+		VERIFY_IS_TRUE(consume(parser, data, 3));
+		VERIFY_IS_TRUE(parser.IsComplete());
+
+		std::vector<granada::http::parser::MultipartPart>& parts = parser.GetParts();
+		VERIFY_ARE_EQUAL(parts.size(), 1);
+		VERIFY_IS_TRUE(parts[0].name.empty());
+		VERIFY_IS_TRUE(parts[0].content_type.empty());
+		VERIFY_ARE_EQUAL(std::string(parts[0].value.begin(), parts[0].value.end()), "value");
+	}
+
+	TEST(spill)
+	{
+		std::string file_path;
+		{
+			// parts with more than 16 bytes are written to a file.
+			granada::http::parser::MultipartParser parser(boundary, 16);
+			VERIFY_IS_TRUE(consume(parser, body, 5));
+			VERIFY_IS_TRUE(parser.IsComplete());
+
+			std::vector<granada::http::parser::MultipartPart>& parts = parser.GetParts();
+			VERIFY_ARE_EQUAL(parts.size(), 2);
+			VERIFY_IS_TRUE(parts[0].file_path.empty());
+			VERIFY_ARE_EQUAL(std::string(parts[0].value.begin(), parts[0].value.end()), "hello");
+
+			file_path = parts[1].file_path;
+			VERIFY_IS_FALSE(file_path.empty());
+			VERIFY_IS_TRUE(parts[1].value.empty());
+			VERIFY_ARE_EQUAL(parts[1].size, file_content.length());
+			std::ifstream ifs(file_path, std::ios::binary);
+			const std::string content((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+			VERIFY_ARE_EQUAL(content, file_content);
+		}
+		// the temporary file is removed with the parser.
+		VERIFY_IS_FALSE(std::ifstream(file_path).good());
+	}
+
+	TEST(truncated)
+	{
+		granada::http::parser::MultipartParser parser(boundary, 1024 * 1024);
+		VERIFY_IS_TRUE(consume(parser, body.substr(0, body.length() / 2), 7));
+		VERIFY_IS_FALSE(parser.IsComplete());
+
+		// nothing after a delimiter but garbage.
+		granada::http::parser::MultipartParser malformed("b", 1024 * 1024);
+		const std::string data = "--b\r\n\r\nvalue\r\n--bxx";
+		VERIFY_IS_FALSE(consume(malformed, data, data.length()));
+		VERIFY_IS_FALSE(malformed.IsComplete());
+	}
+
+}
+
+} } }
@@ -0,0 +1,222 @@
+/**
+ * Copyright (c) <2016> Web App SDK granada <afernandez@cookinapps.io>
+ *
+ * This source code is licensed under the MIT license.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * =+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+
+ *
+ * Tests for granada::http::parser
+ *
+ * =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+ **/
+#include "stdafx.h"
+#include "granada/http/parser.h"
+
+
+namespace granada { namespace test { namespace http {
+    
+SUITE(parser)
+{
+
+	TEST(cookies)
+	{
+		granada::http::parser::StringRefPairs parsed;
+		granada::http::parser::ParseCookies(" token=6464 ;\tcart=3\t; empty=", parsed);
+		VERIFY_ARE_EQUAL(parsed.size(), 3);
+		VERIFY_ARE_EQUAL(parsed[0].first.to_string(), "token");
+		VERIFY_ARE_EQUAL(parsed[0].second.to_string(), "6464");
+		VERIFY_ARE_EQUAL(parsed[1].first.to_string(), "cart");
+		VERIFY_ARE_EQUAL(parsed[1].second.to_string(), "3");
+		VERIFY_ARE_EQUAL(parsed[2].first.to_string(), "empty");
+		VERIFY_IS_TRUE(parsed[2].second.empty());
+
+		// pairs without "=" are skipped.
+		parsed.clear();
+		granada::http::parser::ParseCookies("token;cart=3;", parsed);
+		VERIFY_ARE_EQUAL(parsed.size(), 1);
+		VERIFY_ARE_EQUAL(parsed[0].first.to_string(), "cart");
+	}
+
+	TEST(find_cookie)
+	{
+		VERIFY_ARE_EQUAL(granada::http::parser::FindCookie("cart=3;  token=6464\t;x=y", "token").to_string(), "6464");
+		VERIFY_ARE_EQUAL(granada::http::parser::FindCookie("token=6464", "token").to_string(), "6464");
+		VERIFY_IS_TRUE(granada::http::parser::FindCookie("token", "token").empty());
+		VERIFY_IS_TRUE(granada::http::parser::FindCookie("tokens=6464", "token").empty());
+		VERIFY_IS_TRUE(granada::http::parser::FindCookie("", "token").empty());
+
+		// the first cookie with the name wins.
+		VERIFY_ARE_EQUAL(granada::http::parser::FindCookie("token=6464; token=777", "token").to_string(), "6464");
+
+		// an empty value is found empty.
+		VERIFY_IS_TRUE(granada::http::parser::FindCookie("token=; cart=3", "token").empty());
+
+		// contents are not decoded, the value keeps its "=".
+		VERIFY_ARE_EQUAL(granada::http::parser::FindCookie("token=a%2Bb==", "token").to_string(), "a%2Bb==");
+	}
+
+	TEST(query_string)
+	{
+		std::unordered_map<std::string, std::string> parsed = granada::http::parser::ParseQueryString("id=0&quantity=2&flag&empty=&name=a%20b%2Bc&id=1");
+		VERIFY_ARE_EQUAL(parsed.size(), 3);
+		// the last value of a key wins.
+		VERIFY_ARE_EQUAL(parsed["id"], "1");
+		VERIFY_ARE_EQUAL(parsed["quantity"], "2");
+		// values are decoded.
+		VERIFY_ARE_EQUAL(parsed["name"], "a b+c");
+		// keys without "=" or with an empty value are skipped.
+		VERIFY_IS_TRUE(parsed.find("flag") == parsed.end());
+		VERIFY_IS_TRUE(parsed.find("empty") == parsed.end());
+
+		granada::http::parser::StringRefPairs pairs;
+		granada::http::parser::ParseQueryString("id=0&flag&empty=", pairs);
+		VERIFY_ARE_EQUAL(pairs.size(), 2);
+		VERIFY_ARE_EQUAL(pairs[1].first.to_string(), "empty");
+		VERIFY_IS_TRUE(pairs[1].second.empty());
+	}
+
+	TEST(find_query_parameter)
+	{
+		VERIFY_ARE_EQUAL(granada::http::parser::FindQueryParameter("id=0&token=6464", "token").to_string(), "6464");
+		VERIFY_IS_TRUE(granada::http::parser::FindQueryParameter("token&id=0", "token").empty());
+		VERIFY_IS_TRUE(granada::http::parser::FindQueryParameter("tokens=6464", "token").empty());
+
+		// the last value wins, an empty value does not hide a previous one.
+		VERIFY_ARE_EQUAL(granada::http::parser::FindQueryParameter("token=6464&token=777", "token").to_string(), "777");
+		VERIFY_ARE_EQUAL(granada::http::parser::FindQueryParameter("token=6464&token=", "token").to_string(), "6464");
+		VERIFY_IS_TRUE(granada::http::parser::FindQueryParameter("token=", "token").empty());
+
+		// the value is not decoded, spaces are not trimmed.
+		VERIFY_ARE_EQUAL(granada::http::parser::FindQueryParameter("token=a%2Bb", "token").to_string(), "a%2Bb");
+		VERIFY_ARE_EQUAL(granada::http::parser::FindQueryParameter("token= 6464", "token").to_string(), " 6464");
+	}
+
+	TEST(range)
+	{
+		std::vector<std::pair<std::size_t,std::size_t>> ranges;
+		VERIFY_IS_TRUE(granada::http::parser::ParseRange("bytes=0-99", 1000, ranges));
+		VERIFY_ARE_EQUAL(ranges.size(), 1);
+		VERIFY_ARE_EQUAL(ranges[0].first, 0);
+		VERIFY_ARE_EQUAL(ranges[0].second, 99);
+
+		// last position beyond the content.
+		ranges.clear();
+		VERIFY_IS_TRUE(granada::http::parser::ParseRange("bytes=900-5000", 1000, ranges));
+		VERIFY_ARE_EQUAL(ranges.size(), 1);
+		VERIFY_ARE_EQUAL(ranges[0].first, 900);
+		VERIFY_ARE_EQUAL(ranges[0].second, 999);
+	}
+
+	TEST(range_suffix)
+	{
+		std::vector<std::pair<std::size_t,std::size_t>> ranges;
+		VERIFY_IS_TRUE(granada::http::parser::ParseRange("bytes=-100", 1000, ranges));
+		VERIFY_ARE_EQUAL(ranges.size(), 1);
+		VERIFY_ARE_EQUAL(ranges[0].first, 900);
+		VERIFY_ARE_EQUAL(ranges[0].second, 999);
+
+		// suffix longer than the content: the whole content.
+		ranges.clear();
+		VERIFY_IS_TRUE(granada::http::parser::ParseRange("bytes=-5000", 1000, ranges));
+		VERIFY_ARE_EQUAL(ranges.size(), 1);
+		VERIFY_ARE_EQUAL(ranges[0].first, 0);
+		VERIFY_ARE_EQUAL(ranges[0].second, 999);
+	}
+
+	TEST(range_open_ended)
+	{
+		std::vector<std::pair<std::size_t,std::size_t>> ranges;
+		VERIFY_IS_TRUE(granada::http::parser::ParseRange("bytes=500-", 1000, ranges));
+		VERIFY_ARE_EQUAL(ranges.size(), 1);
+		VERIFY_ARE_EQUAL(ranges[0].first, 500);
+		VERIFY_ARE_EQUAL(ranges[0].second, 999);
+	}
+
+	TEST(range_unsatisfiable)
+	{
+		std::vector<std::pair<std::size_t,std::size_t>> ranges;
+		VERIFY_IS_TRUE(granada::http::parser::ParseRange("bytes=1000-1099", 1000, ranges));
+		VERIFY_IS_TRUE(ranges.empty());
+
+		VERIFY_IS_TRUE(granada::http::parser::ParseRange("bytes=-0", 1000, ranges));
+		VERIFY_IS_TRUE(ranges.empty());
+
+		VERIFY_IS_TRUE(granada::http::parser::ParseRange("bytes=0-", 0, ranges));
+		VERIFY_IS_TRUE(ranges.empty());
+	}
+
+	TEST(range_malformed)
+	{
+		std::vector<std::pair<std::size_t,std::size_t>> ranges;
+		VERIFY_IS_FALSE(granada::http::parser::ParseRange("items=0-99", 1000, ranges));
+		VERIFY_IS_FALSE(granada::http::parser::ParseRange("bytes=", 1000, ranges));
+		VERIFY_IS_FALSE(granada::http::parser::ParseRange("bytes=99", 1000, ranges));
+		VERIFY_IS_FALSE(granada::http::parser::ParseRange("bytes=-", 1000, ranges));
+		VERIFY_IS_FALSE(granada::http::parser::ParseRange("bytes=a-b", 1000, ranges));
+		VERIFY_IS_FALSE(granada::http::parser::ParseRange("bytes=0-1-2", 1000, ranges));
+		VERIFY_IS_FALSE(granada::http::parser::ParseRange("bytes=99-0", 1000, ranges));
+	}
+
+	TEST(range_overflow)
+	{
+		std::vector<std::pair<std::size_t,std::size_t>> ranges;
+		VERIFY_IS_FALSE(granada::http::parser::ParseRange("bytes=0-99999999999999999999999", 1000, ranges));
+		VERIFY_IS_FALSE(granada::http::parser::ParseRange("bytes=-99999999999999999999999", 1000, ranges));
+	}
+
+	TEST(range_merged)
+	{
+		std::vector<std::pair<std::size_t,std::size_t>> ranges;
+		VERIFY_IS_TRUE(granada::http::parser::ParseRange("bytes=500-599, 0-99, 100-199, 150-299", 1000, ranges));
+		VERIFY_ARE_EQUAL(ranges.size(), 2);
+		VERIFY_ARE_EQUAL(ranges[0].first, 0);
+		VERIFY_ARE_EQUAL(ranges[0].second, 299);
+		VERIFY_ARE_EQUAL(ranges[1].first, 500);
+		VERIFY_ARE_EQUAL(ranges[1].second, 599);
+	}
+
+	TEST(range_limits)
+	{
+		std::vector<std::pair<std::size_t,std::size_t>> ranges;
+
+		// the same bytes asked many times.
+		VERIFY_IS_FALSE(granada::http::parser::ParseRange("bytes=0-999, 0-999, 0-999, 0-999", 1000, ranges));
+		VERIFY_IS_TRUE(ranges.empty());
+
+		// too many ranges.
+		std::string range = "bytes=0-0";
+		for (int i = 1; i < 17; ++i){
+			range += ", " + std::to_string(i * 10) + "-" + std::to_string(i * 10);
+		}
+		VERIFY_IS_FALSE(granada::http::parser::ParseRange(range, 1000, ranges));
+
+		// at most 16 ranges.
+		ranges.clear();
+		range = "bytes=0-0";
+		for (int i = 1; i < 16; ++i){
+			range += ", " + std::to_string(i * 10) + "-" + std::to_string(i * 10);
+		}
+		VERIFY_IS_TRUE(granada::http::parser::ParseRange(range, 1000, ranges));
+		VERIFY_ARE_EQUAL(ranges.size(), 16);
+	}
+
+}
+
+} } }
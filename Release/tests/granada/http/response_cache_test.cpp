@@ -0,0 +1,195 @@
+/**
+ * Copyright (c) <2016> Web App SDK granada <afernandez@cookinapps.io>
+ *
+ * This source code is licensed under the MIT license.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * =+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+
+ *
+ * Tests for granada::http::controller::ResponseCache
+ *
+ * =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+ **/
+#include "stdafx.h"
+#include <atomic>
+#include <thread>
+#include "granada/util/time.h"
+#include "granada/http/controller/response_cache.h"
+
+
+namespace granada { namespace test { namespace http {
+
+static web::http::http_request get(const std::string& uri)
+{
+	web::http::http_request request(web::http::methods::GET);
+	request.set_request_uri(utility::conversions::to_string_t(uri));
+	return request;
+}
+
+static std::string body(const web::http::http_request& request)
+{
+	const std::vector<unsigned char> content = request.get_response().get().extract_vector().get();
+	return std::string(content.begin(), content.end());
+}
+
+SUITE(response_cache)
+{
+
+	TEST(ttl)
+	{
+		granada::http::controller::ResponseCache response_cache(std::chrono::milliseconds(200), {"client_id"});
+		std::atomic<int> computed(0);
+		auto compute = [&computed](){
+			web::http::http_response response(web::http::status_codes::OK);
+			response.set_body(utility::conversions::to_string_t(std::to_string(++computed)));
+			return response;
+		};
+
+		web::http::http_request request = get("/info?client_id=6464&state=a");
+		response_cache.Reply(request, "", compute);
+		VERIFY_ARE_EQUAL(body(request), "1");
+
+		// other query parameters are not part of the key.
+		request = get("/info?client_id=6464&state=b");
+		response_cache.Reply(request, "", compute);
+		VERIFY_ARE_EQUAL(body(request), "1");
+
+		// different client_id or vary key.
+		request = get("/info?client_id=6465");
+		response_cache.Reply(request, "", compute);
+		VERIFY_ARE_EQUAL(body(request), "2");
+		request = get("/info?client_id=6464");
+		response_cache.Reply(request, "user:john", compute);
+		VERIFY_ARE_EQUAL(body(request), "3");
+
+		// expired.
+		granada::util::time::sleep_milliseconds(300);
+		request = get("/info?client_id=6464");
+		response_cache.Reply(request, "", compute);
+		VERIFY_ARE_EQUAL(body(request), "4");
+
+		response_cache.Clear();
+		request = get("/info?client_id=6464");
+		response_cache.Reply(request, "", compute);
+		VERIFY_ARE_EQUAL(body(request), "5");
+	}
+
+	TEST(single_flight)
+	{
+		granada::http::controller::ResponseCache response_cache(std::chrono::milliseconds(1000), {});
+		std::atomic<int> computed(0);
+		auto compute = [&computed](){
+			granada::util::time::sleep_milliseconds(200);
+			web::http::http_response response(web::http::status_codes::OK);
+			response.set_body(utility::conversions::to_string_t(std::to_string(++computed)));
+			return response;
+		};
+
+		// the requests arriving while the response is computed get it.
+		std::vector<web::http::http_request> requests;
+		std::vector<std::thread> threads;
+		for (int i = 0; i < 8; ++i){
+			requests.push_back(get("/plugins"));
+		}
+		for (int i = 0; i < 8; ++i){
+			web::http::http_request request = requests[i];
+			threads.push_back(std::thread([&response_cache, request, compute](){
+				response_cache.Reply(request, "", compute);
+			}));
+			granada::util::time::sleep_milliseconds(10);
+		}
+		for (auto it = threads.begin(); it != threads.end(); ++it){
+			it->join();
+		}
+		for (auto it = requests.begin(); it != requests.end(); ++it){
+			VERIFY_ARE_EQUAL(body(*it), "1");
+		}
+		VERIFY_ARE_EQUAL(computed.load(), 1);
+	}
+
+	TEST(clear_during_flight)
+	{
+		granada::http::controller::ResponseCache response_cache(std::chrono::milliseconds(1000), {});
+		std::atomic<int> computed(0);
+		auto compute = [&computed](){
+			const int value = ++computed;
+			granada::util::time::sleep_milliseconds(200);
+			web::http::http_response response(web::http::status_codes::OK);
+			response.set_body(utility::conversions::to_string_t(std::to_string(value)));
+			return response;
+		};
+
+		// the cache is cleared while the response is computed.
+		web::http::http_request request = get("/info");
+		std::thread thread([&response_cache, request, compute](){
+			response_cache.Reply(request, "", compute);
+		});
+		granada::util::time::sleep_milliseconds(50);
+		response_cache.Clear();
+
+		// a request after the clear does not wait for the old response.
+		web::http::http_request after = get("/info");
+		response_cache.Reply(after, "", compute);
+		thread.join();
+		VERIFY_ARE_EQUAL(body(request), "1");
+		VERIFY_ARE_EQUAL(body(after), "2");
+
+		// the response computed before the clear has not been cached.
+		request = get("/info");
+		response_cache.Reply(request, "", compute);
+		VERIFY_ARE_EQUAL(body(request), "2");
+		VERIFY_ARE_EQUAL(computed.load(), 2);
+	}
+
+	TEST(bypass)
+	{
+		granada::http::controller::ResponseCache response_cache(std::chrono::milliseconds(1000), {});
+		std::atomic<int> computed(0);
+
+		// responses other than 200 are not cached.
+		auto not_found = [&computed](){
+			++computed;
+			return web::http::http_response(web::http::status_codes::NotFound);
+		};
+		web::http::http_request request = get("/missing");
+		response_cache.Reply(request, "", not_found);
+		VERIFY_ARE_EQUAL(request.get_response().get().status_code(), web::http::status_codes::NotFound);
+		request = get("/missing");
+		response_cache.Reply(request, "", not_found);
+		VERIFY_ARE_EQUAL(computed.load(), 2);
+
+		// responses setting a cookie are not cached.
+		computed = 0;
+		auto cookie = [&computed](){
+			++computed;
+			web::http::http_response response(web::http::status_codes::OK);
+			response.headers().add(utility::conversions::to_string_t(entity_keys::session_set_cookie), U("token=6464; path=/"));
+			return response;
+		};
+		request = get("/cookie");
+		response_cache.Reply(request, "", cookie);
+		VERIFY_IS_TRUE(request.get_response().get().headers().has(utility::conversions::to_string_t(entity_keys::session_set_cookie)));
+		request = get("/cookie");
+		response_cache.Reply(request, "", cookie);
+		VERIFY_ARE_EQUAL(computed.load(), 2);
+	}
+
+}
+
+} } }
@@ -0,0 +1,82 @@
+/**
+ * Copyright (c) <2016> Web App SDK granada <afernandez@cookinapps.io>
+ *
+ * This source code is licensed under the MIT license.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * =+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+
+ *
+ * Tests for granada::http::session::SessionRoles
+ *
+ * =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+ **/
+#include "stdafx.h"
+#include "granada/http/session/map_session.h"
+
+
+namespace granada { namespace test { namespace http {
+    
+SUITE(session_roles)
+{
+
+	TEST(add_remove)
+	{
+		granada::http::session::MapSession session;
+		session.Open();
+		VERIFY_IS_TRUE(session.roles()->Add("admin"));
+		VERIFY_IS_FALSE(session.roles()->Add("admin"));
+		VERIFY_IS_FALSE(session.roles()->Add("a,b"));
+		VERIFY_IS_TRUE(session.roles()->Is("admin"));
+
+		granada::http::session::MapSession loaded(session.GetToken());
+		VERIFY_IS_TRUE(loaded.roles()->Is("admin"));
+		loaded.roles()->Remove("admin");
+		VERIFY_IS_FALSE(loaded.roles()->Is("admin"));
+	}
+
+	TEST(more_roles_than_ids)
+	{
+		const int count = granada::http::session::RoleRegistry::MAX_ROLES + 8;
+		granada::http::session::MapSession session;
+		session.Open();
+		for (int i = 0; i < count; ++i){
+			VERIFY_IS_TRUE(session.roles()->Add("role" + std::to_string(i)));
+		}
+
+		// the roles without an id are kept by name.
+		granada::http::session::MapSession loaded(session.GetToken());
+		for (int i = 0; i < count; ++i){
+			VERIFY_IS_TRUE(loaded.roles()->Is("role" + std::to_string(i)));
+		}
+		VERIFY_IS_FALSE(loaded.roles()->Is("role" + std::to_string(count)));
+
+		loaded.roles()->Remove("role" + std::to_string(count - 1));
+		VERIFY_IS_FALSE(loaded.roles()->Is("role" + std::to_string(count - 1)));
+		granada::http::session::MapSession reloaded(session.GetToken());
+		VERIFY_IS_FALSE(reloaded.roles()->Is("role" + std::to_string(count - 1)));
+		VERIFY_IS_TRUE(reloaded.roles()->Is("role" + std::to_string(count - 2)));
+
+		reloaded.roles()->RemoveAll();
+		VERIFY_IS_FALSE(reloaded.roles()->Is("role0"));
+		VERIFY_IS_FALSE(reloaded.roles()->Is("role" + std::to_string(count - 2)));
+	}
+
+}
+    
+}}} //namespaces
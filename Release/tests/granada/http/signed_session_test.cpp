@@ -0,0 +1,108 @@
+/**
+ * Copyright (c) <2016> Web App SDK granada <afernandez@cookinapps.io>
+ *
+ * This source code is licensed under the MIT license.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * =+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+
+ *
+ * Tests for granada::http::session::SignedSessionHandler
+ *
+ * =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+ **/
+#include "stdafx.h"
+#include "granada/http/session/map_signed_session.h"
+
+
+namespace granada { namespace test { namespace http {
+    
+SUITE(signed_session)
+{
+
+	TEST(open_load)
+	{
+		granada::http::session::MapSignedSession session;
+		session.Open();
+		VERIFY_IS_FALSE(session.GetSignedToken().empty());
+
+		granada::http::session::MapSignedSession loaded(session.GetSignedToken());
+		VERIFY_IS_TRUE(loaded.IsValid());
+		VERIFY_ARE_EQUAL(session.GetToken(), loaded.GetToken());
+
+		// the id alone is not a token.
+		granada::http::session::MapSignedSession forged(session.GetToken());
+		VERIFY_IS_TRUE(forged.GetToken().empty());
+	}
+
+	TEST(close_revokes)
+	{
+		granada::http::session::MapSignedSession session;
+		session.Open();
+		session.Write("cart", "3");
+		const std::string signed_token = session.GetSignedToken();
+		const std::string data_hash = cache_namespaces::session_data + session.GetToken();
+		granada::cache::CacheHandler* cache = session.session_handler()->cache();
+		VERIFY_IS_TRUE(cache->Exists(data_hash));
+
+		session.Close();
+		VERIFY_IS_FALSE(cache->Exists(data_hash));
+
+		// the signed token stays valid until it expires, it is refused as revoked.
+		granada::http::session::MapSignedSession loaded(signed_token);
+		VERIFY_IS_TRUE(loaded.GetToken().empty());
+	}
+
+	TEST(clean_keeps_reading_sessions)
+	{
+		granada::http::session::MapSignedSession session;
+		session.Open();
+		session.Write("cart", "3");
+		const std::string data_hash = cache_namespaces::session_data + session.GetToken();
+		granada::cache::CacheHandler* cache = session.session_handler()->cache();
+
+		// data written long ago, the session has only read it since.
+		cache->Write(data_hash, entity_keys::session_update_time, "1");
+
+		// signing the token again refreshes the update time of the data.
+		session.SetRoles(1);
+		session.Update();
+		VERIFY_ARE_NOT_EQUAL("1", cache->Read(data_hash, entity_keys::session_update_time));
+
+		session.session_handler()->CleanSessions();
+		VERIFY_IS_TRUE(cache->Exists(data_hash));
+		granada::http::session::MapSignedSession loaded(session.GetSignedToken());
+		VERIFY_ARE_EQUAL(session.GetToken(), loaded.GetToken());
+	}
+
+	TEST(clean_timed_out_sessions)
+	{
+		granada::http::session::MapSignedSession session;
+		session.Open();
+		session.Write("cart", "3");
+		const std::string data_hash = cache_namespaces::session_data + session.GetToken();
+		granada::cache::CacheHandler* cache = session.session_handler()->cache();
+		cache->Write(data_hash, entity_keys::session_update_time, "1");
+
+		session.session_handler()->CleanSessions();
+		VERIFY_IS_FALSE(cache->Exists(data_hash));
+	}
+
+}
+    
+}}} //namespaces
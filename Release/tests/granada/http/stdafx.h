@@ -0,0 +1,7 @@
+#pragma once
+#define _TURN_OFF_PLATFORM_STRING
+
+#include "cpprest/uri.h"
+#include "cpprest/asyncrt_utils.h"
+
+#include "unittestpp.h"
\ No newline at end of file
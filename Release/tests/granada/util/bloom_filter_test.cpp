@@ -0,0 +1,81 @@
+/**
+ * Copyright (c) <2016> Web App SDK granada <afernandez@cookinapps.io>
+ *
+ * This source code is licensed under the MIT license.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * =+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+
+ *
+ * Tests for granada::util::bloom
+ *
+ * =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+ **/
+#include "stdafx.h"
+#include "granada/util/bloom_filter.h"
+
+
+namespace granada { namespace test { namespace util {
+    
+SUITE(bloom)
+{
+
+	TEST(counting_filter)
+	{
+		granada::util::bloom::counting_filter filter(1024,4);
+		VERIFY_IS_FALSE(filter.may_contain("6464"));
+
+		filter.add("6464");
+		filter.add("777");
+		VERIFY_IS_TRUE(filter.may_contain("6464"));
+		VERIFY_IS_TRUE(filter.may_contain("777"));
+
+		filter.remove("6464");
+		VERIFY_IS_FALSE(filter.may_contain("6464"));
+		VERIFY_IS_TRUE(filter.may_contain("777"));
+
+		// added twice, removed once.
+		filter.add("777");
+		filter.remove("777");
+		VERIFY_IS_TRUE(filter.may_contain("777"));
+		filter.remove("777");
+		VERIFY_IS_FALSE(filter.may_contain("777"));
+	}
+
+	TEST(counting_filter_count)
+	{
+		granada::util::bloom::counting_filter filter(1024,4);
+		VERIFY_ARE_EQUAL(0, filter.count("6464"));
+
+		filter.add("6464");
+		filter.add("6464");
+		filter.add("777");
+		VERIFY_ARE_EQUAL(2, filter.count("6464"));
+		VERIFY_ARE_EQUAL(1, filter.count("777"));
+
+		filter.remove("6464");
+		VERIFY_ARE_EQUAL(1, filter.count("6464"));
+
+		filter.clear();
+		VERIFY_ARE_EQUAL(0, filter.count("6464"));
+		VERIFY_IS_FALSE(filter.may_contain("777"));
+	}
+
+}
+    
+}}} //namespaces
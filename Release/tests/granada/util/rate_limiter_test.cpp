@@ -0,0 +1,63 @@
+/**
+ * Copyright (c) <2016> Web App SDK granada <afernandez@cookinapps.io>
+ *
+ * This source code is licensed under the MIT license.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * =+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+
+ *
+ * Tests for granada::util::rate
+ *
+ * =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+ **/
+#include "stdafx.h"
+#include "granada/util/rate_limiter.h"
+
+
+namespace granada { namespace test { namespace util {
+    
+SUITE(rate)
+{
+
+	TEST(token_buckets)
+	{
+		// one token per second, three in a row.
+		granada::util::rate::token_buckets buckets(1,3);
+		VERIFY_ARE_EQUAL(0, buckets.acquire("6464"));
+		VERIFY_ARE_EQUAL(0, buckets.acquire("6464"));
+		VERIFY_ARE_EQUAL(0, buckets.acquire("6464"));
+
+		long long wait = buckets.acquire("6464");
+		VERIFY_IS_TRUE(wait > 0 && wait <= 1000);
+
+		// other keys have their own bucket.
+		VERIFY_ARE_EQUAL(0, buckets.acquire("777"));
+	}
+
+	TEST(token_buckets_unlimited)
+	{
+		granada::util::rate::token_buckets buckets(0,1);
+		for (int i = 0; i < 100; ++i){
+			VERIFY_ARE_EQUAL(0, buckets.acquire("6464"));
+		}
+	}
+
+}
+    
+}}} //namespaces
@@ -0,0 +1,132 @@
+/**
+ * Copyright (c) <2016> Web App SDK granada <afernandez@cookinapps.io>
+ *
+ * This source code is licensed under the MIT license.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * =+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+
+ *
+ * Tests for granada::runner::Scheduler
+ *
+ * =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+ **/
+#include "stdafx.h"
+#include "granada/util/time.h"
+#include "granada/runner/runner_scheduler.h"
+
+
+namespace granada { namespace test { namespace util {
+    
+SUITE(scheduler)
+{
+
+	TEST(concurrency)
+	{
+		granada::runner::Scheduler scheduler(2, 0, 0);
+		VERIFY_IS_TRUE(scheduler.Admit("a").get());
+		VERIFY_IS_TRUE(scheduler.Admit("b").get());
+
+		// at most two runs at once.
+		pplx::task<bool> third = scheduler.Admit("c");
+		granada::util::time::sleep_milliseconds(100);
+		VERIFY_IS_FALSE(third.is_done());
+		VERIFY_ARE_EQUAL(scheduler.running(), 2);
+		VERIFY_ARE_EQUAL(scheduler.waiting(), 1);
+
+		scheduler.Release();
+		VERIFY_IS_TRUE(third.get());
+		VERIFY_ARE_EQUAL(scheduler.running(), 2);
+		VERIFY_ARE_EQUAL(scheduler.waiting(), 0);
+		scheduler.Release();
+		scheduler.Release();
+		VERIFY_ARE_EQUAL(scheduler.running(), 0);
+	}
+
+	TEST(round_robin)
+	{
+		granada::runner::Scheduler scheduler(1, 0, 0);
+		VERIFY_IS_TRUE(scheduler.Admit("busy").get());
+
+		// a key with many runs does not delay the other keys.
+		pplx::task<bool> x1 = scheduler.Admit("x");
+		pplx::task<bool> x2 = scheduler.Admit("x");
+		pplx::task<bool> x3 = scheduler.Admit("x");
+		pplx::task<bool> y1 = scheduler.Admit("y");
+
+		scheduler.Release();
+		VERIFY_IS_TRUE(x1.get());
+		scheduler.Release();
+		VERIFY_IS_TRUE(y1.get());
+		VERIFY_IS_FALSE(x2.is_done());
+		scheduler.Release();
+		VERIFY_IS_TRUE(x2.get());
+		VERIFY_IS_FALSE(x3.is_done());
+		scheduler.Release();
+		VERIFY_IS_TRUE(x3.get());
+		scheduler.Release();
+	}
+
+	TEST(interval)
+	{
+		granada::runner::Scheduler scheduler(4, 200, 0);
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		VERIFY_IS_TRUE(scheduler.Admit("a").get());
+
+		// the same key waits, another key does not.
+		pplx::task<bool> second = scheduler.Admit("a");
+		VERIFY_IS_TRUE(scheduler.Admit("b").get());
+		VERIFY_IS_TRUE(std::chrono::steady_clock::now() - start < std::chrono::milliseconds(150));
+		VERIFY_IS_TRUE(second.get());
+		VERIFY_IS_TRUE(std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(190));
+		scheduler.Release();
+		scheduler.Release();
+		scheduler.Release();
+	}
+
+	TEST(deadline)
+	{
+		granada::runner::Scheduler scheduler(1, 0, 100);
+		VERIFY_IS_TRUE(scheduler.Admit("a").get());
+
+		// refused once its deadline has passed.
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		VERIFY_IS_FALSE(scheduler.Admit("b").get());
+		VERIFY_IS_TRUE(std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(90));
+		VERIFY_ARE_EQUAL(scheduler.waiting(), 0);
+		VERIFY_ARE_EQUAL(scheduler.running(), 1);
+		scheduler.Release();
+	}
+
+	TEST(shutdown)
+	{
+		pplx::task<bool> waiting;
+		{
+			granada::runner::Scheduler scheduler(1, 0, 0);
+			VERIFY_IS_TRUE(scheduler.Admit("a").get());
+			waiting = scheduler.Admit("b");
+			granada::util::time::sleep_milliseconds(50);
+			VERIFY_IS_FALSE(waiting.is_done());
+		}
+		// the runs still waiting are refused.
+		VERIFY_IS_FALSE(waiting.get());
+	}
+
+}
+
+} } }
@@ -359,6 +359,24 @@ SUITE(string)
 		VERIFY_ARE_EQUAL(granada::util::string::stringified_json(str),"{}");
 	}
 
+
+	TEST(wildcard_match)
+	{
+		VERIFY_IS_TRUE(granada::util::string::wildcard_match("session:value:6464","session:value:*"));
+		VERIFY_IS_TRUE(granada::util::string::wildcard_match("session:value:6464","*:value:*"));
+		VERIFY_IS_TRUE(granada::util::string::wildcard_match("session:value:6464","session:value:6464"));
+		VERIFY_IS_TRUE(granada::util::string::wildcard_match("session:value:6464","*"));
+		VERIFY_IS_TRUE(granada::util::string::wildcard_match("session:value:6464","session:*6464*"));
+		VERIFY_IS_TRUE(granada::util::string::wildcard_match("",""));
+		VERIFY_IS_TRUE(granada::util::string::wildcard_match("","*"));
+
+		VERIFY_IS_FALSE(granada::util::string::wildcard_match("session:value:6464","session:"));
+		VERIFY_IS_FALSE(granada::util::string::wildcard_match("session:value:6464","session:*:"));
+		VERIFY_IS_FALSE(granada::util::string::wildcard_match("session:value:6464","plugin:*"));
+		VERIFY_IS_FALSE(granada::util::string::wildcard_match("session:value:6464",""));
+		VERIFY_IS_FALSE(granada::util::string::wildcard_match("","session:*"));
+	}
+
 }
     
 }}} //namespaces
@@ -0,0 +1,89 @@
+/**
+ * Copyright (c) <2016> Web App SDK granada <afernandez@cookinapps.io>
+ *
+ * This source code is licensed under the MIT license.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * =+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+
+ *
+ * Tests for granada::util::time
+ *
+ * =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+ **/
+#include "stdafx.h"
+#include "granada/util/time.h"
+
+
+namespace granada { namespace test { namespace util {
+    
+SUITE(time)
+{
+
+	TEST(format_http_date)
+	{
+		VERIFY_ARE_EQUAL("Sun, 06 Nov 1994 08:49:37 GMT", granada::util::time::format_http_date(784111777));
+		VERIFY_ARE_EQUAL("Thu, 01 Jan 1970 00:00:00 GMT", granada::util::time::format_http_date(0));
+	}
+
+	TEST(parse_http_date)
+	{
+		VERIFY_ARE_EQUAL(784111777, granada::util::time::parse_http_date("Sun, 06 Nov 1994 08:49:37 GMT"));
+		VERIFY_ARE_EQUAL(784111777, granada::util::time::parse_http_date("Sunday, 06-Nov-94 08:49:37 GMT"));
+		VERIFY_ARE_EQUAL(784111777, granada::util::time::parse_http_date("Sun Nov  6 08:49:37 1994"));
+		VERIFY_ARE_EQUAL(-1, granada::util::time::parse_http_date("yesterday"));
+		VERIFY_ARE_EQUAL(-1, granada::util::time::parse_http_date("Sun, 06 Foo 1994 08:49:37 GMT"));
+
+		std::time_t now = std::time(nullptr);
+		VERIFY_ARE_EQUAL(now, granada::util::time::parse_http_date(granada::util::time::format_http_date(now)));
+	}
+
+	TEST(timer_join)
+	{
+		std::atomic_int calls(0);
+		granada::util::time::timer timer;
+		timer.set([&calls]{
+			granada::util::time::sleep_milliseconds(20);
+			calls++;
+		}, 1, "ms");
+		while (calls.load() == 0){
+			granada::util::time::sleep_milliseconds(1);
+		}
+
+		// no call runs or starts after join.
+		timer.join();
+		const int joined_calls = calls.load();
+		granada::util::time::sleep_milliseconds(50);
+		VERIFY_ARE_EQUAL(joined_calls, calls.load());
+	}
+
+	TEST(timer_stop_interrupts_wait)
+	{
+		bool called = false;
+		granada::util::time::timer timer([&called]{
+			called = true;
+		}, 3600);
+		const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		timer.join();
+		VERIFY_IS_FALSE(called);
+		VERIFY_IS_TRUE(std::chrono::steady_clock::now() - start < std::chrono::seconds(10));
+	}
+
+}
+    
+}}} //namespaces